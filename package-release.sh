@@ -9,6 +9,7 @@ fi
 
 NVOPTIX_SRC_DIR=$(dirname "$(readlink -f "$0")")
 NVOPTIX_BUILD_DIR=$(realpath "$1")"/nvoptix"
+shift
 
 if [ -e "$NVOPTIX_BUILD_DIR" ]; then
   echo "Build directory $NVOPTIX_BUILD_DIR already exists"
@@ -22,10 +23,15 @@ meson --cross-file "$NVOPTIX_SRC_DIR/build-wine64.txt"    \
         --prefix "$NVOPTIX_BUILD_DIR"                     \
         --libdir="x64"                                    \
         --strip                                           \
+        "$@"                                              \
         "$NVOPTIX_BUILD_DIR/build"
 
 cd "$NVOPTIX_BUILD_DIR/build"
 ninja install
 
-mv "$NVOPTIX_BUILD_DIR/x64/nvoptix.dll.so" "$NVOPTIX_BUILD_DIR/x64/nvoptix.dll"
+# a unixlib build installs the PE nvoptix.dll and its nvoptix.so as they are
+
+if [ -e "$NVOPTIX_BUILD_DIR/x64/nvoptix.dll.so" ]; then
+  mv "$NVOPTIX_BUILD_DIR/x64/nvoptix.dll.so" "$NVOPTIX_BUILD_DIR/x64/nvoptix.dll"
+fi
 rm -R "$NVOPTIX_BUILD_DIR/build"
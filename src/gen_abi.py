@@ -0,0 +1,467 @@
+#!/usr/bin/env python3
+#
+# Generates nvoptix_abi.h and nvoptix_thunks.h from the function table layouts and
+# prototypes in nvoptix_abi.txt, and for a unixlib build nvoptix_unix_calls.h and
+# nvoptix_pe_thunks.h
+#
+# usage: gen_abi.py nvoptix_abi.txt nvoptix_abi.h nvoptix_thunks.h nvoptix_unix_calls.h nvoptix_pe_thunks.h
+
+import re
+import sys
+
+
+NVTX_DOMAINS = ('context', 'module', 'pipeline', 'accel', 'launch', 'denoiser')
+
+# TRACE formats of the parameter types that are not pointers
+
+TRACE_FORMATS = {
+    'int': '%d',
+    'unsigned int': '%u',
+    'size_t': '%zu',
+    'OptixResult': '%d',
+    'OptixTraversableHandle': '%llu',
+}
+
+# opaque handles, traced as pointers
+
+HANDLE_TYPES = (
+    'CUcontext', 'CUstream', 'CUdeviceptr', 'OptixDeviceContext', 'OptixModule', 'OptixProgramGroup',
+    'OptixPipeline', 'OptixDenoiser', 'OptixTask', 'OptixLogCallback',
+)
+
+
+def fail(path, line, message):
+    sys.exit('%s:%d: %s' % (path, line, message))
+
+
+# a prototype of nvoptix_abi.txt as (entry, return type, [(type, name)]), `_@` left in the types
+
+def parse_prototype(path, number, text):
+    match = re.fullmatch(r'(.+?)\b(\w+)\s*\((.*)\)', text)
+
+    if not match:
+        fail(path, number, 'invalid prototype %s' % text)
+
+    params = []
+
+    for param in match.group(3).split(','):
+        param = ' '.join(param.split())
+
+        if not param or param == 'void':
+            continue
+
+        name = re.search(r'\w+$', param)
+
+        if not name or not param[:name.start()].strip():
+            fail(path, number, 'unnamed parameter of %s' % match.group(2))
+
+        params.append((param[:name.start()].strip(), name.group(0)))
+
+    return match.group(2), ' '.join(match.group(1).split()), params
+
+
+def parse(path):
+    abis = {}
+    order = []
+    current = None
+    directive = None
+    directives = {'hot': set(), 'impl': set(), 'pe': set(), 'nvtx': {}, 'string': {}}
+    prototypes = {}
+    pending = None
+
+    with open(path) as spec:
+        for number, line in enumerate(spec, 1):
+            line = line.split('#', 1)[0].strip()
+
+            if not line:
+                continue
+
+            # a prototype continues until its parameter list is closed
+
+            if pending is None and line.startswith('fn '):
+                current = directive = None
+                match = re.match(r'fn\s+(?:(\d*)-(\d*)\s+)?', line)
+                pending = [number, int(match.group(1) or 0), int(match.group(2) or 0) or None, line[match.end():]]
+            elif pending is not None:
+                pending[3] += ' ' + line
+
+            if pending is not None:
+                if pending[3].count('(') > pending[3].count(')'):
+                    continue
+
+                start, first, last, text = pending
+                entry, ret, params = parse_prototype(path, start, text)
+                prototypes.setdefault(entry, []).append((first, last, ret, params, start))
+                pending = None
+                continue
+
+            match = re.fullmatch(r'abi\s+(\d+)(?:\s*=\s*(\d+))?', line)
+
+            if match:
+                abi = int(match.group(1))
+                directive = None
+
+                if abi in abis:
+                    fail(path, number, 'abi %d listed twice' % abi)
+
+                if match.group(2):
+                    other = int(match.group(2))
+
+                    if other not in abis:
+                        fail(path, number, 'abi %d not listed before' % other)
+
+                    abis[abi] = list(abis[other])
+                    current = None
+                else:
+                    abis[abi] = []
+                    current = abis[abi]
+
+                order.append(abi)
+                continue
+
+            words = line.split()
+
+            if words[0] == 'string':
+                if len(words) != 3:
+                    fail(path, number, 'string needs an entry and a parameter')
+
+                directives['string'].setdefault(words[1], set()).add(words[2])
+                current = directive = None
+                continue
+
+            if words[0] in ('hot', 'impl', 'pe', 'nvtx'):
+                current = None
+                directive = words[0]
+                words = words[1:]
+
+                if directive == 'nvtx':
+                    if not words or words[0] not in NVTX_DOMAINS:
+                        fail(path, number, 'nvtx needs one of the domains %s' % ', '.join(NVTX_DOMAINS))
+
+                    directive, words = ('nvtx', words[0]), words[1:]
+
+            # entries, of the abi or the directive above, which may continue over several lines
+
+            if current is None and directive is None:
+                fail(path, number, 'entries outside of an abi block')
+
+            for entry in words:
+                if not re.fullmatch(r'[A-Za-z_]\w*', entry):
+                    fail(path, number, 'invalid entry %s' % entry)
+
+                if current is not None:
+                    if entry in current:
+                        fail(path, number, 'entry %s listed twice' % entry)
+
+                    current.append(entry)
+                elif isinstance(directive, tuple):
+                    if entry in directives['nvtx']:
+                        fail(path, number, 'entry %s in two nvtx domains' % entry)
+
+                    directives['nvtx'][entry] = directive[1]
+                else:
+                    directives[directive].add(entry)
+
+    if pending is not None:
+        fail(path, pending[0], 'prototype not closed')
+
+    if not order:
+        sys.exit('%s: no abi listed' % path)
+
+    tables = {}
+
+    for abi in order:
+        if not abis[abi]:
+            sys.exit('%s: abi %d has no entries' % (path, abi))
+
+        tables[abi] = []
+
+        for entry in abis[abi]:
+            found = [prototype for prototype in prototypes.get(entry, ())
+                     if prototype[0] <= abi and (prototype[1] is None or abi <= prototype[1])]
+
+            if len(found) != 1:
+                sys.exit('%s: entry %s of abi %d has %s prototype' % (path, entry, abi, 'no' if not found else 'more than one'))
+
+            ret, params = found[0][2:4]
+            suffix = lambda type: type.replace('_@', '_%d' % abi)
+
+            tables[abi].append((entry, suffix(ret), [(suffix(type), name) for type, name in params]))
+
+    listed = set(entry for entries in abis.values() for entry in entries)
+
+    for name in ('hot', 'impl', 'pe', 'nvtx', 'string'):
+        for entry in sorted(set(directives[name]) - listed):
+            sys.exit('%s: %s entry %s is in no abi' % (path, name, entry))
+
+    for entry in sorted(set(prototypes) - listed):
+        sys.exit('%s: prototype of %s, which is in no abi' % (path, entry))
+
+    return tables, order, directives
+
+
+def trace_format(path, entry, type, name, directives):
+    if name in directives['string'].get(entry, ()):
+        if type != 'const char *':
+            sys.exit('%s: string parameter %s of %s is a %s' % (path, name, entry, type))
+
+        return '%s'
+
+    if type in TRACE_FORMATS:
+        return TRACE_FORMATS[type]
+
+    if type.endswith('*') or type.replace('const ', '') in HANDLE_TYPES:
+        return '%p'
+
+    sys.exit('%s: no trace format for %s, parameter type of %s' % (path, type, entry))
+
+
+def declaration(ret, params):
+    return (ret if ret.endswith('*') else ret + ' '), \
+        ', '.join('%s %s' % param if not param[0].endswith('*') else '%s%s' % param for param in params) or 'void'
+
+
+def thunk(path, abi, entry, ret, params, directives):
+    hot = entry in directives['hot']
+    attributes = 'HOT_THUNK ' if hot else ''
+    ret, signature = declaration(ret, params)
+    args = ', '.join(name for type, name in params)
+    call = '%s_impl' % entry if entry in directives['impl'] else 'optixFunctionTable.%s' % entry
+    result = '' if ret.strip() == 'void' else 'return '
+    out = []
+
+    if entry in directives['impl']:
+        out.append('static %s%s%s_impl(%s);\n\n' % (attributes, ret, entry, signature))
+
+    # a hot build gets the bare ms_abi -> sysv forwarder, everything else the traced thunk
+    if hot:
+        out.append('#ifdef NVOPTIX_HOT_THUNKS\n')
+        out.append('static HOT_THUNK %s__cdecl %s_%d(%s)\n{\n' % (ret, entry, abi, signature))
+        out.append('    %s%s(%s);\n}\n#else\n' % (result, call, args))
+
+    out.append('static %s__cdecl %s_%d(%s)\n{\n' % (ret, entry, abi, signature))
+    out.append('    TRACE("(%s)\\n"%s);\n' % (', '.join(trace_format(path, entry, type, name, directives) for type, name in params), ', ' + args if args else ''))
+
+    if not result:
+        out.append('    %s(%s);\n}\n' % (call, args))
+    else:
+        if not params:
+            sys.exit('%s: %s has no parameters to probe' % (path, entry))
+
+        if entry not in directives['nvtx']:
+            sys.exit('%s: %s has no nvtx domain' % (path, entry))
+
+        out.append('    PROBE(%s__entry, %s);\n' % (entry, args))
+        out.append('    NVTX_RANGE(NVTX_%s, "%s");\n' % (directives['nvtx'][entry].upper(), entry))
+        out.append('    return PROBE_RETURN(%s, %s(%s));\n}\n' % (entry, call, args))
+
+    if hot:
+        out.append('#endif\n')
+
+    return ''.join(out)
+
+
+# the parameters of the Unix call of an entry, the return value last, None for an entry
+# without either
+
+def unix_fields(ret, params):
+    fields = params + ([(ret, 'ret')] if ret != 'void' else [])
+
+    if any(name == 'ret' for type, name in params):
+        sys.exit('parameter ret of an entry clashes with the return value of its Unix call')
+
+    return fields or None
+
+
+def unix_params(abi, entry, ret, params):
+    fields = unix_fields(ret, params)
+
+    if not fields:
+        return ''
+
+    out = ['struct %s_%d_params\n{\n' % (entry, abi)]
+    out.extend('    %s;\n' % ('%s%s' if type.endswith('*') else '%s %s') % (type, name) for type, name in fields)
+    out.append('};\n')
+
+    return ''.join(out)
+
+
+# the Unix side of a unixlib build, calls the thunk of the entry with the parameters the PE
+# thunk packed and tells it whether log messages wait
+
+def unix_thunk(abi, entry, ret, params):
+    fields = unix_fields(ret, params)
+    call = '%s_%d(%s)' % (entry, abi, ', '.join('params->%s' % name for type, name in params))
+    out = ['NTSTATUS unix_thunk_%s_%d(void *args)\n{\n' % (entry, abi)]
+
+    if fields:
+        out.append('    struct %s_%d_params *params = args;\n\n' % (entry, abi))
+
+    out.append('    %s%s;\n' % ('params->ret = ' if ret != 'void' else '', call))
+    out.append('    return log_status();\n}\n')
+
+    return ''.join(out)
+
+
+# the PE side of a unixlib build: packs the parameters and makes the Unix call. A `pe` entry
+# passes through <entry>_pe of nvoptix_pe.c, which gets the packing function first.
+
+def pe_thunk(abi, entry, ret, params, directives):
+    fields = unix_fields(ret, params)
+    ret_decl, signature = declaration(ret, params)
+    args = ', '.join(name for type, name in params)
+    pe = entry in directives['pe']
+    out = []
+
+    out.append('static %s%s%s_%d(%s)\n{\n' % (ret_decl, '' if pe else '__cdecl ', 'call_' + entry if pe else entry, abi, signature))
+
+    if fields:
+        out.append('    struct %s_%d_params args = { %s };\n\n' % (entry, abi, args or '0'))
+
+    out.append('    unix_call(unix_%s_%d, %s);\n' % (entry, abi, '&args' if fields else 'NULL'))
+
+    if ret != 'void':
+        out.append('\n    return args.ret;\n')
+
+    out.append('}\n')
+
+    if pe:
+        out.append('\nstatic %s__cdecl %s_%d(%s)\n{\n' % (ret_decl, entry, abi, signature))
+        out.append('    %s%s_pe(call_%s_%d%s);\n}\n' % ('' if ret == 'void' else 'return ', entry, entry, abi, ', ' + args if args else ''))
+
+    return ''.join(out)
+
+
+def generate(tables, order):
+    out = []
+
+    out.append('/* generated by gen_abi.py from nvoptix_abi.txt, do not edit */\n')
+    out.append('\n#pragma once\n')
+    out.append('\n// every supported ABI, newest first\n\n')
+    out.append('#define OPTIX_MAX_ABI_VERSION %d\n\n' % max(order))
+    out.append('#define NVOPTIX_ABIS(X) \\\n')
+    out.append(''.join('    X(%d) \\\n' % abi for abi in sorted(order, reverse=True)))
+    out.append('\n')
+    out.append('// X(entry, index) for every member of OptixFunctionTable_<abi>, in table order, and the\n')
+    out.append('// members themselves, for the OptixFunctionTable_<abi> of nvoptix_<abi>.h\n')
+
+    for abi in sorted(order, reverse=True):
+        members = tables[abi]
+
+        out.append('\n#define NVOPTIX_ABI_%d_SIZE %d\n\n' % (abi, len(members)))
+        out.append('#define NVOPTIX_ABI_%d_ENTRIES(X) \\\n' % abi)
+        out.append(''.join('    X(%s, %d) \\\n' % (member[0], index) for index, member in enumerate(members)))
+        out.append('\n')
+        out.append('#define NVOPTIX_ABI_%d_TABLE \\\n' % abi)
+
+        for entry, ret, params in members:
+            ret, signature = declaration(ret, params)
+            out.append('    %s(*%s)(%s); \\\n' % (ret, entry, signature))
+
+        out.append('\n')
+
+    return ''.join(out)
+
+
+def generate_thunks(path, tables, order, directives):
+    out = []
+
+    out.append('/* generated by gen_abi.py from nvoptix_abi.txt, do not edit */\n')
+    out.append('\n// the thunks of every entry of the ABI nvoptix_abi.c is compiled for, NVOPTIX_ABI: TRACE,\n')
+    out.append('// the entry probe and the NVTX range around the call, and the return probe. The thunk of\n')
+    out.append('// an `impl` entry calls <entry>_impl of nvoptix_abi.c, the others call the native entry.\n')
+    out.append('\n#include "nvoptix_hot.h"\n#include "nvoptix_nvtx.h"\n#include "nvoptix_probe.h"\n')
+
+    out.append('\n#ifdef WINE_UNIX_LIB\n#include "nvoptix_unix_calls.h"\n#endif\n')
+
+    for index, abi in enumerate(sorted(order, reverse=True)):
+        out.append('\n#%s NVOPTIX_ABI == %d\n' % ('elif' if index else 'if', abi))
+
+        for entry, ret, params in tables[abi]:
+            out.append('\n' + thunk(path, abi, entry, ret, params, directives))
+
+        out.append('\n#ifdef WINE_UNIX_LIB\n')
+
+        for entry, ret, params in tables[abi]:
+            out.append('\n' + unix_thunk(abi, entry, ret, params))
+
+        out.append('\n#endif\n')
+
+    out.append('\n#else\n#error "NVOPTIX_ABI names no ABI"\n#endif\n')
+
+    return ''.join(out)
+
+
+def generate_unix_calls(tables, order):
+    out = []
+    abis = sorted(order, reverse=True)
+
+    out.append('/* generated by gen_abi.py from nvoptix_abi.txt, do not edit */\n')
+    out.append('\n#pragma once\n')
+    out.append('\n// the Unix calls of the entries of every ABI in a unixlib build, after the ones of\n')
+    out.append('// nvoptix_unixlib.h, and their parameters\n')
+    out.append('\n#include "nvoptix_unixlib.h"\n')
+    out.append(''.join('#include "nvoptix_%d.h"\n' % abi for abi in abis))
+
+    for abi in abis:
+        for entry, ret, params in tables[abi]:
+            struct = unix_params(abi, entry, ret, params)
+
+            if struct:
+                out.append('\n' + struct)
+
+    out.append('\nenum nvoptix_unix_entry\n{\n')
+
+    for index, (abi, entry) in enumerate((abi, entry) for abi in abis for entry, ret, params in tables[abi]):
+        out.append('    unix_%s_%d%s,\n' % (entry, abi, '' if index else ' = unix_entry_first'))
+
+    out.append('    unix_call_count\n};\n')
+    out.append('\n#ifdef WINE_UNIX_LIB\n\n')
+    out.append(''.join('NTSTATUS unix_thunk_%s_%d(void *args);\n' % (entry, abi) for abi in abis for entry, ret, params in tables[abi]))
+    out.append('\n#define NVOPTIX_UNIX_THUNKS \\\n')
+    out.append(''.join('    unix_thunk_%s_%d, \\\n' % (entry, abi) for abi in abis for entry, ret, params in tables[abi]))
+    out.append('\n#endif\n')
+
+    return ''.join(out)
+
+
+def generate_pe_thunks(tables, order, directives):
+    out = []
+
+    out.append('/* generated by gen_abi.py from nvoptix_abi.txt, do not edit */\n')
+    out.append('\n// the thunks of the PE nvoptix.dll of a unixlib build, which make the Unix call of their\n')
+    out.append('// entry, and the function tables of every ABI made of them. Included by nvoptix_pe.c.\n')
+
+    for abi in sorted(order, reverse=True):
+        for entry, ret, params in tables[abi]:
+            out.append('\n' + pe_thunk(abi, entry, ret, params, directives))
+
+        out.append('\nstatic void fill_function_table_%d(void *functionTable)\n{\n' % abi)
+        out.append('    void **table = functionTable;\n\n')
+        out.append(''.join('    table[%d] = (void *)%s_%d;\n' % (index, member[0], abi) for index, member in enumerate(tables[abi])))
+        out.append('}\n')
+
+    return ''.join(out)
+
+
+def main():
+    if len(sys.argv) != 6:
+        sys.exit('usage: %s nvoptix_abi.txt nvoptix_abi.h nvoptix_thunks.h nvoptix_unix_calls.h nvoptix_pe_thunks.h' % sys.argv[0])
+
+    tables, order, directives = parse(sys.argv[1])
+
+    with open(sys.argv[2], 'w') as header:
+        header.write(generate(tables, order))
+
+    with open(sys.argv[3], 'w') as header:
+        header.write(generate_thunks(sys.argv[1], tables, order, directives))
+
+    with open(sys.argv[4], 'w') as header:
+        header.write(generate_unix_calls(tables, order))
+
+    with open(sys.argv[5], 'w') as header:
+        header.write(generate_pe_thunks(tables, order, directives))
+
+
+if __name__ == '__main__':
+    main()
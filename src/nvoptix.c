@@ -28,7 +28,11 @@
 #include <pthread.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <strings.h>
+#include <time.h>
 
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
 #include "windef.h"
 #include "winbase.h"
 #include "winnls.h"
@@ -37,6 +41,17 @@
 WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
 
 #include "nvoptix.h"
+#include "nvoptix_abi.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_capture.h"
+#include "nvoptix_compile.h"
+#include "nvoptix_cuda.h"
+#include "nvoptix_denoiser.h"
+#include "nvoptix_manifest.h"
+#include "nvoptix_nvtx.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+#include "nvoptix_timing.h"
 #include "nvoptix_93.h"
 #include "nvoptix_87.h"
 #include "nvoptix_84.h"
@@ -47,11 +62,83 @@ WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
 #include "nvoptix_41.h"
 #include "nvoptix_36.h"
 #include "nvoptix_22.h"
+#ifdef WINE_UNIX_LIB
+#include "nvoptix_unix_calls.h"
+#endif
 
 static void *libnvoptix_handle = NULL;
 OptixResult (*poptixQueryFunctionTable)(int abiId, unsigned int numOptions, void *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable) = NULL;
 
-#define OPTIX_MAX_ABI_VERSION 93
+// `load_mode` decides when libnvoptix.so.1 is opened: during DLL_PROCESS_ATTACH (attach,
+// the default), on the first optixQueryFunctionTable (lazy), or by a thread started at
+// attach and joined on the first optixQueryFunctionTable (background). The last two keep
+// the driver load out of the loader lock and out of processes that never ray trace.
+
+enum load_mode
+{
+    LOAD_ATTACH,
+    LOAD_LAZY,
+    LOAD_BACKGROUND,
+};
+
+static enum load_mode load_mode = LOAD_ATTACH;
+static pthread_once_t load_once = PTHREAD_ONCE_INIT;
+static pthread_t load_thread;
+static BOOL load_thread_started = FALSE;
+static unsigned long long load_ns;
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// also the body of the background thread, which has no TEB and must not log
+
+static void *open_nvoptix(void *arg)
+{
+    unsigned long long start = monotonic_ns();
+
+    if ((libnvoptix_handle = dlopen("libnvoptix.so.1", RTLD_NOW)))
+        *(void **)&poptixQueryFunctionTable = dlsym(libnvoptix_handle, "optixQueryFunctionTable");
+
+    load_ns = monotonic_ns() - start;
+
+    return NULL;
+}
+
+static void finish_load(void)
+{
+    unsigned long long start = monotonic_ns();
+
+    if (load_thread_started)
+    {
+        if (pthread_join(load_thread, NULL)) ERR("Failed to join the loader thread\n");
+    }
+    else if (load_mode != LOAD_ATTACH)
+    {
+        open_nvoptix(NULL);
+    }
+
+    if (!libnvoptix_handle)
+        ERR("Wine cannot find the libnvoptix.so library, NVIDIA Optix support disabled.\n");
+    else if (!poptixQueryFunctionTable)
+        ERR("Can't find symbol %s.\n", "optixQueryFunctionTable");
+
+    TRACE("libnvoptix.so.1 opened in %.3f ms, waited %.3f ms for it\n", load_ns / 1e6, (monotonic_ns() - start) / 1e6);
+}
+
+// every path into the native library goes through optixQueryFunctionTable, which waits here
+
+static BOOL wait_nvoptix(void)
+{
+    pthread_once(&load_once, finish_load);
+
+    return libnvoptix_handle != NULL;
+}
 
 OptixResult __cdecl optixQueryFunctionTable(
     int abiId,
@@ -63,13 +150,7 @@ OptixResult __cdecl optixQueryFunctionTable(
 {
     TRACE("(%d, %u, %p, %p, %p, %zu)\n", abiId, numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
 
-    if (numOptions) FIXME("unexpected numOptions = %u\n", numOptions);
-
-    if (optionKeys) FIXME("unexpected optionKeys = %p\n", optionKeys);
-
-    if (optionValues) FIXME("unexpected optionValues = %p\n", optionValues);
-
-    if (!libnvoptix_handle)
+    if (!wait_nvoptix())
     {
         return OPTIX_ERROR_LIBRARY_NOT_FOUND;
     }
@@ -90,27 +171,14 @@ OptixResult __cdecl optixQueryFunctionTable(
 
     switch (abiId)
     {
-        // TODO: add other ABI versions here
-        case 93:
-            return optixQueryFunctionTable_93(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 87:
-            return optixQueryFunctionTable_87(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 84:
-            return optixQueryFunctionTable_84(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 68:
-            return optixQueryFunctionTable_68(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 60:
-            return optixQueryFunctionTable_60(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 55:
-            return optixQueryFunctionTable_55(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 47:
-            return optixQueryFunctionTable_47(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 41:
-            return optixQueryFunctionTable_41(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 36:
-            return optixQueryFunctionTable_36(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
-        case 22:
-            return optixQueryFunctionTable_22(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
+        #define QUERY_ABI(abi) \
+        case abi: \
+            return optixQueryFunctionTable_ ## abi(numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
+
+        NVOPTIX_ABIS(QUERY_ABI)
+
+        #undef QUERY_ABI
+
         default:
             ERR("abiId = %d not supported\n", abiId);
             return OPTIX_ERROR_UNSUPPORTED_ABI_VERSION;
@@ -125,17 +193,24 @@ int __cdecl rtGetSymbolTable()
 
 static BOOL load_nvoptix(void)
 {
-    if (!(libnvoptix_handle = dlopen("libnvoptix.so.1", RTLD_NOW)))
+    const char *mode = profile_get("load_mode");
+
+    if (!mode || !strcasecmp(mode, "attach"))
+        load_mode = LOAD_ATTACH;
+    else if (!strcasecmp(mode, "lazy"))
+        load_mode = LOAD_LAZY;
+    else if (!strcasecmp(mode, "background"))
+        load_mode = LOAD_BACKGROUND;
+    else
+        ERR("Invalid load_mode = %s\n", debugstr_a(mode));
+
+    if (load_mode == LOAD_ATTACH)
     {
-        ERR("Wine cannot find the libnvoptix.so library, NVIDIA Optix support disabled.\n");
-        return FALSE;
-    }
+        open_nvoptix(NULL);
 
-    #define LOAD_FUNCPTR(f) if (!(*(void **)(&p##f) = dlsym(libnvoptix_handle, #f))) { ERR("Can't find symbol %s.\n", #f); goto fail; }
-
-    LOAD_FUNCPTR(optixQueryFunctionTable);
-
-    #undef LOAD_FUNCPTR
+        if (!wait_nvoptix()) return FALSE;
+        if (!poptixQueryFunctionTable) goto fail;
+    }
 
     if (callbacks_enabled())
     {
@@ -167,25 +242,116 @@ static BOOL load_nvoptix(void)
             ERR("Failed to destroy rwlockattr.\n");
     }
 
+    if (load_mode == LOAD_BACKGROUND)
+    {
+        if (!(load_thread_started = !pthread_create(&load_thread, NULL, open_nvoptix, NULL)))
+            ERR("Failed to start the loader thread, loading on first use\n");
+    }
+
+    if (load_mode != LOAD_ATTACH)
+        WARN("Loading libnvoptix.so.1 %s\n", load_mode == LOAD_LAZY ? "on first use" : "in the background");
+
     return TRUE;
 
 fail:
-    dlclose(libnvoptix_handle);
+    if (libnvoptix_handle) dlclose(libnvoptix_handle);
+    libnvoptix_handle = NULL;
     return FALSE;
 }
 
 static void unload_nvoptix(void)
 {
+    // a loader thread nobody waited for yet must finish before the handle is closed
+
+    if (load_thread_started) wait_nvoptix();
+
     if (libnvoptix_handle)
         dlclose(libnvoptix_handle);
 
     if (callbacks)
         free(callbacks);
 
+    manifest_close();
+    accel_close();
+    accel_build_close();
+    stats_close();
+    accel_compaction_close();
+    accel_memory_close();
+    accel_graph_close();
+    denoiser_close();
+    gpu_timing_close();
+    nvtx_close();
+    compile_close();
+    capture_close();
+    cuda_close();
+
     if (callbacks_enabled() && pthread_rwlock_destroy(&callbacks_lock))
         ERR("Failed to destroy rwlock.\n");
 }
 
+#ifdef WINE_UNIX_LIB
+
+// the Unix side of a unixlib build, see nvoptix_pe.c. Wine keeps nvoptix.so loaded after
+// nvoptix.dll is freed, the relay's state is gone by then and it can't be attached again.
+
+static BOOL detached = FALSE;
+
+NTSTATUS unixlib_process_attach(void *args)
+{
+    const struct process_attach_params *params = args;
+
+    if (detached)
+    {
+        ERR("nvoptix.dll loaded again after it was freed, a unixlib build can't do that\n");
+        return STATUS_DLL_INIT_FAILED;
+    }
+
+    profile_set_executable(params->executable);
+
+    return load_nvoptix() ? STATUS_SUCCESS : STATUS_DLL_INIT_FAILED;
+}
+
+// as DLL_PROCESS_DETACH of DllMain below
+
+NTSTATUS unixlib_process_detach(void *args)
+{
+    const struct process_detach_params *params = args;
+
+    if (params->terminating)
+    {
+        capture_flush();
+        return STATUS_SUCCESS;
+    }
+
+    unload_nvoptix();
+    detached = TRUE;
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS unixlib_query_function_table(void *args)
+{
+    struct query_function_table_params *params = args;
+
+    params->ret = optixQueryFunctionTable(params->abiId, params->numOptions, params->optionKeys, params->optionValues,
+                                          params->functionTable, params->sizeOfTable);
+
+    return log_status();
+}
+
+const unixlib_entry_t __wine_unix_call_funcs[] =
+{
+    unixlib_process_attach,
+    unixlib_process_detach,
+    unixlib_query_function_table,
+    unixlib_log_drain,
+    NVOPTIX_UNIX_THUNKS
+};
+
+C_ASSERT(ARRAY_SIZE(__wine_unix_call_funcs) == unix_call_count);
+
+#else
+
 BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved)
 {
     TRACE("(%p, %u, %p)\n", instance, reason, reserved);
@@ -197,10 +363,16 @@ BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved)
             if (!load_nvoptix()) return FALSE;
             break;
         case DLL_PROCESS_DETACH:
-            if (reserved) break;
+            if (reserved)
+            {
+                capture_flush();
+                break;
+            }
             unload_nvoptix();
             break;
     }
 
     return TRUE;
 }
+
+#endif
@@ -21,7 +21,9 @@
 #pragma once
 
 #include <stddef.h>
+#ifndef NVOPTIX_PE
 #include <pthread.h>
+#endif
 
 // opaque pointers, I'm assuming these stay the same no matter the ABI version
 
@@ -66,6 +68,10 @@ typedef void (*OptixLogCallback)(unsigned int level, const char *tag, const char
 
 typedef unsigned long long OptixTraversableHandle;
 
+// the relay's own, the PE side of a unixlib build only passes calls on
+
+#ifndef NVOPTIX_PE
+
 // declare a variable for our pointer to function from native libnvoptix.so
 
 extern OptixResult (*poptixQueryFunctionTable)(int abiId, unsigned int numOptions, void *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
@@ -76,10 +82,13 @@ struct callback_t
 {
     OptixLogCallback __attribute((ms_abi)) func;
     void* data;
+    unsigned int level;
 };
 
 extern pthread_rwlock_t callbacks_lock;
 extern struct callback_t *callbacks;
 _Bool callbacks_enabled(void);
-void *wrap_callback(OptixLogCallback func, void *data);
+void *wrap_callback(OptixLogCallback func, void *data, unsigned int level);
 void log_callback(unsigned int level, const char *tag, const char *message, void *cbdata);
+
+#endif
@@ -21,6 +21,7 @@
 #pragma once
 
 #include "nvoptix.h"
+#include "nvoptix_abi.h"
 #include <stddef.h>
 
 // defensive duplicate of OptixDeviceContextOptions because I have to modify it
@@ -32,47 +33,86 @@ typedef struct OptixDeviceContextOptions_36
     int logCallbackLevel;
 } OptixDeviceContextOptions_36;
 
-// table as in public docs but stripped of most structures (pointers to which have been replaced with opaque `void*`)
+// duplicates of the compile option structures, the module manifest and the profile overrides have to look inside them
+
+typedef struct OptixModuleCompileOptions_36
+{
+    int maxRegisterCount;
+    int optLevel;
+    int debugLevel;
+} OptixModuleCompileOptions_36;
+
+typedef struct OptixPipelineCompileOptions_36
+{
+    int usesMotionBlur;
+    unsigned int traversableGraphFlags;
+    int numPayloadValues;
+    int numAttributeValues;
+    unsigned int exceptionFlags;
+    const char *pipelineLaunchParamsVariableName;
+    unsigned int usesPrimitiveTypeFlags;
+} OptixPipelineCompileOptions_36;
+
+typedef struct OptixBuiltinISOptions_36
+{
+    int builtinISModuleType;
+} OptixBuiltinISOptions_36;
+
+typedef struct OptixPipelineLinkOptions_36
+{
+    unsigned int maxTraceDepth;
+    int debugLevel;
+} OptixPipelineLinkOptions_36;
+
+// duplicates of the acceleration structure build structures, the build flag rules rewrite them
+
+typedef struct OptixMotionOptions_36
+{
+    unsigned short numKeys;
+    unsigned short flags;
+    float timeBegin;
+    float timeEnd;
+} OptixMotionOptions_36;
+
+typedef struct OptixAccelBuildOptions_36
+{
+    unsigned int buildFlags;
+    int operation;
+    OptixMotionOptions_36 motionOptions;
+} OptixAccelBuildOptions_36;
+
+typedef struct OptixAccelBufferSizes_36
+{
+    size_t outputSizeInBytes;
+    size_t tempSizeInBytes;
+    size_t tempUpdateSizeInBytes;
+} OptixAccelBufferSizes_36;
+
+// duplicate of the denoiser options, pooled denoisers are matched on them
+
+typedef struct OptixDenoiserOptions_36
+{
+    int inputKind;
+} OptixDenoiserOptions_36;
+
+// duplicates of the denoiser image structures, tiled denoising splits them
+
+typedef struct OptixImage2D_36
+{
+    CUdeviceptr data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int rowStrideInBytes;
+    unsigned int pixelStrideInBytes;
+    int format;
+} OptixImage2D_36;
+
+// table as in public docs but stripped of most structures (pointers to which have been replaced with opaque `void*`),
+// generated from nvoptix_abi.txt
 
 typedef struct OptixFunctionTable_36
 {
-    const char *(*optixGetErrorName)(OptixResult result);
-    const char *(*optixGetErrorString)(OptixResult result);
-    OptixResult (*optixDeviceContextCreate)(CUcontext fromContext, const OptixDeviceContextOptions_36 *options, OptixDeviceContext *context);
-    OptixResult (*optixDeviceContextDestroy)(OptixDeviceContext context);
-    OptixResult (*optixDeviceContextGetProperty)(OptixDeviceContext context, int property, void *value, size_t sizeInBytes);
-    OptixResult (*optixDeviceContextSetLogCallback)(OptixDeviceContext context, OptixLogCallback callbackFunction, void *callbackData, unsigned int callbackLevel);
-    OptixResult (*optixDeviceContextSetCacheEnabled)(OptixDeviceContext context, int enabled);
-    OptixResult (*optixDeviceContextSetCacheLocation)(OptixDeviceContext context, const char *location);
-    OptixResult (*optixDeviceContextSetCacheDatabaseSizes)(OptixDeviceContext context, size_t lowWaterMark, size_t highWaterMark);
-    OptixResult (*optixDeviceContextGetCacheEnabled)(OptixDeviceContext context, int *enabled);
-    OptixResult (*optixDeviceContextGetCacheLocation)(OptixDeviceContext context, char *location, size_t locationSize);
-    OptixResult (*optixDeviceContextGetCacheDatabaseSizes)(OptixDeviceContext context, size_t *lowWaterMark, size_t *highWaterMark);
-    OptixResult (*optixModuleCreateFromPTX)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *PTX, size_t PTXsize, char *logString, size_t *logStringSize, OptixModule *module);
-    OptixResult (*optixModuleDestroy)(OptixModule module);
-    OptixResult (*optixBuiltinISModuleGet)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const void *builtinISOptions, OptixModule *builtinModule);
-    OptixResult (*optixProgramGroupCreate)(OptixDeviceContext context, const void *programDescriptions, unsigned int numProgramGroups, const void *options, char *logString, size_t *logStringSize, OptixProgramGroup *programGroups);
-    OptixResult (*optixProgramGroupDestroy)(OptixProgramGroup programGroup);
-    OptixResult (*optixProgramGroupGetStackSize)(OptixProgramGroup programGroup, void *stackSizes);
-    OptixResult (*optixPipelineCreate)(OptixDeviceContext context, const void *pipelineCompileOptions, const void *pipelineLinkOptions, const OptixProgramGroup *programGroups, unsigned int numProgramGroups, char *logString, size_t *logStringSize, OptixPipeline *pipeline);
-    OptixResult (*optixPipelineDestroy)(OptixPipeline pipeline);
-    OptixResult (*optixPipelineSetStackSize)(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState, unsigned int continuationStackSize, unsigned int maxTraversableGraphDepth);
-    OptixResult (*optixAccelComputeMemoryUsage)(OptixDeviceContext context, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, void *bufferSizes);
-    OptixResult (*optixAccelBuild)(OptixDeviceContext context, CUstream stream, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle, const void *emittedProperties, unsigned int numEmittedProperties);
-    OptixResult (*optixAccelGetRelocationInfo)(OptixDeviceContext context, OptixTraversableHandle handle, void *info);
-    OptixResult (*optixAccelCheckRelocationCompatibility)(OptixDeviceContext context, const void *info, int *compatible);
-    OptixResult (*optixAccelRelocate)(OptixDeviceContext context, CUstream stream, const void *info, CUdeviceptr instanceTraversableHandles, size_t numInstanceTraversableHandles, CUdeviceptr targetAccel, size_t targetAccelSizeInBytes, OptixTraversableHandle *targetHandle);
-    OptixResult (*optixAccelCompact)(OptixDeviceContext context, CUstream stream, OptixTraversableHandle inputHandle, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle);
-    OptixResult (*optixConvertPointerToTraversableHandle)(OptixDeviceContext onDevice, CUdeviceptr pointer, int traversableType, OptixTraversableHandle *traversableHandle);
-    OptixResult (*optixSbtRecordPackHeader)(OptixProgramGroup programGroup, void *sbtRecordHeaderHostPointer);
-    OptixResult (*optixLaunch)(OptixPipeline pipeline, CUstream stream, CUdeviceptr pipelineParams, size_t pipelineParamsSize, const void *sbt, unsigned int width, unsigned int height, unsigned int depth);
-    OptixResult (*optixDenoiserCreate)(OptixDeviceContext context, const void *options, OptixDenoiser *returnHandle);
-    OptixResult (*optixDenoiserDestroy)(OptixDenoiser handle);
-    OptixResult (*optixDenoiserComputeMemoryResources)(const OptixDenoiser handle, unsigned int maximumInputWidth, unsigned int maximumInputHeight, void *returnSizes);
-    OptixResult (*optixDenoiserSetup)(OptixDenoiser denoiser, CUstream stream, unsigned int inputWidth, unsigned int inputHeight, CUdeviceptr state, size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserInvoke)(OptixDenoiser denoiser, CUstream stream, const void *params, CUdeviceptr denoiserState, size_t denoiserStateSizeInBytes, const void *layers, unsigned int numLayers, unsigned int inputOffsetX, unsigned int inputOffsetY, const void *outputLayer, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserSetModel)(OptixDenoiser handle, int kind, void *data, size_t sizeInBytes);
-    OptixResult (*optixDenoiserComputeIntensity)(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputIntensity, CUdeviceptr scratch, size_t scratchSizeInBytes);
+    NVOPTIX_ABI_36_TABLE
 } OptixFunctionTable_36;
 
 OptixResult __cdecl optixQueryFunctionTable_36(unsigned int numOptions, int *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
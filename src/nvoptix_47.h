@@ -21,6 +21,7 @@
 #pragma once
 
 #include "nvoptix.h"
+#include "nvoptix_abi.h"
 #include <stddef.h>
 
 // defensive duplicate of OptixDeviceContextOptions because I have to modify it
@@ -33,48 +34,112 @@ typedef struct OptixDeviceContextOptions_47
     int validationMode;
 } OptixDeviceContextOptions_47;
 
-// table as in public docs but stripped of most structures (pointers to which have been replaced with opaque `void*`)
+// duplicates of the compile option structures, the module manifest and the profile overrides have to look inside them
+
+typedef struct OptixModuleCompileBoundValueEntry_47
+{
+    size_t pipelineParamOffsetInBytes;
+    size_t sizeInBytes;
+    const void *boundValuePtr;
+    const char *annotation;
+} OptixModuleCompileBoundValueEntry_47;
+
+typedef struct OptixModuleCompileOptions_47
+{
+    int maxRegisterCount;
+    int optLevel;
+    int debugLevel;
+    const OptixModuleCompileBoundValueEntry_47 *boundValues;
+    unsigned int numBoundValues;
+} OptixModuleCompileOptions_47;
+
+typedef struct OptixPipelineCompileOptions_47
+{
+    int usesMotionBlur;
+    unsigned int traversableGraphFlags;
+    int numPayloadValues;
+    int numAttributeValues;
+    unsigned int exceptionFlags;
+    const char *pipelineLaunchParamsVariableName;
+    unsigned int usesPrimitiveTypeFlags;
+} OptixPipelineCompileOptions_47;
+
+typedef struct OptixBuiltinISOptions_47
+{
+    int builtinISModuleType;
+    int usesMotionBlur;
+} OptixBuiltinISOptions_47;
+
+typedef struct OptixPipelineLinkOptions_47
+{
+    unsigned int maxTraceDepth;
+    int debugLevel;
+} OptixPipelineLinkOptions_47;
+
+// duplicates of the acceleration structure build structures, the build flag rules rewrite them
+
+typedef struct OptixMotionOptions_47
+{
+    unsigned short numKeys;
+    unsigned short flags;
+    float timeBegin;
+    float timeEnd;
+} OptixMotionOptions_47;
+
+typedef struct OptixAccelBuildOptions_47
+{
+    unsigned int buildFlags;
+    int operation;
+    OptixMotionOptions_47 motionOptions;
+} OptixAccelBuildOptions_47;
+
+typedef struct OptixAccelBufferSizes_47
+{
+    size_t outputSizeInBytes;
+    size_t tempSizeInBytes;
+    size_t tempUpdateSizeInBytes;
+} OptixAccelBufferSizes_47;
+
+// duplicate of the denoiser options, pooled denoisers are matched on them
+
+typedef struct OptixDenoiserOptions_47
+{
+    unsigned int guideAlbedo;
+    unsigned int guideNormal;
+} OptixDenoiserOptions_47;
+
+// duplicates of the denoiser image structures, tiled denoising splits them
+
+typedef struct OptixImage2D_47
+{
+    CUdeviceptr data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int rowStrideInBytes;
+    unsigned int pixelStrideInBytes;
+    int format;
+} OptixImage2D_47;
+
+typedef struct OptixDenoiserGuideLayer_47
+{
+    OptixImage2D_47 albedo;
+    OptixImage2D_47 normal;
+    OptixImage2D_47 flow;
+} OptixDenoiserGuideLayer_47;
+
+typedef struct OptixDenoiserLayer_47
+{
+    OptixImage2D_47 input;
+    OptixImage2D_47 previousOutput;
+    OptixImage2D_47 output;
+} OptixDenoiserLayer_47;
+
+// table as in public docs but stripped of most structures (pointers to which have been replaced with opaque `void*`),
+// generated from nvoptix_abi.txt
 
 typedef struct OptixFunctionTable_47
 {
-    const char *(*optixGetErrorName)(OptixResult result);
-    const char *(*optixGetErrorString)(OptixResult result);
-    OptixResult (*optixDeviceContextCreate)(CUcontext fromContext, const OptixDeviceContextOptions_47 *options, OptixDeviceContext *context);
-    OptixResult (*optixDeviceContextDestroy)(OptixDeviceContext context);
-    OptixResult (*optixDeviceContextGetProperty)(OptixDeviceContext context, int property, void *value, size_t sizeInBytes);
-    OptixResult (*optixDeviceContextSetLogCallback)(OptixDeviceContext context, OptixLogCallback callbackFunction, void *callbackData, unsigned int callbackLevel);
-    OptixResult (*optixDeviceContextSetCacheEnabled)(OptixDeviceContext context, int enabled);
-    OptixResult (*optixDeviceContextSetCacheLocation)(OptixDeviceContext context, const char *location);
-    OptixResult (*optixDeviceContextSetCacheDatabaseSizes)(OptixDeviceContext context, size_t lowWaterMark, size_t highWaterMark);
-    OptixResult (*optixDeviceContextGetCacheEnabled)(OptixDeviceContext context, int *enabled);
-    OptixResult (*optixDeviceContextGetCacheLocation)(OptixDeviceContext context, char *location, size_t locationSize);
-    OptixResult (*optixDeviceContextGetCacheDatabaseSizes)(OptixDeviceContext context, size_t *lowWaterMark, size_t *highWaterMark);
-    OptixResult (*optixModuleCreateFromPTX)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *PTX, size_t PTXsize, char *logString, size_t *logStringSize, OptixModule *module);
-    OptixResult (*optixModuleDestroy)(OptixModule module);
-    OptixResult (*optixBuiltinISModuleGet)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const void *builtinISOptions, OptixModule *builtinModule);
-    OptixResult (*optixProgramGroupCreate)(OptixDeviceContext context, const void *programDescriptions, unsigned int numProgramGroups, const void *options, char *logString, size_t *logStringSize, OptixProgramGroup *programGroups);
-    OptixResult (*optixProgramGroupDestroy)(OptixProgramGroup programGroup);
-    OptixResult (*optixProgramGroupGetStackSize)(OptixProgramGroup programGroup, void *stackSizes);
-    OptixResult (*optixPipelineCreate)(OptixDeviceContext context, const void *pipelineCompileOptions, const void *pipelineLinkOptions, const OptixProgramGroup *programGroups, unsigned int numProgramGroups, char *logString, size_t *logStringSize, OptixPipeline *pipeline);
-    OptixResult (*optixPipelineDestroy)(OptixPipeline pipeline);
-    OptixResult (*optixPipelineSetStackSize)(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState, unsigned int continuationStackSize, unsigned int maxTraversableGraphDepth);
-    OptixResult (*optixAccelComputeMemoryUsage)(OptixDeviceContext context, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, void *bufferSizes);
-    OptixResult (*optixAccelBuild)(OptixDeviceContext context, CUstream stream, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle, const void *emittedProperties, unsigned int numEmittedProperties);
-    OptixResult (*optixAccelGetRelocationInfo)(OptixDeviceContext context, OptixTraversableHandle handle, void *info);
-    OptixResult (*optixAccelCheckRelocationCompatibility)(OptixDeviceContext context, const void *info, int *compatible);
-    OptixResult (*optixAccelRelocate)(OptixDeviceContext context, CUstream stream, const void *info, CUdeviceptr instanceTraversableHandles, size_t numInstanceTraversableHandles, CUdeviceptr targetAccel, size_t targetAccelSizeInBytes, OptixTraversableHandle *targetHandle);
-    OptixResult (*optixAccelCompact)(OptixDeviceContext context, CUstream stream, OptixTraversableHandle inputHandle, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle);
-    OptixResult (*optixConvertPointerToTraversableHandle)(OptixDeviceContext onDevice, CUdeviceptr pointer, int traversableType, OptixTraversableHandle *traversableHandle);
-    OptixResult (*optixSbtRecordPackHeader)(OptixProgramGroup programGroup, void *sbtRecordHeaderHostPointer);
-    OptixResult (*optixLaunch)(OptixPipeline pipeline, CUstream stream, CUdeviceptr pipelineParams, size_t pipelineParamsSize, const void *sbt, unsigned int width, unsigned int height, unsigned int depth);
-    OptixResult (*optixDenoiserCreate)(OptixDeviceContext context, int modelKind, const void *options, OptixDenoiser *returnHandle);
-    OptixResult (*optixDenoiserDestroy)(OptixDenoiser handle);
-    OptixResult (*optixDenoiserComputeMemoryResources)(const OptixDenoiser handle, unsigned int maximumInputWidth, unsigned int maximumInputHeight, void *returnSizes);
-    OptixResult (*optixDenoiserSetup)(OptixDenoiser denoiser, CUstream stream, unsigned int inputWidth, unsigned int inputHeight, CUdeviceptr state, size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserInvoke)(OptixDenoiser denoiser, CUstream stream, const void *params, CUdeviceptr denoiserState, size_t denoiserStateSizeInBytes, const void *guideLayer, const void *layers, unsigned int numLayers, unsigned int inputOffsetX, unsigned int inputOffsetY, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserComputeIntensity)(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputIntensity, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserComputeAverageColor)(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputAverageColor, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserCreateWithUserModel)(OptixDeviceContext context, const void *data, size_t dataSizeInBytes, OptixDenoiser *returnHandle);
+    NVOPTIX_ABI_47_TABLE
 } OptixFunctionTable_47;
 
 OptixResult __cdecl optixQueryFunctionTable_47(unsigned int numOptions, int *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
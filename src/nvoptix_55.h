@@ -21,6 +21,7 @@
 #pragma once
 
 #include "nvoptix.h"
+#include "nvoptix_abi.h"
 #include <stddef.h>
 
 // defensive duplicate of OptixDeviceContextOptions because I have to modify it
@@ -33,53 +34,122 @@ typedef struct OptixDeviceContextOptions_55
     int validationMode;
 } OptixDeviceContextOptions_55;
 
-// table as in public docs but stripped of most structures (pointers to which have been replaced with opaque `void*`)
+// duplicates of the compile option structures, the module manifest and the profile overrides have to look inside them
+
+typedef struct OptixModuleCompileBoundValueEntry_55
+{
+    size_t pipelineParamOffsetInBytes;
+    size_t sizeInBytes;
+    const void *boundValuePtr;
+    const char *annotation;
+} OptixModuleCompileBoundValueEntry_55;
+
+typedef struct OptixPayloadType_55
+{
+    unsigned int numPayloadValues;
+    const unsigned int *payloadSemantics;
+} OptixPayloadType_55;
+
+typedef struct OptixModuleCompileOptions_55
+{
+    int maxRegisterCount;
+    int optLevel;
+    int debugLevel;
+    const OptixModuleCompileBoundValueEntry_55 *boundValues;
+    unsigned int numBoundValues;
+    unsigned int numPayloadTypes;
+    const OptixPayloadType_55 *payloadTypes;
+} OptixModuleCompileOptions_55;
+
+typedef struct OptixPipelineCompileOptions_55
+{
+    int usesMotionBlur;
+    unsigned int traversableGraphFlags;
+    int numPayloadValues;
+    int numAttributeValues;
+    unsigned int exceptionFlags;
+    const char *pipelineLaunchParamsVariableName;
+    unsigned int usesPrimitiveTypeFlags;
+} OptixPipelineCompileOptions_55;
+
+typedef struct OptixBuiltinISOptions_55
+{
+    int builtinISModuleType;
+    int usesMotionBlur;
+    unsigned int buildFlags;
+    unsigned int curveEndcapFlags;
+} OptixBuiltinISOptions_55;
+
+typedef struct OptixPipelineLinkOptions_55
+{
+    unsigned int maxTraceDepth;
+    int debugLevel;
+} OptixPipelineLinkOptions_55;
+
+// duplicates of the acceleration structure build structures, the build flag rules rewrite them
+
+typedef struct OptixMotionOptions_55
+{
+    unsigned short numKeys;
+    unsigned short flags;
+    float timeBegin;
+    float timeEnd;
+} OptixMotionOptions_55;
+
+typedef struct OptixAccelBuildOptions_55
+{
+    unsigned int buildFlags;
+    int operation;
+    OptixMotionOptions_55 motionOptions;
+} OptixAccelBuildOptions_55;
+
+typedef struct OptixAccelBufferSizes_55
+{
+    size_t outputSizeInBytes;
+    size_t tempSizeInBytes;
+    size_t tempUpdateSizeInBytes;
+} OptixAccelBufferSizes_55;
+
+// duplicate of the denoiser options, pooled denoisers are matched on them
+
+typedef struct OptixDenoiserOptions_55
+{
+    unsigned int guideAlbedo;
+    unsigned int guideNormal;
+} OptixDenoiserOptions_55;
+
+// duplicates of the denoiser image structures, tiled denoising splits them
+
+typedef struct OptixImage2D_55
+{
+    CUdeviceptr data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int rowStrideInBytes;
+    unsigned int pixelStrideInBytes;
+    int format;
+} OptixImage2D_55;
+
+typedef struct OptixDenoiserGuideLayer_55
+{
+    OptixImage2D_55 albedo;
+    OptixImage2D_55 normal;
+    OptixImage2D_55 flow;
+} OptixDenoiserGuideLayer_55;
+
+typedef struct OptixDenoiserLayer_55
+{
+    OptixImage2D_55 input;
+    OptixImage2D_55 previousOutput;
+    OptixImage2D_55 output;
+} OptixDenoiserLayer_55;
+
+// table as in public docs but stripped of most structures (pointers to which have been replaced with opaque `void*`),
+// generated from nvoptix_abi.txt
 
 typedef struct OptixFunctionTable_55
 {
-    const char *(*optixGetErrorName)(OptixResult result);
-    const char *(*optixGetErrorString)(OptixResult result);
-    OptixResult (*optixDeviceContextCreate)(CUcontext fromContext, const OptixDeviceContextOptions_55 *options, OptixDeviceContext *context);
-    OptixResult (*optixDeviceContextDestroy)(OptixDeviceContext context);
-    OptixResult (*optixDeviceContextGetProperty)(OptixDeviceContext context, int property, void *value, size_t sizeInBytes);
-    OptixResult (*optixDeviceContextSetLogCallback)(OptixDeviceContext context, OptixLogCallback callbackFunction, void *callbackData, unsigned int callbackLevel);
-    OptixResult (*optixDeviceContextSetCacheEnabled)(OptixDeviceContext context, int enabled);
-    OptixResult (*optixDeviceContextSetCacheLocation)(OptixDeviceContext context, const char *location);
-    OptixResult (*optixDeviceContextSetCacheDatabaseSizes)(OptixDeviceContext context, size_t lowWaterMark, size_t highWaterMark);
-    OptixResult (*optixDeviceContextGetCacheEnabled)(OptixDeviceContext context, int *enabled);
-    OptixResult (*optixDeviceContextGetCacheLocation)(OptixDeviceContext context, char *location, size_t locationSize);
-    OptixResult (*optixDeviceContextGetCacheDatabaseSizes)(OptixDeviceContext context, size_t *lowWaterMark, size_t *highWaterMark);
-    OptixResult (*optixModuleCreateFromPTX)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *PTX, size_t PTXsize, char *logString, size_t *logStringSize, OptixModule *module);
-    OptixResult (*optixModuleCreateFromPTXWithTasks)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *PTX, size_t PTXsize, char *logString, size_t *logStringSize, OptixModule *module, OptixTask *firstTask);
-    OptixResult (*optixModuleGetCompilationState)(OptixModule module, int *state);
-    OptixResult (*optixModuleDestroy)(OptixModule module);
-    OptixResult (*optixBuiltinISModuleGet)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const void *builtinISOptions, OptixModule *builtinModule);
-    OptixResult (*optixTaskExecute)(OptixTask task, OptixTask *additionalTasks, unsigned int maxNumAdditionalTasks, unsigned int *numAdditionalTasksCreated);
-    OptixResult (*optixProgramGroupCreate)(OptixDeviceContext context, const void *programDescriptions, unsigned int numProgramGroups, const void *options, char *logString, size_t *logStringSize, OptixProgramGroup *programGroups);
-    OptixResult (*optixProgramGroupDestroy)(OptixProgramGroup programGroup);
-    OptixResult (*optixProgramGroupGetStackSize)(OptixProgramGroup programGroup, void *stackSizes);
-    OptixResult (*optixPipelineCreate)(OptixDeviceContext context, const void *pipelineCompileOptions, const void *pipelineLinkOptions, const OptixProgramGroup *programGroups, unsigned int numProgramGroups, char *logString, size_t *logStringSize, OptixPipeline *pipeline);
-    OptixResult (*optixPipelineDestroy)(OptixPipeline pipeline);
-    OptixResult (*optixPipelineSetStackSize)(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState, unsigned int continuationStackSize, unsigned int maxTraversableGraphDepth);
-    OptixResult (*optixAccelComputeMemoryUsage)(OptixDeviceContext context, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, void *bufferSizes);
-    OptixResult (*optixAccelBuild)(OptixDeviceContext context, CUstream stream, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle, const void *emittedProperties, unsigned int numEmittedProperties);
-    OptixResult (*optixAccelGetRelocationInfo)(OptixDeviceContext context, OptixTraversableHandle handle, void *info);
-    OptixResult (*optixAccelCheckRelocationCompatibility)(OptixDeviceContext context, const void *info, int *compatible);
-    OptixResult (*optixAccelRelocate)(OptixDeviceContext context, CUstream stream, const void *info, CUdeviceptr instanceTraversableHandles, size_t numInstanceTraversableHandles, CUdeviceptr targetAccel, size_t targetAccelSizeInBytes, OptixTraversableHandle *targetHandle);
-    OptixResult (*optixAccelCompact)(OptixDeviceContext context, CUstream stream, OptixTraversableHandle inputHandle, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle);
-    OptixResult (*optixConvertPointerToTraversableHandle)(OptixDeviceContext onDevice, CUdeviceptr pointer, int traversableType, OptixTraversableHandle *traversableHandle);
-    void (*reserved1)(void);
-    void (*reserved2)(void);
-    OptixResult (*optixSbtRecordPackHeader)(OptixProgramGroup programGroup, void *sbtRecordHeaderHostPointer);
-    OptixResult (*optixLaunch)(OptixPipeline pipeline, CUstream stream, CUdeviceptr pipelineParams, size_t pipelineParamsSize, const void *sbt, unsigned int width, unsigned int height, unsigned int depth);
-    OptixResult (*optixDenoiserCreate)(OptixDeviceContext context, int modelKind, const void *options, OptixDenoiser *returnHandle);
-    OptixResult (*optixDenoiserDestroy)(OptixDenoiser handle);
-    OptixResult (*optixDenoiserComputeMemoryResources)(const OptixDenoiser handle, unsigned int maximumInputWidth, unsigned int maximumInputHeight, void *returnSizes);
-    OptixResult (*optixDenoiserSetup)(OptixDenoiser denoiser, CUstream stream, unsigned int inputWidth, unsigned int inputHeight, CUdeviceptr state, size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserInvoke)(OptixDenoiser denoiser, CUstream stream, const void *params, CUdeviceptr denoiserState, size_t denoiserStateSizeInBytes, const void *guideLayer, const void *layers, unsigned int numLayers, unsigned int inputOffsetX, unsigned int inputOffsetY, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserComputeIntensity)(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputIntensity, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserComputeAverageColor)(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputAverageColor, CUdeviceptr scratch, size_t scratchSizeInBytes);
-    OptixResult (*optixDenoiserCreateWithUserModel)(OptixDeviceContext context, const void *data, size_t dataSizeInBytes, OptixDenoiser *returnHandle);
+    NVOPTIX_ABI_55_TABLE
 } OptixFunctionTable_55;
 
 OptixResult __cdecl optixQueryFunctionTable_55(unsigned int numOptions, int *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
@@ -0,0 +1,888 @@
+/*
+ * MIT License
+ * Copyright (C) 2023-2024 Sveinar Søpler
+ * Copyright (C) 2023 Krzysztof Bogacki
+ * Copyright (C) 2022 Timothée Barral
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// the relay side of one ABI. meson compiles this once for every ABI of nvoptix_abi.txt,
+// through the nvoptix_<abi>.c it generates from nvoptix_abi.c.in, which defines NVOPTIX_ABI
+// and NVOPTIX_ABI_H, the nvoptix_<abi>.h of the ABI. Entries and structures that changed
+// between ABIs are told apart by NVOPTIX_ABI.
+
+#ifndef NVOPTIX_ABI
+#error "nvoptix_abi.c is compiled through the nvoptix_<abi>.c of every ABI"
+#endif
+
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "winnls.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include "nvoptix.h"
+#include "nvoptix_abi.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_capture.h"
+#include "nvoptix_compile.h"
+#include NVOPTIX_ABI_H
+#include "nvoptix_denoiser.h"
+#include "nvoptix_hot.h"
+#include "nvoptix_manifest.h"
+#include "nvoptix_nvtx.h"
+#include "nvoptix_probe.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_timing.h"
+
+// <name>_<abi>, the structures of nvoptix_<abi>.h and the exported names of the ABI
+
+#define ABI_NAME(name) ABI_NAME_(name, NVOPTIX_ABI)
+#define ABI_NAME_(name, abi) ABI_NAME__(name, abi)
+#define ABI_NAME__(name, abi) name ## _ ## abi
+
+#define ABI_ENTRIES(X) ABI_ENTRIES_(NVOPTIX_ABI, X)
+#define ABI_ENTRIES_(abi, X) ABI_ENTRIES__(abi, X)
+#define ABI_ENTRIES__(abi, X) NVOPTIX_ABI_ ## abi ## _ENTRIES(X)
+
+typedef ABI_NAME(OptixFunctionTable) OptixFunctionTable;
+typedef ABI_NAME(OptixDeviceContextOptions) OptixDeviceContextOptions;
+typedef ABI_NAME(OptixModuleCompileOptions) OptixModuleCompileOptions;
+typedef ABI_NAME(OptixPipelineCompileOptions) OptixPipelineCompileOptions;
+typedef ABI_NAME(OptixPipelineLinkOptions) OptixPipelineLinkOptions;
+typedef ABI_NAME(OptixAccelBuildOptions) OptixAccelBuildOptions;
+typedef ABI_NAME(OptixAccelBufferSizes) OptixAccelBufferSizes;
+typedef ABI_NAME(OptixDenoiserOptions) OptixDenoiserOptions;
+typedef ABI_NAME(OptixImage2D) OptixImage2D;
+#if NVOPTIX_ABI >= 36
+typedef ABI_NAME(OptixBuiltinISOptions) OptixBuiltinISOptions;
+#endif
+#if NVOPTIX_ABI >= 47
+typedef ABI_NAME(OptixDenoiserGuideLayer) OptixDenoiserGuideLayer;
+typedef ABI_NAME(OptixDenoiserLayer) OptixDenoiserLayer;
+#endif
+
+// ABI 84 renamed the module entries, their _impl is the same
+
+#if NVOPTIX_ABI >= 84
+#define MODULE_CREATE optixModuleCreate
+#define MODULE_CREATE_WITH_TASKS optixModuleCreateWithTasks
+#else
+#define MODULE_CREATE optixModuleCreateFromPTX
+#define MODULE_CREATE_WITH_TASKS optixModuleCreateFromPTXWithTasks
+#endif
+
+#define IMPL(entry) IMPL_(entry)
+#define IMPL_(entry) entry ## _impl
+
+// the hot thunks load their native function pointer from this on every call, start it on a cache line
+static OptixFunctionTable optixFunctionTable __attribute__((aligned(64)));
+
+#include "nvoptix_thunks.h"
+
+static OptixResult optixDeviceContextCreate_impl(CUcontext fromContext, const OptixDeviceContextOptions *options, OptixDeviceContext *context)
+{
+    capture_data(CAPTURE_DATA_INPUT, 1, options, sizeof(OptixDeviceContextOptions));
+
+    OptixDeviceContextOptions opts = *options;
+
+    if (opts.logCallbackFunction || compile_stats_enabled())
+    {
+        if (callbacks_enabled())
+        {
+            opts.logCallbackData = wrap_callback(opts.logCallbackFunction, opts.logCallbackData, opts.logCallbackLevel);
+            opts.logCallbackFunction = log_callback;
+
+            if (compile_stats_enabled()) opts.logCallbackLevel = 4;
+        }
+        else if (opts.logCallbackFunction)
+        {
+            WARN("log callbacks disabled\n");
+            opts.logCallbackFunction = NULL;
+        }
+    }
+
+    return optixFunctionTable.optixDeviceContextCreate(fromContext, &opts, context);
+}
+
+static OptixResult optixDeviceContextDestroy_impl(OptixDeviceContext context)
+{
+    accel_compaction_context_destroy(context);
+    accel_memory_context_destroy(context);
+    denoiser_context_destroy(context);
+
+    return optixFunctionTable.optixDeviceContextDestroy(context);
+}
+
+static OptixResult optixDeviceContextSetLogCallback_impl(OptixDeviceContext context, OptixLogCallback callbackFunction, void *callbackData, unsigned int callbackLevel)
+{
+    if (callbackFunction || compile_stats_enabled())
+    {
+        if (callbacks_enabled())
+        {
+            callbackData = wrap_callback(callbackFunction, callbackData, callbackLevel);
+            callbackFunction = log_callback;
+
+            if (compile_stats_enabled()) callbackLevel = 4;
+        }
+        else if (callbackFunction)
+        {
+            WARN("log callbacks disabled\n");
+            return OPTIX_SUCCESS;
+        }
+    }
+
+    return optixFunctionTable.optixDeviceContextSetLogCallback(context, callbackFunction, callbackData, callbackLevel);
+}
+
+static OptixResult optixDeviceContextSetCacheLocation_impl(OptixDeviceContext context, const char *location)
+{
+    if (!location) return OPTIX_ERROR_DISK_CACHE_INVALID_PATH;
+
+#ifdef WINE_UNIX_LIB
+    // the PE side of a unixlib build converted it, see nvoptix_pe.c
+    return optixFunctionTable.optixDeviceContextSetCacheLocation(context, location);
+#else
+    WCHAR location_wide[MAX_PATH];
+
+    MultiByteToWideChar(CP_ACP, 0, location, -1, location_wide, ARRAY_SIZE(location_wide));
+
+    char *unix_location = wine_get_unix_file_name(location_wide);
+
+    OptixResult result = optixFunctionTable.optixDeviceContextSetCacheLocation(context, unix_location);
+
+    HeapFree(GetProcessHeap(), 0, unix_location);
+
+    return result;
+#endif
+}
+
+static OptixResult optixDeviceContextGetCacheLocation_impl(OptixDeviceContext context, char *location, size_t locationSize)
+{
+    OptixResult result = optixFunctionTable.optixDeviceContextGetCacheLocation(context, location, locationSize);
+
+#ifdef WINE_UNIX_LIB
+    // the PE side of a unixlib build converts it, see nvoptix_pe.c
+    return result;
+#else
+    if (result != OPTIX_SUCCESS) return result;
+
+    WCHAR *dos_location = wine_get_dos_file_name(location);
+
+    if (!WideCharToMultiByte(CP_ACP, 0, dos_location, -1, location, locationSize, NULL, NULL)) result = OPTIX_ERROR_INVALID_VALUE;
+
+    HeapFree(GetProcessHeap(), 0, dos_location);
+
+    return result;
+#endif
+}
+
+static const OptixModuleCompileOptions *apply_module_compile_options(const OptixModuleCompileOptions *options, OptixModuleCompileOptions *copy)
+{
+    if (!options || !profile_module_overrides()) return options;
+
+    *copy = *options;
+#if NVOPTIX_ABI >= 41
+    profile_apply_module_compile_options(NVOPTIX_ABI, &copy->maxRegisterCount, &copy->optLevel, &copy->debugLevel, &copy->numBoundValues);
+
+    if (!copy->numBoundValues) copy->boundValues = NULL;
+#else
+    profile_apply_module_compile_options(NVOPTIX_ABI, &copy->maxRegisterCount, &copy->optLevel, &copy->debugLevel, NULL);
+#endif
+
+    return copy;
+}
+
+static const OptixPipelineCompileOptions *apply_pipeline_compile_options(const OptixPipelineCompileOptions *options, OptixPipelineCompileOptions *copy)
+{
+    if (!options || !profile_pipeline_overrides()) return options;
+
+    *copy = *options;
+#if NVOPTIX_ABI >= 36
+    profile_apply_pipeline_compile_options(NVOPTIX_ABI, &copy->usesMotionBlur, &copy->traversableGraphFlags, &copy->exceptionFlags, &copy->usesPrimitiveTypeFlags);
+#else
+    profile_apply_pipeline_compile_options(NVOPTIX_ABI, &copy->usesMotionBlur, &copy->traversableGraphFlags, &copy->exceptionFlags, NULL);
+#endif
+
+    return copy;
+}
+
+// the link options lost their debug level in ABI 84, before that module overrides apply to them too
+
+static const OptixPipelineLinkOptions *apply_pipeline_link_options(const OptixPipelineLinkOptions *options, OptixPipelineLinkOptions *copy)
+{
+#if NVOPTIX_ABI >= 84
+    if (!options || !profile_pipeline_overrides()) return options;
+
+    *copy = *options;
+    profile_apply_pipeline_link_options(NVOPTIX_ABI, &copy->maxTraceDepth, NULL, NULL);
+#else
+    if (!options || (!profile_pipeline_overrides() && !profile_module_overrides())) return options;
+
+    *copy = *options;
+#if NVOPTIX_ABI >= 36
+    profile_apply_pipeline_link_options(NVOPTIX_ABI, &copy->maxTraceDepth, &copy->debugLevel, NULL);
+#else
+    profile_apply_pipeline_link_options(NVOPTIX_ABI, &copy->maxTraceDepth, &copy->debugLevel, &copy->overrideUsesMotionBlur);
+#endif
+#endif
+
+    return copy;
+}
+
+#if NVOPTIX_ABI >= 41
+static const OptixBuiltinISOptions *apply_builtin_is_options(const OptixBuiltinISOptions *options, OptixBuiltinISOptions *copy)
+{
+    if (!options || !profile_pipeline_overrides()) return options;
+
+    *copy = *options;
+    profile_apply_builtin_is_options(NVOPTIX_ABI, &copy->usesMotionBlur);
+
+    return copy;
+}
+#endif
+
+static OptixResult IMPL(MODULE_CREATE)(OptixDeviceContext context, const OptixModuleCompileOptions *moduleCompileOptions, const OptixPipelineCompileOptions *pipelineCompileOptions, const char *input, size_t inputSize, char *logString, size_t *logStringSize, OptixModule *module)
+{
+    struct compile_stats compile;
+    OptixModuleCompileOptions module_options;
+    OptixPipelineCompileOptions pipeline_options;
+
+    capture_manifest(3, MANIFEST_RECORD_MODULE, NVOPTIX_ABI, moduleCompileOptions, sizeof(OptixModuleCompileOptions), pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), input, inputSize);
+
+    moduleCompileOptions = apply_module_compile_options(moduleCompileOptions, &module_options);
+    pipelineCompileOptions = apply_pipeline_compile_options(pipelineCompileOptions, &pipeline_options);
+
+    compile_begin(&compile, COMPILE_MODULE, context, logString, logStringSize);
+    OptixResult result = optixFunctionTable.MODULE_CREATE(context, moduleCompileOptions, pipelineCompileOptions, input, inputSize, logString, logStringSize, module);
+    compile_end(&compile, result);
+
+    if (result == OPTIX_SUCCESS && manifest_enabled())
+        manifest_record_module(NVOPTIX_ABI, moduleCompileOptions, sizeof(OptixModuleCompileOptions), pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), input, inputSize);
+
+    return result;
+}
+
+#if NVOPTIX_ABI >= 55
+static OptixResult IMPL(MODULE_CREATE_WITH_TASKS)(OptixDeviceContext context, const OptixModuleCompileOptions *moduleCompileOptions, const OptixPipelineCompileOptions *pipelineCompileOptions, const char *input, size_t inputSize, char *logString, size_t *logStringSize, OptixModule *module, OptixTask *firstTask)
+{
+    struct compile_stats compile;
+    OptixModuleCompileOptions module_options;
+    OptixPipelineCompileOptions pipeline_options;
+
+    capture_manifest(3, MANIFEST_RECORD_MODULE, NVOPTIX_ABI, moduleCompileOptions, sizeof(OptixModuleCompileOptions), pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), input, inputSize);
+
+    moduleCompileOptions = apply_module_compile_options(moduleCompileOptions, &module_options);
+    pipelineCompileOptions = apply_pipeline_compile_options(pipelineCompileOptions, &pipeline_options);
+
+    compile_begin(&compile, COMPILE_MODULE, context, logString, logStringSize);
+    OptixResult result = optixFunctionTable.MODULE_CREATE_WITH_TASKS(context, moduleCompileOptions, pipelineCompileOptions, input, inputSize, logString, logStringSize, module, firstTask);
+    compile_end(&compile, result);
+
+    if (result == OPTIX_SUCCESS) compile_task_add(*firstTask, context);
+
+    if (result == OPTIX_SUCCESS && manifest_enabled())
+        manifest_record_module(NVOPTIX_ABI, moduleCompileOptions, sizeof(OptixModuleCompileOptions), pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), input, inputSize);
+
+    return result;
+}
+#endif
+
+#if NVOPTIX_ABI >= 36
+static OptixResult optixBuiltinISModuleGet_impl(OptixDeviceContext context, const OptixModuleCompileOptions *moduleCompileOptions, const OptixPipelineCompileOptions *pipelineCompileOptions, const OptixBuiltinISOptions *builtinISOptions, OptixModule *builtinModule)
+{
+    OptixModuleCompileOptions module_options;
+    OptixPipelineCompileOptions pipeline_options;
+#if NVOPTIX_ABI >= 41
+    OptixBuiltinISOptions builtin_options;
+#endif
+
+    capture_manifest(3, MANIFEST_RECORD_BUILTIN_IS, NVOPTIX_ABI, moduleCompileOptions, sizeof(OptixModuleCompileOptions), pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), builtinISOptions, sizeof(OptixBuiltinISOptions));
+
+    moduleCompileOptions = apply_module_compile_options(moduleCompileOptions, &module_options);
+    pipelineCompileOptions = apply_pipeline_compile_options(pipelineCompileOptions, &pipeline_options);
+#if NVOPTIX_ABI >= 41
+    builtinISOptions = apply_builtin_is_options(builtinISOptions, &builtin_options);
+#endif
+
+    OptixResult result = optixFunctionTable.optixBuiltinISModuleGet(context, moduleCompileOptions, pipelineCompileOptions, builtinISOptions, builtinModule);
+
+    if (result == OPTIX_SUCCESS && manifest_enabled())
+        manifest_record_builtin(NVOPTIX_ABI, moduleCompileOptions, sizeof(OptixModuleCompileOptions), pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), builtinISOptions, sizeof(OptixBuiltinISOptions));
+
+    return result;
+}
+#endif
+
+#if NVOPTIX_ABI >= 55
+static OptixResult optixTaskExecute_impl(OptixTask task, OptixTask *additionalTasks, unsigned int maxNumAdditionalTasks, unsigned int *numAdditionalTasksCreated)
+{
+    struct compile_stats compile;
+    void *context = compile_task_take(task);
+
+    compile_begin(&compile, COMPILE_TASK, context, NULL, NULL);
+
+    OptixResult result = optixFunctionTable.optixTaskExecute(task, additionalTasks, maxNumAdditionalTasks, numAdditionalTasksCreated);
+
+    compile_end(&compile, result);
+
+    if (result == OPTIX_SUCCESS && numAdditionalTasksCreated)
+        for (unsigned int i = 0; i < *numAdditionalTasksCreated; i++) compile_task_add(additionalTasks[i], context);
+
+    return result;
+}
+#endif
+
+static OptixResult optixProgramGroupCreate_impl(OptixDeviceContext context, const void *programDescriptions, unsigned int numProgramGroups, const void *options, char *logString, size_t *logStringSize, OptixProgramGroup *programGroups)
+{
+    struct compile_stats compile;
+
+    capture_program_groups(1, programDescriptions, numProgramGroups);
+
+    compile_begin(&compile, COMPILE_PROGRAM_GROUP, context, logString, logStringSize);
+
+    OptixResult result = optixFunctionTable.optixProgramGroupCreate(context, programDescriptions, numProgramGroups, options, logString, logStringSize, programGroups);
+
+    compile_end(&compile, result);
+
+    return result;
+}
+
+static OptixResult optixPipelineCreate_impl(OptixDeviceContext context, const OptixPipelineCompileOptions *pipelineCompileOptions, const OptixPipelineLinkOptions *pipelineLinkOptions, const OptixProgramGroup *programGroups, unsigned int numProgramGroups, char *logString, size_t *logStringSize, OptixPipeline *pipeline)
+{
+    struct compile_stats compile;
+    OptixPipelineCompileOptions pipeline_options;
+    OptixPipelineLinkOptions link_options;
+
+    capture_manifest(2, MANIFEST_RECORD_PIPELINE, NVOPTIX_ABI, NULL, 0, pipelineCompileOptions, sizeof(OptixPipelineCompileOptions), pipelineLinkOptions, sizeof(OptixPipelineLinkOptions));
+    capture_data(CAPTURE_DATA_INPUT, 3, programGroups, numProgramGroups * sizeof(OptixProgramGroup));
+
+    pipelineCompileOptions = apply_pipeline_compile_options(pipelineCompileOptions, &pipeline_options);
+    pipelineLinkOptions = apply_pipeline_link_options(pipelineLinkOptions, &link_options);
+
+    compile_begin(&compile, COMPILE_PIPELINE, context, logString, logStringSize);
+
+    OptixResult result = optixFunctionTable.optixPipelineCreate(context, pipelineCompileOptions, pipelineLinkOptions, programGroups, numProgramGroups, logString, logStringSize, pipeline);
+
+    compile_end(&compile, result);
+
+    return result;
+}
+
+static OptixResult optixPipelineDestroy_impl(OptixPipeline pipeline)
+{
+    accel_graph_pipeline_destroy(pipeline);
+
+    return optixFunctionTable.optixPipelineDestroy(pipeline);
+}
+
+static OptixResult optixPipelineSetStackSize_impl(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState, unsigned int continuationStackSize, unsigned int maxTraversableGraphDepth)
+{
+    accel_graph_stack_size(pipeline, directCallableStackSizeFromTraversal, directCallableStackSizeFromState, continuationStackSize, &maxTraversableGraphDepth);
+
+    return optixFunctionTable.optixPipelineSetStackSize(pipeline, directCallableStackSizeFromTraversal, directCallableStackSizeFromState, continuationStackSize, maxTraversableGraphDepth);
+}
+
+static const OptixAccelBuildOptions *apply_accel_build_options(const OptixAccelBuildOptions *options, const void *buildInputs, unsigned int numBuildInputs, BOOL build, OptixAccelBuildOptions *copy)
+{
+    if (!options || !accel_rules_enabled()) return options;
+
+    *copy = *options;
+    copy->buildFlags = accel_apply_rules(NVOPTIX_ABI, copy->buildFlags, copy->operation, buildInputs, numBuildInputs, build);
+
+    return copy;
+}
+
+// the application's temp buffer was sized for a build, it has to be large enough for the update too
+
+static const OptixAccelBuildOptions *apply_accel_refit(OptixDeviceContext context, const OptixAccelBuildOptions *options, const void *buildInputs, unsigned int numBuildInputs, size_t tempBufferSizeInBytes, struct accel_refit *refit, OptixAccelBuildOptions *copy)
+{
+    OptixAccelBufferSizes sizes;
+
+    *copy = *options;
+    copy->operation = OPTIX_BUILD_OPERATION_UPDATE;
+
+    if (optixFunctionTable.optixAccelComputeMemoryUsage(context, copy, buildInputs, numBuildInputs, &sizes) == OPTIX_SUCCESS && sizes.tempUpdateSizeInBytes <= tempBufferSizeInBytes)
+        return copy;
+
+    copy->operation = OPTIX_BUILD_OPERATION_BUILD;
+    accel_refit_reject(refit);
+
+    return copy;
+}
+
+static OptixResult optixAccelComputeMemoryUsage_impl(OptixDeviceContext context, const OptixAccelBuildOptions *accelOptions, const void *buildInputs, unsigned int numBuildInputs, OptixAccelBufferSizes *bufferSizes)
+{
+    OptixAccelBuildOptions options;
+
+    capture_data(CAPTURE_DATA_INPUT, 1, accelOptions, sizeof(OptixAccelBuildOptions));
+    capture_data(CAPTURE_DATA_INPUT, 2, buildInputs, numBuildInputs * sizeof(struct accel_build_input));
+
+    accelOptions = apply_accel_build_options(accelOptions, buildInputs, numBuildInputs, FALSE, &options);
+
+    OptixResult result = optixFunctionTable.optixAccelComputeMemoryUsage(context, accelOptions, buildInputs, numBuildInputs, bufferSizes);
+
+    accel_memory_query(context, ACCEL_MEMORY_QUERY_ACCEL, result, bufferSizes);
+
+    return result;
+}
+
+static OptixResult optixAccelBuild_impl(OptixDeviceContext context, CUstream stream, const OptixAccelBuildOptions *accelOptions, const void *buildInputs, unsigned int numBuildInputs, CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle, const void *emittedProperties, unsigned int numEmittedProperties)
+{
+    OptixAccelBuildOptions options;
+    OptixTraversableHandle compacted;
+    struct accel_compaction compaction;
+    struct accel_refit refit;
+    struct accel_build build;
+    struct gpu_timing timing;
+
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 2, accelOptions, sizeof(OptixAccelBuildOptions));
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 3, buildInputs, numBuildInputs * sizeof(struct accel_build_input));
+
+    accelOptions = apply_accel_build_options(accelOptions, buildInputs, numBuildInputs, TRUE, &options);
+
+    if (accel_refit_begin(&refit, accelOptions, buildInputs, numBuildInputs, outputBuffer, outputBufferSizeInBytes, numEmittedProperties))
+        accelOptions = apply_accel_refit(context, accelOptions, buildInputs, numBuildInputs, tempBufferSizeInBytes, &refit, &options);
+
+    accel_build_begin(&build, NVOPTIX_ABI, stream, accelOptions, buildInputs, numBuildInputs, tempBufferSizeInBytes, outputBuffer, outputBufferSizeInBytes);
+
+    accel_compaction_begin(&compaction, context, stream, accelOptions, outputBuffer, outputBufferSizeInBytes, &emittedProperties, &numEmittedProperties);
+
+    gpu_timing_start(&timing, stream);
+
+    OptixResult result = optixFunctionTable.optixAccelBuild(context, stream, accelOptions, buildInputs, numBuildInputs, tempBuffer, tempBufferSizeInBytes, outputBuffer, outputBufferSizeInBytes, outputHandle, emittedProperties, numEmittedProperties);
+
+    gpu_timing_finish(&timing, result, "accel build, %s, %s, %u inputs", accel_build_input_name(buildInputs, numBuildInputs),
+                      accelOptions && accelOptions->operation == OPTIX_BUILD_OPERATION_UPDATE ? "update" : "build", numBuildInputs);
+
+    accel_memory_build(context, result, tempBuffer, tempBufferSizeInBytes, outputBuffer, outputBufferSizeInBytes, outputHandle ? *outputHandle : 0);
+
+    if (accel_compaction_prepare(&compaction, result))
+    {
+        OptixResult compact_result = optixFunctionTable.optixAccelCompact(context, stream, *outputHandle, compaction.block.ptr, compaction.block.size, &compacted);
+
+        accel_memory_compact(context, compact_result, compaction.block.ptr, compaction.block.size, compacted);
+        accel_compaction_end(&compaction, compact_result, compacted, outputHandle);
+    }
+
+    accel_graph_build(NVOPTIX_ABI, stream, result, buildInputs, numBuildInputs, outputHandle);
+    accel_refit_end(&refit, result, accelOptions ? accelOptions->operation : 0);
+    accel_build_end(&build, result);
+
+    return result;
+}
+
+static OptixResult optixAccelGetRelocationInfo_impl(OptixDeviceContext context, OptixTraversableHandle handle, void *info)
+{
+    OptixResult result = optixFunctionTable.optixAccelGetRelocationInfo(context, handle, info);
+
+    accel_graph_relocation_info(result, handle, info);
+
+    return result;
+}
+
+#if NVOPTIX_ABI >= 68
+static OptixResult optixAccelRelocate_impl(OptixDeviceContext context, CUstream stream, const void *info, const void *relocateInputs, size_t numRelocateInputs, CUdeviceptr targetAccel, size_t targetAccelSizeInBytes, OptixTraversableHandle *targetHandle)
+#else
+static OptixResult optixAccelRelocate_impl(OptixDeviceContext context, CUstream stream, const void *info, CUdeviceptr relocateInputs, size_t numRelocateInputs, CUdeviceptr targetAccel, size_t targetAccelSizeInBytes, OptixTraversableHandle *targetHandle)
+#endif
+{
+    accel_build_invalidate(targetAccel);
+
+    OptixResult result = optixFunctionTable.optixAccelRelocate(context, stream, info, relocateInputs, numRelocateInputs, targetAccel, targetAccelSizeInBytes, targetHandle);
+
+    accel_graph_relocate(result, info, targetHandle);
+
+    return result;
+}
+
+static OptixResult optixAccelCompact_impl(OptixDeviceContext context, CUstream stream, OptixTraversableHandle inputHandle, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle)
+{
+    struct gpu_timing timing;
+
+    accel_build_invalidate(outputBuffer);
+
+    gpu_timing_start(&timing, stream);
+
+    OptixResult result = optixFunctionTable.optixAccelCompact(context, stream, inputHandle, outputBuffer, outputBufferSizeInBytes, outputHandle);
+
+    gpu_timing_finish(&timing, result, "accel compact");
+
+    accel_memory_compact(context, result, outputBuffer, outputBufferSizeInBytes, outputHandle ? *outputHandle : 0);
+    accel_graph_compact(result, inputHandle, outputHandle);
+
+    return result;
+}
+
+static OptixResult optixConvertPointerToTraversableHandle_impl(OptixDeviceContext onDevice, CUdeviceptr pointer, int traversableType, OptixTraversableHandle *traversableHandle)
+{
+    OptixResult result = optixFunctionTable.optixConvertPointerToTraversableHandle(onDevice, pointer, traversableType, traversableHandle);
+
+    accel_graph_transform(result, pointer, traversableType, traversableHandle);
+
+    return result;
+}
+
+#if NVOPTIX_ABI >= 68
+static OptixResult optixOpacityMicromapArrayComputeMemoryUsage_impl(OptixDeviceContext context, const void *buildInput, void *bufferSizes)
+{
+    OptixResult result = optixFunctionTable.optixOpacityMicromapArrayComputeMemoryUsage(context, buildInput, bufferSizes);
+
+    accel_memory_query(context, ACCEL_MEMORY_QUERY_OPACITY_MICROMAP, result, bufferSizes);
+
+    return result;
+}
+
+static OptixResult optixOpacityMicromapArrayBuild_impl(OptixDeviceContext context, CUstream stream, const void *buildInput, const void *buffers)
+{
+    struct gpu_timing timing;
+
+    gpu_timing_start(&timing, stream);
+
+    OptixResult result = optixFunctionTable.optixOpacityMicromapArrayBuild(context, stream, buildInput, buffers);
+
+    gpu_timing_finish(&timing, result, "opacity micromap build");
+
+    accel_memory_micromap_build(context, result, buffers);
+
+    return result;
+}
+#endif
+
+#if NVOPTIX_ABI >= 84
+static OptixResult optixDisplacementMicromapArrayComputeMemoryUsage_impl(OptixDeviceContext context, const void *buildInput, void *bufferSizes)
+{
+    OptixResult result = optixFunctionTable.optixDisplacementMicromapArrayComputeMemoryUsage(context, buildInput, bufferSizes);
+
+    accel_memory_query(context, ACCEL_MEMORY_QUERY_DISPLACEMENT_MICROMAP, result, bufferSizes);
+
+    return result;
+}
+
+static OptixResult optixDisplacementMicromapArrayBuild_impl(OptixDeviceContext context, CUstream stream, const void *buildInput, const void *buffers)
+{
+    struct gpu_timing timing;
+
+    gpu_timing_start(&timing, stream);
+
+    OptixResult result = optixFunctionTable.optixDisplacementMicromapArrayBuild(context, stream, buildInput, buffers);
+
+    gpu_timing_finish(&timing, result, "displacement micromap build");
+
+    accel_memory_micromap_build(context, result, buffers);
+
+    return result;
+}
+#endif
+
+static OptixResult optixLaunch_impl(OptixPipeline pipeline, CUstream stream, CUdeviceptr pipelineParams, size_t pipelineParamsSize, const void *sbt, unsigned int width, unsigned int height, unsigned int depth)
+{
+    unsigned int stackSize[4];
+    struct gpu_timing timing;
+
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 4, sbt, CAPTURE_SBT_SIZE);
+
+    accel_build_launch();
+
+    if (accel_graph_launch(pipeline, stackSize))
+        optixFunctionTable.optixPipelineSetStackSize(pipeline, stackSize[0], stackSize[1], stackSize[2], stackSize[3]);
+
+    gpu_timing_start(&timing, stream);
+
+    OptixResult result = optixFunctionTable.optixLaunch(pipeline, stream, pipelineParams, pipelineParamsSize, sbt, width, height, depth);
+
+    gpu_timing_finish(&timing, result, "launch, pipeline %p, %ux%ux%u", pipeline, width, height, depth);
+
+    return result;
+}
+
+// the model is given at creation since ABI 47, optixDenoiserSetModel gave it before
+
+#if NVOPTIX_ABI >= 47
+static OptixResult optixDenoiserCreate_impl(OptixDeviceContext context, int modelKind, const OptixDenoiserOptions *options, OptixDenoiser *returnHandle)
+{
+    struct denoiser_create create;
+
+    capture_data(CAPTURE_DATA_INPUT, 2, options, sizeof(OptixDenoiserOptions));
+
+    if (denoiser_pool_acquire(&create, context, modelKind, options, sizeof(*options), NULL, 0, returnHandle))
+    {
+        capture_data(CAPTURE_DATA_OUTPUT, 3, returnHandle, sizeof(*returnHandle));
+        return OPTIX_SUCCESS;
+    }
+
+    OptixResult result = optixFunctionTable.optixDenoiserCreate(context, modelKind, options, returnHandle);
+
+    denoiser_pool_created(&create, result, returnHandle);
+
+    return result;
+}
+#else
+static OptixResult optixDenoiserCreate_impl(OptixDeviceContext context, const OptixDenoiserOptions *options, OptixDenoiser *returnHandle)
+{
+    struct denoiser_create create;
+
+    capture_data(CAPTURE_DATA_INPUT, 1, options, sizeof(OptixDenoiserOptions));
+
+    if (denoiser_pool_acquire(&create, context, DENOISER_MODEL_LATER, options, sizeof(*options), NULL, 0, returnHandle))
+    {
+        capture_data(CAPTURE_DATA_OUTPUT, 2, returnHandle, sizeof(*returnHandle));
+        return OPTIX_SUCCESS;
+    }
+
+    OptixResult result = optixFunctionTable.optixDenoiserCreate(context, options, returnHandle);
+
+    denoiser_pool_created(&create, result, returnHandle);
+
+    return result;
+}
+#endif
+
+static OptixResult optixDenoiserDestroy_impl(OptixDenoiser handle)
+{
+    denoiser_setup_forget(handle);
+    denoiser_tiling_forget(handle);
+
+    if (denoiser_pool_release(handle, optixFunctionTable.optixDenoiserDestroy))
+        return OPTIX_SUCCESS;
+
+    return optixFunctionTable.optixDenoiserDestroy(handle);
+}
+
+static OptixResult optixDenoiserComputeMemoryResources_impl(const OptixDenoiser handle, unsigned int maximumInputWidth, unsigned int maximumInputHeight, void *returnSizes)
+{
+    struct denoiser_resources resources;
+
+    denoiser_tiling_query(&resources, handle, &maximumInputWidth, &maximumInputHeight);
+
+    OptixResult result = optixFunctionTable.optixDenoiserComputeMemoryResources(handle, maximumInputWidth, maximumInputHeight, returnSizes);
+
+    denoiser_tiling_queried(&resources, result, returnSizes);
+
+    return result;
+}
+
+static OptixResult optixDenoiserSetup_impl(OptixDenoiser denoiser, CUstream stream, unsigned int inputWidth, unsigned int inputHeight, CUdeviceptr state, size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    struct denoiser_setup setup;
+
+    denoiser_tiling_setup(denoiser, &inputWidth, &inputHeight);
+
+    if (denoiser_setup_begin(&setup, denoiser, stream, inputWidth, inputHeight, state, stateSizeInBytes, scratch, scratchSizeInBytes))
+        return OPTIX_SUCCESS;
+
+    OptixResult result = optixFunctionTable.optixDenoiserSetup(denoiser, stream, inputWidth, inputHeight, state, stateSizeInBytes, scratch, scratchSizeInBytes);
+
+    denoiser_setup_end(&setup, result);
+
+    return result;
+}
+
+// the guide layer replaced the plain input and output images in ABI 47
+
+#if NVOPTIX_ABI >= 47
+static OptixResult optixDenoiserInvoke_impl(OptixDenoiser denoiser, CUstream stream, const void *params, CUdeviceptr denoiserState, size_t denoiserStateSizeInBytes, const void *guideLayer, const void *layers, unsigned int numLayers, unsigned int inputOffsetX, unsigned int inputOffsetY, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    struct denoiser_timing timing;
+    struct denoiser_tiling tiling;
+    OptixResult result = OPTIX_SUCCESS;
+
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 5, guideLayer, sizeof(OptixDenoiserGuideLayer));
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 6, layers, numLayers * sizeof(OptixDenoiserLayer));
+
+    denoiser_timing_begin(&timing, "invoke", denoiser, stream, layers, numLayers);
+
+    if (!denoiser_tiling_begin(&tiling, denoiser, inputOffsetX, inputOffsetY, guideLayer, sizeof(OptixDenoiserGuideLayer) / sizeof(OptixImage2D), layers, sizeof(OptixDenoiserLayer), numLayers, NULL))
+        result = optixFunctionTable.optixDenoiserInvoke(denoiser, stream, params, denoiserState, denoiserStateSizeInBytes, guideLayer, layers, numLayers, inputOffsetX, inputOffsetY, scratch, scratchSizeInBytes);
+
+    while (result == OPTIX_SUCCESS && denoiser_tiling_next(&tiling, &inputOffsetX, &inputOffsetY))
+        result = optixFunctionTable.optixDenoiserInvoke(denoiser, stream, params, denoiserState, denoiserStateSizeInBytes, tiling.inputs, tiling.layers, numLayers, inputOffsetX, inputOffsetY, scratch, scratchSizeInBytes);
+
+    denoiser_tiling_end(&tiling, result);
+    denoiser_timing_end(&timing, result);
+
+    return result;
+}
+#else
+static OptixResult optixDenoiserInvoke_impl(OptixDenoiser denoiser, CUstream stream, const void *params, CUdeviceptr denoiserState, size_t denoiserStateSizeInBytes, const void *layers, unsigned int numLayers, unsigned int inputOffsetX, unsigned int inputOffsetY, const void *outputLayer, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    struct denoiser_timing timing;
+    struct denoiser_tiling tiling;
+    OptixResult result = OPTIX_SUCCESS;
+
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 5, layers, numLayers * sizeof(OptixImage2D));
+    HOT_CAPTURE_DATA(CAPTURE_DATA_INPUT, 9, outputLayer, sizeof(OptixImage2D));
+
+    denoiser_timing_begin(&timing, "invoke", denoiser, stream, layers, numLayers);
+
+    if (!denoiser_tiling_begin(&tiling, denoiser, inputOffsetX, inputOffsetY, layers, numLayers, NULL, 0, 0, outputLayer))
+        result = optixFunctionTable.optixDenoiserInvoke(denoiser, stream, params, denoiserState, denoiserStateSizeInBytes, layers, numLayers, inputOffsetX, inputOffsetY, outputLayer, scratch, scratchSizeInBytes);
+
+    while (result == OPTIX_SUCCESS && denoiser_tiling_next(&tiling, &inputOffsetX, &inputOffsetY))
+        result = optixFunctionTable.optixDenoiserInvoke(denoiser, stream, params, denoiserState, denoiserStateSizeInBytes, tiling.inputs, numLayers, inputOffsetX, inputOffsetY, &tiling.output, scratch, scratchSizeInBytes);
+
+    denoiser_tiling_end(&tiling, result);
+    denoiser_timing_end(&timing, result);
+
+    return result;
+}
+
+static OptixResult optixDenoiserSetModel_impl(OptixDenoiser handle, int kind, void *data, size_t sizeInBytes)
+{
+    struct denoiser_create create;
+
+    denoiser_setup_forget(handle);
+
+    if (denoiser_pool_set_model(&create, handle, kind, data, sizeInBytes))
+        return OPTIX_SUCCESS;
+
+    OptixResult result = optixFunctionTable.optixDenoiserSetModel(handle, kind, data, sizeInBytes);
+
+    denoiser_pool_model_set(&create, result);
+
+    return result;
+}
+#endif
+
+static OptixResult optixDenoiserComputeIntensity_impl(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputIntensity, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    struct denoiser_timing timing;
+
+    capture_data(CAPTURE_DATA_INPUT, 2, inputImage, sizeof(OptixImage2D));
+
+    denoiser_timing_begin(&timing, "intensity", handle, stream, inputImage, 1);
+
+    OptixResult result = optixFunctionTable.optixDenoiserComputeIntensity(handle, stream, inputImage, outputIntensity, scratch, scratchSizeInBytes);
+
+    denoiser_timing_end(&timing, result);
+
+    return result;
+}
+
+#if NVOPTIX_ABI >= 41
+static OptixResult optixDenoiserComputeAverageColor_impl(OptixDenoiser handle, CUstream stream, const void *inputImage, CUdeviceptr outputAverageColor, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    struct denoiser_timing timing;
+
+    capture_data(CAPTURE_DATA_INPUT, 2, inputImage, sizeof(OptixImage2D));
+
+    denoiser_timing_begin(&timing, "average color", handle, stream, inputImage, 1);
+
+    OptixResult result = optixFunctionTable.optixDenoiserComputeAverageColor(handle, stream, inputImage, outputAverageColor, scratch, scratchSizeInBytes);
+
+    denoiser_timing_end(&timing, result);
+
+    return result;
+}
+#endif
+
+#if NVOPTIX_ABI >= 47
+static OptixResult optixDenoiserCreateWithUserModel_impl(OptixDeviceContext context, const void *data, size_t dataSizeInBytes, OptixDenoiser *returnHandle)
+{
+    struct denoiser_create create;
+
+    capture_data(CAPTURE_DATA_INPUT, 1, data, dataSizeInBytes);
+
+    if (denoiser_pool_acquire(&create, context, DENOISER_MODEL_USER, NULL, 0, data, dataSizeInBytes, returnHandle))
+    {
+        capture_data(CAPTURE_DATA_OUTPUT, 3, returnHandle, sizeof(*returnHandle));
+        return OPTIX_SUCCESS;
+    }
+
+    OptixResult result = optixFunctionTable.optixDenoiserCreateWithUserModel(context, data, dataSizeInBytes, returnHandle);
+
+    denoiser_pool_created(&create, result, returnHandle);
+
+    return result;
+}
+#endif
+
+// the native table is filled by the first successful query, later queries copy the finished
+// table of thunks without asking the native library again. A failed query is not kept, the
+// next one retries. Queries with options are always passed on to the native library, but
+// once the table is filled their result no longer replaces it.
+
+static pthread_mutex_t query_lock = PTHREAD_MUTEX_INITIALIZER;
+static BOOL query_done;
+static OptixFunctionTable query_table;
+
+static OptixResult query_function_table(unsigned int numOptions, int *optionKeys, const void **optionValues)
+{
+    OptixFunctionTable native;
+    OptixResult result;
+
+    if (!numOptions && __atomic_load_n(&query_done, __ATOMIC_ACQUIRE)) return OPTIX_SUCCESS;
+
+    if (pthread_mutex_lock(&query_lock))
+    {
+        ERR("Failed to acquire query lock\n");
+        return OPTIX_ERROR_INTERNAL_ERROR;
+    }
+
+    if (numOptions || !query_done)
+        result = poptixQueryFunctionTable(NVOPTIX_ABI, numOptions, optionKeys, optionValues, &native, sizeof(OptixFunctionTable));
+    else
+        result = OPTIX_SUCCESS;
+
+    if (result == OPTIX_SUCCESS && !query_done)
+    {
+        OptixFunctionTable *table = &query_table;
+
+        optixFunctionTable = native;
+
+        #define ASSIGN_FUNCPTR(f, i) *(void**)(&table->f) = (void*)&ABI_NAME(f);
+
+        ABI_ENTRIES(ASSIGN_FUNCPTR)
+
+        #undef ASSIGN_FUNCPTR
+
+        __atomic_store_n(&query_done, TRUE, __ATOMIC_RELEASE);
+    }
+
+    if (pthread_mutex_unlock(&query_lock))
+        ERR("Failed to release query lock\n");
+
+    return result;
+}
+
+OptixResult __cdecl ABI_NAME(optixQueryFunctionTable)(
+    unsigned int numOptions,
+    int *optionKeys,
+    const void **optionValues,
+    void *functionTable,
+    size_t sizeOfTable)
+{
+    OptixResult result;
+
+    if (sizeOfTable != sizeof(OptixFunctionTable)) return OPTIX_ERROR_FUNCTION_TABLE_SIZE_MISMATCH;
+
+    if ((result = query_function_table(numOptions, optionKeys, optionValues)) != OPTIX_SUCCESS) return result;
+
+    memcpy(functionTable, &query_table, sizeof(OptixFunctionTable));
+
+    return OPTIX_SUCCESS;
+}
+
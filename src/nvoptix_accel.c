@@ -0,0 +1,283 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_profile.h"
+
+#define ACCEL_KIND(type) (1u << ((type) - OPTIX_BUILD_INPUT_TYPE_TRIANGLES))
+
+#define ACCEL_KIND_GAS (ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_TRIANGLES) | ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES) | \
+                        ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_CURVES) | ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_SPHERES))
+#define ACCEL_KIND_IAS (ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_INSTANCES) | ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS))
+
+struct accel_name
+{
+    const char *name;
+    unsigned int value;
+};
+
+static const struct accel_name accel_kinds[] =
+{
+    { "all", ACCEL_KIND_GAS | ACCEL_KIND_IAS },
+    { "gas", ACCEL_KIND_GAS },
+    { "ias", ACCEL_KIND_IAS },
+    { "triangles", ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_TRIANGLES) },
+    { "custom", ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES) },
+    { "instances", ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_INSTANCES) },
+    { "instance_pointers", ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS) },
+    { "curves", ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_CURVES) },
+    { "spheres", ACCEL_KIND(OPTIX_BUILD_INPUT_TYPE_SPHERES) },
+};
+
+static const struct accel_name accel_flags[] =
+{
+    { "allow_update", OPTIX_BUILD_FLAG_ALLOW_UPDATE },
+    { "allow_compaction", OPTIX_BUILD_FLAG_ALLOW_COMPACTION },
+    { "prefer_fast_trace", OPTIX_BUILD_FLAG_PREFER_FAST_TRACE },
+    { "prefer_fast_build", OPTIX_BUILD_FLAG_PREFER_FAST_BUILD },
+    { "allow_random_vertex_access", OPTIX_BUILD_FLAG_ALLOW_RANDOM_VERTEX_ACCESS },
+    { "allow_random_instance_access", OPTIX_BUILD_FLAG_ALLOW_RANDOM_INSTANCE_ACCESS },
+};
+
+struct accel_rule
+{
+    char *text;
+    unsigned int kinds;
+    unsigned int set;
+    unsigned int clear;
+    LONG builds;
+    LONG queries;
+    LONG update_stripped;
+    LONG update_reported;
+};
+
+static pthread_once_t accel_rules_once = PTHREAD_ONCE_INIT;
+static struct accel_rule *accel_rules = NULL;
+static size_t accel_rules_count = 0;
+
+// kinds the application was seen updating, rules no longer remove allow_update from them
+
+static LONG update_kinds;
+
+static char *trim(char *str)
+{
+    while (isspace((unsigned char)*str)) str++;
+
+    char *end = str + strlen(str);
+
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+    *end = 0;
+
+    return str;
+}
+
+static BOOL lookup(const struct accel_name *names, size_t count, const char *name, unsigned int *value)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcasecmp(names[i].name, name)) continue;
+
+        *value = names[i].value;
+        return TRUE;
+    }
+
+    char *end;
+    unsigned long number = strtoul(name, &end, 0);
+
+    if (!*name || *end) return FALSE;
+
+    *value = number;
+    return TRUE;
+}
+
+static BOOL parse_rule(char *text, struct accel_rule *rule)
+{
+    char *colon = strchr(text, ':'), *tok, *save = NULL;
+    unsigned int value;
+
+    if (!colon) return FALSE;
+
+    *colon = 0;
+    memset(rule, 0, sizeof(*rule));
+
+    for (tok = strtok_r(text, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+    {
+        if (!lookup(accel_kinds, ARRAY_SIZE(accel_kinds), trim(tok), &value)) return FALSE;
+        rule->kinds |= value;
+    }
+
+    for (tok = strtok_r(colon + 1, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save))
+    {
+        if ((*tok != '+' && *tok != '-') || !lookup(accel_flags, ARRAY_SIZE(accel_flags), tok + 1, &value)) return FALSE;
+
+        if (*tok == '+')
+        {
+            rule->set |= value;
+            rule->clear &= ~value;
+
+            // fast trace and fast build are mutually exclusive, asking for one drops the other
+
+            if (value & OPTIX_BUILD_FLAG_PREFER_FAST_TRACE) rule->clear |= OPTIX_BUILD_FLAG_PREFER_FAST_BUILD;
+            if (value & OPTIX_BUILD_FLAG_PREFER_FAST_BUILD) rule->clear |= OPTIX_BUILD_FLAG_PREFER_FAST_TRACE;
+        }
+        else
+        {
+            rule->clear |= value;
+            rule->set &= ~value;
+        }
+    }
+
+    return rule->kinds && (rule->set || rule->clear);
+}
+
+static void accel_rules_init(void)
+{
+    const char *value = profile_get("accel_build_rules");
+    char *rules, *tok, *save = NULL;
+
+    if (!value || !(rules = strdup(value))) return;
+
+    for (tok = strtok_r(rules, ";", &save); tok; tok = strtok_r(NULL, ";", &save))
+    {
+        struct accel_rule rule;
+        char *text = trim(tok);
+
+        if (!*text) continue;
+
+        char *copy = strdup(text);
+
+        if (!copy) break;
+
+        if (!parse_rule(text, &rule))
+        {
+            ERR("Invalid accel build rule %s\n", debugstr_a(copy));
+            free(copy);
+            continue;
+        }
+
+        struct accel_rule *new_rules = reallocarray(accel_rules, accel_rules_count + 1, sizeof(struct accel_rule));
+
+        if (!new_rules)
+        {
+            ERR("Failed to reallocate accel build rules\n");
+            free(copy);
+            break;
+        }
+
+        rule.text = copy;
+        accel_rules = new_rules;
+        accel_rules[accel_rules_count++] = rule;
+
+        WARN("Accel build rule %zu: %s (kinds %#x, set %#x, clear %#x)\n", accel_rules_count, debugstr_a(copy), rule.kinds, rule.set, rule.clear);
+    }
+
+    free(rules);
+}
+
+_Bool accel_rules_enabled(void)
+{
+    pthread_once(&accel_rules_once, accel_rules_init);
+
+    return accel_rules_count != 0;
+}
+
+// an update of a structure built without allow_update fails in OptiX with nothing pointing at the rule
+
+static void accel_rules_update(unsigned int kind, int type)
+{
+    if (InterlockedOr(&update_kinds, kind) & kind) return;
+
+    for (size_t i = 0; i < accel_rules_count; i++)
+    {
+        struct accel_rule *rule = &accel_rules[i];
+
+        if (!(rule->kinds & kind) || !(rule->clear & OPTIX_BUILD_FLAG_ALLOW_UPDATE)) continue;
+        if (!rule->update_stripped || InterlockedExchange(&rule->update_reported, 1)) continue;
+
+        ERR("Accel build rule %zu %s removed allow_update from %ld builds, the application updates them (input type %#x), "
+            "those updates fail. The rule keeps allow_update on these structures from now on.\n",
+            i + 1, debugstr_a(rule->text), (long)rule->update_stripped, type);
+    }
+}
+
+// all build inputs of one build have the same type, looking at the first one is enough
+
+unsigned int accel_apply_rules(int abi, unsigned int buildFlags, int operation, const void *buildInputs, unsigned int numBuildInputs, _Bool build)
+{
+    if (!buildInputs || !numBuildInputs) return buildFlags;
+
+    int type = *(const int *)buildInputs;
+
+    if (type < OPTIX_BUILD_INPUT_TYPE_TRIANGLES || type > OPTIX_BUILD_INPUT_TYPE_SPHERES) return buildFlags;
+
+    unsigned int kind = ACCEL_KIND(type), flags = buildFlags;
+
+    if (operation == OPTIX_BUILD_OPERATION_UPDATE) accel_rules_update(kind, type);
+
+    for (size_t i = 0; i < accel_rules_count; i++)
+    {
+        struct accel_rule *rule = &accel_rules[i];
+        unsigned int clear = rule->clear;
+
+        if (!(rule->kinds & kind)) continue;
+
+        if (update_kinds & kind) clear &= ~OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+
+        unsigned int new_flags = (flags & ~clear) | rule->set;
+
+        if (new_flags == flags) continue;
+
+        if (build && (flags & ~new_flags & OPTIX_BUILD_FLAG_ALLOW_UPDATE)) InterlockedIncrement(&rule->update_stripped);
+
+        if ((build ? InterlockedIncrement(&rule->builds) : InterlockedIncrement(&rule->queries)) == 1)
+            WARN("Accel build rule %zu rewrites %s flags %#x -> %#x (input type %#x, abi %d)\n", i + 1, build ? "build" : "sizing", flags, new_flags, type, abi);
+
+        flags = new_flags;
+    }
+
+    if (flags != buildFlags) TRACE("buildFlags %#x -> %#x\n", buildFlags, flags);
+
+    return flags;
+}
+
+const char *accel_build_input_name(const void *buildInputs, unsigned int numBuildInputs)
+{
+    int type;
+
+    if (!buildInputs || !numBuildInputs) return "empty";
+
+    if ((type = *(const int *)buildInputs) < OPTIX_BUILD_INPUT_TYPE_TRIANGLES || type > OPTIX_BUILD_INPUT_TYPE_SPHERES) return "unknown";
+
+    for (size_t i = 0; i < ARRAY_SIZE(accel_kinds); i++)
+    {
+        if (accel_kinds[i].value == ACCEL_KIND(type)) return accel_kinds[i].name;
+    }
+
+    return "unknown";
+}
+
+void accel_close(void)
+{
+    for (size_t i = 0; i < accel_rules_count; i++)
+    {
+        WARN("Accel build rule %zu %s rewrote %ld builds and %ld memory usage queries\n",
+             i + 1, debugstr_a(accel_rules[i].text), (long)accel_rules[i].builds, (long)accel_rules[i].queries);
+        free(accel_rules[i].text);
+    }
+
+    free(accel_rules);
+    accel_rules = NULL;
+    accel_rules_count = 0;
+    update_kinds = 0;
+}
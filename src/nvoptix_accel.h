@@ -0,0 +1,245 @@
+#pragma once
+
+#include "nvoptix_timing.h"
+
+#define OPTIX_BUILD_FLAG_NONE 0
+#define OPTIX_BUILD_FLAG_ALLOW_UPDATE (1u << 0)
+#define OPTIX_BUILD_FLAG_ALLOW_COMPACTION (1u << 1)
+#define OPTIX_BUILD_FLAG_PREFER_FAST_TRACE (1u << 2)
+#define OPTIX_BUILD_FLAG_PREFER_FAST_BUILD (1u << 3)
+#define OPTIX_BUILD_FLAG_ALLOW_RANDOM_VERTEX_ACCESS (1u << 4)
+#define OPTIX_BUILD_FLAG_ALLOW_RANDOM_INSTANCE_ACCESS (1u << 5)
+
+#define OPTIX_BUILD_OPERATION_BUILD 0x2161
+#define OPTIX_BUILD_OPERATION_UPDATE 0x2162
+
+#define OPTIX_BUILD_INPUT_TYPE_TRIANGLES 0x2141
+#define OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES 0x2142
+#define OPTIX_BUILD_INPUT_TYPE_INSTANCES 0x2143
+#define OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS 0x2144
+#define OPTIX_BUILD_INPUT_TYPE_CURVES 0x2145
+#define OPTIX_BUILD_INPUT_TYPE_SPHERES 0x2146
+
+// build flag rewrite rules from the `accel_build_rules` profile key
+//
+// Rules are separated by `;`, each is `<selectors>: <actions>`. Selectors are a `,`
+// separated list of `all`, `gas`, `ias`, `triangles`, `custom`, `instances`,
+// `instance_pointers`, `curves` and `spheres`, matched against the type of the build
+// inputs. Actions are `+flag` or `-flag` with flag one of `allow_update`,
+// `allow_compaction`, `prefer_fast_trace`, `prefer_fast_build`,
+// `allow_random_vertex_access`, `allow_random_instance_access` or a number.
+// eg. `gas: +prefer_fast_trace +allow_compaction -allow_update; ias: +prefer_fast_build`
+
+_Bool accel_rules_enabled(void);
+unsigned int accel_apply_rules(int abi, unsigned int buildFlags, int operation, const void *buildInputs, unsigned int numBuildInputs, _Bool build);
+const char *accel_build_input_name(const void *buildInputs, unsigned int numBuildInputs);
+
+void accel_close(void);
+
+// build input descriptors, the parts used here have the same layout in all ABIs
+
+struct accel_build_options
+{
+    unsigned int buildFlags;
+    int operation;
+    unsigned short numKeys;
+    unsigned short motionFlags;
+    float timeBegin;
+    float timeEnd;
+};
+
+struct accel_triangle_array
+{
+    const CUdeviceptr *vertexBuffers;
+    unsigned int numVertices;
+    int vertexFormat;
+    unsigned int vertexStrideInBytes;
+    CUdeviceptr indexBuffer;
+    unsigned int numIndexTriplets;
+    int indexFormat;
+    unsigned int indexStrideInBytes;
+    CUdeviceptr preTransform;
+    const unsigned int *flags;
+    unsigned int numSbtRecords;
+    CUdeviceptr sbtIndexOffsetBuffer;
+    unsigned int sbtIndexOffsetSizeInBytes;
+    unsigned int sbtIndexOffsetStrideInBytes;
+    unsigned int primitiveIndexOffset;
+    int transformFormat; // ABI 41+, padding before
+};
+
+struct accel_custom_primitive_array
+{
+    const CUdeviceptr *aabbBuffers;
+    unsigned int numPrimitives;
+    unsigned int strideInBytes;
+    const unsigned int *flags;
+    unsigned int numSbtRecords;
+    CUdeviceptr sbtIndexOffsetBuffer;
+    unsigned int sbtIndexOffsetSizeInBytes;
+    unsigned int sbtIndexOffsetStrideInBytes;
+    unsigned int primitiveIndexOffset;
+};
+
+struct accel_instance_array
+{
+    CUdeviceptr instances;
+    unsigned int numInstances;
+    unsigned int instanceStride; // ABI 68+, padding before
+};
+
+struct accel_build_input
+{
+    int type;
+    union
+    {
+        struct accel_triangle_array triangleArray;
+        struct accel_custom_primitive_array customPrimitiveArray;
+        struct accel_instance_array instanceArray;
+        char pad[1024];
+    };
+};
+
+// per output buffer build tracking (nvoptix_accel_build.c)
+//
+// With `accel_redundant_analysis=1` every build is fingerprinted and compared with the last
+// build into the same output buffer. Matches are only reported, never skipped: the relay
+// can't see the buffer being freed, reused or written by anything else. The GPU time of
+// redundant builds is collected by the timing harvester, the build itself never waits.
+// Hashing device data (`accel_redundant_hash`) does wait, it synchronizes the build stream
+// before every build to read the inputs.
+
+struct accel_build
+{
+    _Bool active;
+    _Bool redundant;
+    _Bool fingerprinted;
+    int abi;
+    CUstream stream;
+    struct accel_build_options options;
+    size_t tempBufferSizeInBytes;
+    CUdeviceptr outputBuffer;
+    size_t outputBufferSizeInBytes;
+    unsigned long long fingerprint;
+    struct gpu_timing timing;
+};
+
+_Bool accel_analysis_enabled(void);
+void accel_build_begin(struct accel_build *build, int abi, CUstream stream, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, size_t tempBufferSizeInBytes,
+                       CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes);
+void accel_build_end(struct accel_build *build, OptixResult result);
+
+struct accel_refit
+{
+    _Bool active;
+    _Bool refittable;
+    _Bool converted;
+    CUdeviceptr outputBuffer;
+    size_t outputBufferSizeInBytes;
+    unsigned long long topology;
+};
+
+_Bool accel_refit_enabled(void);
+BOOL accel_refit_begin(struct accel_refit *refit, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs,
+                       CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, unsigned int numEmittedProperties);
+void accel_refit_reject(struct accel_refit *refit);
+void accel_refit_end(struct accel_refit *refit, OptixResult result, int operation);
+
+// relay driven compaction (nvoptix_accel_compact.c)
+//
+// Builds with `allow_compaction` that don't emit the compacted size get the property added.
+// The size is copied back behind the build and the build waits for that copy, then the relay
+// compacts into a block of its pool and hands the compacted handle to the application in place
+// of the one of its buffer. The application's buffer keeps the original structure, updates and
+// relocations of it keep working. A compacted copy is released when the application builds,
+// compacts or relocates into its buffer again, or destroys the device context; its block is
+// reused or freed once an event recorded at release has completed, as work queued before may
+// still trace it.
+
+struct accel_pool_block
+{
+    CUdeviceptr ptr;
+    size_t size;
+    void *event;
+};
+
+struct accel_compaction
+{
+    _Bool active;
+    OptixDeviceContext context;
+    CUstream stream;
+    CUdeviceptr outputBuffer;
+    size_t outputBufferSizeInBytes;
+    void *emitted;
+    unsigned int slab;
+    unsigned int slot;
+    void *event;
+    struct accel_pool_block block;
+};
+
+_Bool accel_compaction_enabled(void);
+void accel_compaction_begin(struct accel_compaction *compaction, OptixDeviceContext context, CUstream stream, const void *accelOptions,
+                            CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, const void **emittedProperties, unsigned int *numEmittedProperties);
+BOOL accel_compaction_prepare(struct accel_compaction *compaction, OptixResult result);
+void accel_compaction_end(struct accel_compaction *compaction, OptixResult result, OptixTraversableHandle compactedHandle, OptixTraversableHandle *outputHandle);
+void accel_compaction_forget(CUdeviceptr buffer);
+void accel_compaction_context_destroy(OptixDeviceContext context);
+void accel_compaction_close(void);
+
+// acceleration structure and micromap memory accounting (nvoptix_accel_memory.c)
+
+enum accel_memory_query
+{
+    ACCEL_MEMORY_QUERY_ACCEL,
+    ACCEL_MEMORY_QUERY_OPACITY_MICROMAP,
+    ACCEL_MEMORY_QUERY_DISPLACEMENT_MICROMAP,
+    ACCEL_MEMORY_QUERY_COUNT,
+};
+
+// common prefix of OptixAccelBufferSizes and OptixMicromapBufferSizes
+
+struct accel_buffer_sizes
+{
+    size_t outputSizeInBytes;
+    size_t tempSizeInBytes;
+};
+
+struct accel_micromap_buffers
+{
+    CUdeviceptr output;
+    size_t outputSizeInBytes;
+    CUdeviceptr temp;
+    size_t tempSizeInBytes;
+};
+
+_Bool accel_memory_enabled(void);
+void accel_memory_query(OptixDeviceContext context, enum accel_memory_query kind, OptixResult result, const void *bufferSizes);
+void accel_memory_build(OptixDeviceContext context, OptixResult result, CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes,
+                        CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle handle);
+void accel_memory_compact(OptixDeviceContext context, OptixResult result, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle handle);
+void accel_memory_micromap_build(OptixDeviceContext context, OptixResult result, const void *buffers);
+void accel_memory_context_destroy(OptixDeviceContext context);
+void accel_memory_close(void);
+
+// traversable graph depth tracking (nvoptix_accel_graph.c)
+//
+// Instance builds are followed by a cuStreamSynchronize on the build stream and a read back
+// of the instances, so every instance build costs a full wait for the GPU while tracking is
+// on. Instance arrays are read in chunks, pointed to instances sorted and read in runs of
+// neighbours, not one by one.
+
+_Bool accel_graph_enabled(void);
+void accel_graph_build(int abi, CUstream stream, OptixResult result, const void *buildInputs, unsigned int numBuildInputs, const OptixTraversableHandle *outputHandle);
+void accel_graph_compact(OptixResult result, OptixTraversableHandle inputHandle, const OptixTraversableHandle *outputHandle);
+void accel_graph_transform(OptixResult result, CUdeviceptr pointer, int traversableType, const OptixTraversableHandle *traversableHandle);
+void accel_graph_relocation_info(OptixResult result, OptixTraversableHandle handle, const void *info);
+void accel_graph_relocate(OptixResult result, const void *info, const OptixTraversableHandle *targetHandle);
+void accel_graph_stack_size(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState,
+                            unsigned int continuationStackSize, unsigned int *maxTraversableGraphDepth);
+BOOL accel_graph_launch(OptixPipeline pipeline, unsigned int args[4]);
+void accel_graph_pipeline_destroy(OptixPipeline pipeline);
+void accel_graph_close(void);
+
+void accel_build_invalidate(CUdeviceptr buffer);
+void accel_build_launch(void);
+void accel_build_close(void);
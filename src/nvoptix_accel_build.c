@@ -0,0 +1,717 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_cuda.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_timing.h"
+
+C_ASSERT(sizeof(struct accel_build_input) == 1032);
+C_ASSERT(sizeof(struct accel_build_options) == 20);
+C_ASSERT(sizeof(struct accel_triangle_array) == 96);
+C_ASSERT(sizeof(struct accel_custom_primitive_array) == 56);
+
+#define OPTIX_VERTEX_FORMAT_FLOAT3 0x2121
+#define OPTIX_VERTEX_FORMAT_FLOAT2 0x2122
+#define OPTIX_VERTEX_FORMAT_HALF3 0x2123
+#define OPTIX_VERTEX_FORMAT_HALF2 0x2124
+#define OPTIX_VERTEX_FORMAT_SNORM16_3 0x2125
+#define OPTIX_VERTEX_FORMAT_SNORM16_2 0x2126
+
+#define OPTIX_INDICES_FORMAT_UNSIGNED_BYTE3 0x2101
+#define OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3 0x2102
+#define OPTIX_INDICES_FORMAT_UNSIGNED_INT3 0x2103
+
+#define OPTIX_AABB_SIZE 24
+#define OPTIX_INSTANCE_SIZE 80
+#define OPTIX_PRE_TRANSFORM_SIZE 48
+
+#define SAMPLE_COUNT 16
+#define SAMPLE_SIZE 64
+#define CHUNK_SIZE (1024 * 1024)
+
+enum accel_hash_mode
+{
+    ACCEL_HASH_NONE,
+    ACCEL_HASH_SAMPLED,
+    ACCEL_HASH_FULL,
+};
+
+static const char *hash_mode_names[] = { "descriptor only", "sampled device data", "full device data" };
+
+// last build into an output buffer, open addressing keyed on the buffer address
+
+struct accel_entry
+{
+    CUdeviceptr buffer;
+    size_t size;
+    uint64_t fingerprint;
+    _Bool valid;
+    uint64_t topology;
+    unsigned int updates;
+    _Bool refittable;
+};
+
+struct accel_stats
+{
+    unsigned int builds;
+    unsigned int redundant;
+    size_t wasted_temp;
+    unsigned long long wasted_us;
+};
+
+static pthread_once_t analysis_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t entries_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool analysis_enabled;
+static enum accel_hash_mode analysis_hash;
+
+static pthread_once_t refit_once = PTHREAD_ONCE_INIT;
+static _Bool refit_enabled;
+static unsigned int refit_interval;
+static LONG refit_converted;
+static LONG refit_forced;
+static LONG refit_rejected;
+
+static struct accel_entry *entries = NULL;
+static size_t entries_capacity = 0;
+static size_t entries_count = 0;
+
+static unsigned int frame = 0;
+static LONG launched = 0;
+static struct accel_stats frame_stats;
+static struct accel_stats total_stats;
+
+// GPU time of redundant builds, added by the timing harvester whenever they finish
+
+static unsigned long long wasted_us;
+static unsigned long long frame_wasted_us;
+
+static void analysis_init(void)
+{
+    const char *value;
+
+    if (!(analysis_enabled = profile_get_int("accel_redundant_analysis", 0))) return;
+
+    if (!(value = profile_get("accel_redundant_hash")) || !strcasecmp(value, "none"))
+        analysis_hash = ACCEL_HASH_NONE;
+    else if (!strcasecmp(value, "sampled"))
+        analysis_hash = ACCEL_HASH_SAMPLED;
+    else if (!strcasecmp(value, "full"))
+        analysis_hash = ACCEL_HASH_FULL;
+    else
+        ERR("Invalid accel_redundant_hash = %s\n", debugstr_a(value));
+
+    if (analysis_hash != ACCEL_HASH_NONE && !cuda_available())
+    {
+        ERR("Device data hashing needs libcuda.so.1, falling back to descriptors only\n");
+        analysis_hash = ACCEL_HASH_NONE;
+    }
+
+    WARN("Redundant accel build analysis enabled, hashing %s%s\n", hash_mode_names[analysis_hash],
+         analysis_hash != ACCEL_HASH_NONE ? ", every build waits for its stream" : "");
+}
+
+_Bool accel_analysis_enabled(void)
+{
+    pthread_once(&analysis_once, analysis_init);
+
+    return analysis_enabled;
+}
+
+static uint64_t hash_data(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *ptr = data;
+
+    while (size >= 8)
+    {
+        uint64_t word;
+
+        memcpy(&word, ptr, 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+        ptr += 8;
+        size -= 8;
+    }
+
+    while (size--) hash = (hash ^ *ptr++) * 0x100000001b3ull;
+
+    return hash;
+}
+
+static uint64_t hash_u64(uint64_t hash, uint64_t value)
+{
+    return hash_data(hash, &value, sizeof(value));
+}
+
+// device data is read after the build stream has caught up with the uploads queued on it
+
+static BOOL hash_device(uint64_t *hash, CUdeviceptr ptr, size_t size)
+{
+    unsigned char sample[SAMPLE_SIZE];
+    size_t offset = 0;
+
+    *hash = hash_u64(hash_u64(*hash, (uintptr_t)ptr), size);
+
+    if (!ptr || !size || analysis_hash == ACCEL_HASH_NONE) return TRUE;
+
+    if (analysis_hash == ACCEL_HASH_SAMPLED || size <= SAMPLE_SIZE)
+    {
+        for (unsigned int i = 0; i < SAMPLE_COUNT && offset < size; i++)
+        {
+            size_t len = min(size - offset, SAMPLE_SIZE);
+
+            if (cuda.pcuMemcpyDtoH(sample, (char *)ptr + offset, len) != CUDA_SUCCESS) return FALSE;
+
+            *hash = hash_data(*hash, sample, len);
+
+            if (size <= SAMPLE_SIZE * SAMPLE_COUNT)
+                offset += len;
+            else
+                offset = (size - SAMPLE_SIZE) / (SAMPLE_COUNT - 1) * (i + 1);
+        }
+
+        return TRUE;
+    }
+
+    unsigned char *chunk = malloc(min(size, CHUNK_SIZE));
+    BOOL ret = chunk != NULL;
+
+    for (; ret && offset < size; offset += CHUNK_SIZE)
+    {
+        size_t len = min(size - offset, CHUNK_SIZE);
+
+        if (!(ret = cuda.pcuMemcpyDtoH(chunk, (char *)ptr + offset, len) == CUDA_SUCCESS)) break;
+
+        *hash = hash_data(*hash, chunk, len);
+    }
+
+    free(chunk);
+
+    return ret;
+}
+
+static size_t strided_size(unsigned int count, unsigned int stride, unsigned int element)
+{
+    if (!count) return 0;
+
+    return (size_t)(count - 1) * (stride ? stride : element) + element;
+}
+
+static unsigned int vertex_size(int format)
+{
+    switch (format)
+    {
+        case OPTIX_VERTEX_FORMAT_FLOAT3: return 12;
+        case OPTIX_VERTEX_FORMAT_FLOAT2: return 8;
+        case OPTIX_VERTEX_FORMAT_HALF3: return 6;
+        case OPTIX_VERTEX_FORMAT_HALF2: return 4;
+        case OPTIX_VERTEX_FORMAT_SNORM16_3: return 6;
+        case OPTIX_VERTEX_FORMAT_SNORM16_2: return 4;
+        default: return 0;
+    }
+}
+
+static unsigned int index_size(int format)
+{
+    switch (format)
+    {
+        case OPTIX_INDICES_FORMAT_UNSIGNED_BYTE3: return 3;
+        case OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3: return 6;
+        case OPTIX_INDICES_FORMAT_UNSIGNED_INT3: return 12;
+        default: return 0;
+    }
+}
+
+// anything set past the fields we understand (eg. micromaps) makes the descriptor unknown
+
+static BOOL tail_is_zero(const struct accel_build_input *input, size_t offset)
+{
+    const unsigned char *pad = (const unsigned char *)input->pad;
+
+    for (size_t i = offset; i < sizeof(input->pad); i++)
+    {
+        if (pad[i]) return FALSE;
+    }
+
+    return TRUE;
+}
+
+static BOOL hash_triangles(uint64_t *hash, const struct accel_triangle_array *array, unsigned int numKeys)
+{
+    unsigned int primitives = array->indexFormat ? array->numIndexTriplets : array->numVertices / 3;
+
+    *hash = hash_data(*hash, &array->numVertices, offsetof(struct accel_triangle_array, flags) - offsetof(struct accel_triangle_array, numVertices));
+    *hash = hash_data(*hash, &array->numSbtRecords, sizeof(*array) - offsetof(struct accel_triangle_array, numSbtRecords));
+
+    if (array->numVertices && !array->vertexBuffers) return FALSE;
+    if (array->numSbtRecords && !array->flags) return FALSE;
+
+    *hash = hash_data(*hash, array->flags, array->numSbtRecords * sizeof(unsigned int));
+
+    for (unsigned int i = 0; i < numKeys && array->numVertices; i++)
+    {
+        if (!hash_device(hash, array->vertexBuffers[i], strided_size(array->numVertices, array->vertexStrideInBytes, vertex_size(array->vertexFormat)))) return FALSE;
+    }
+
+    if (array->indexFormat && !hash_device(hash, array->indexBuffer, strided_size(array->numIndexTriplets, array->indexStrideInBytes, index_size(array->indexFormat)))) return FALSE;
+    if (!hash_device(hash, array->preTransform, array->preTransform ? OPTIX_PRE_TRANSFORM_SIZE : 0)) return FALSE;
+
+    if (array->numSbtRecords > 1 && !hash_device(hash, array->sbtIndexOffsetBuffer, strided_size(primitives, array->sbtIndexOffsetStrideInBytes, array->sbtIndexOffsetSizeInBytes))) return FALSE;
+
+    return TRUE;
+}
+
+static BOOL hash_custom_primitives(uint64_t *hash, const struct accel_custom_primitive_array *array, unsigned int numKeys)
+{
+    *hash = hash_data(*hash, &array->numPrimitives, 2 * sizeof(unsigned int));
+    *hash = hash_data(*hash, &array->numSbtRecords, sizeof(*array) - offsetof(struct accel_custom_primitive_array, numSbtRecords));
+
+    if (array->numPrimitives && !array->aabbBuffers) return FALSE;
+    if (array->numSbtRecords && !array->flags) return FALSE;
+
+    *hash = hash_data(*hash, array->flags, array->numSbtRecords * sizeof(unsigned int));
+
+    for (unsigned int i = 0; i < numKeys && array->numPrimitives; i++)
+    {
+        if (!hash_device(hash, array->aabbBuffers[i], strided_size(array->numPrimitives, array->strideInBytes, OPTIX_AABB_SIZE))) return FALSE;
+    }
+
+    if (array->numSbtRecords > 1 && !hash_device(hash, array->sbtIndexOffsetBuffer, strided_size(array->numPrimitives, array->sbtIndexOffsetStrideInBytes, array->sbtIndexOffsetSizeInBytes))) return FALSE;
+
+    return TRUE;
+}
+
+// instance descriptors hold no host pointers, but the instances reference other acceleration
+// structures that may have been rebuilt in place, identical instance data is no proof
+
+static BOOL hash_instances(uint64_t *hash, const struct accel_build_input *input, int abi)
+{
+    const struct accel_instance_array *array = &input->instanceArray;
+
+    *hash = hash_data(*hash, input->pad, sizeof(input->pad));
+
+    if (input->type == OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS)
+        return hash_device(hash, array->instances, (size_t)array->numInstances * sizeof(CUdeviceptr));
+
+    return hash_device(hash, array->instances, strided_size(array->numInstances, abi >= 68 ? array->instanceStride : 0, OPTIX_INSTANCE_SIZE));
+}
+
+// reading the inputs means waiting for the uploads queued before the build, the one place the analysis stalls
+
+static BOOL fingerprint(struct accel_build *build, const struct accel_build_input *inputs, unsigned int numBuildInputs)
+{
+    unsigned int numKeys = max(build->options.numKeys, 1);
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    if (!inputs && numBuildInputs) return FALSE;
+
+    if (analysis_hash != ACCEL_HASH_NONE && cuda.pcuStreamSynchronize(build->stream) != CUDA_SUCCESS) return FALSE;
+
+    hash = hash_data(hash, &build->options, sizeof(build->options));
+    hash = hash_u64(hash, numBuildInputs);
+
+    for (unsigned int i = 0; i < numBuildInputs; i++)
+    {
+        const struct accel_build_input *input = &inputs[i];
+        BOOL ret;
+
+        hash = hash_u64(hash, input->type);
+
+        switch (input->type)
+        {
+            case OPTIX_BUILD_INPUT_TYPE_TRIANGLES:
+                ret = tail_is_zero(input, sizeof(struct accel_triangle_array)) && hash_triangles(&hash, &input->triangleArray, numKeys);
+                break;
+
+            case OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES:
+                ret = tail_is_zero(input, sizeof(struct accel_custom_primitive_array)) && hash_custom_primitives(&hash, &input->customPrimitiveArray, numKeys);
+                break;
+
+            case OPTIX_BUILD_INPUT_TYPE_INSTANCES:
+            case OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS:
+                ret = hash_instances(&hash, input, build->abi);
+                break;
+
+            default:
+                // curves, spheres and newer types carry host pointers we don't know about
+                ret = FALSE;
+                break;
+        }
+
+        if (!ret) return FALSE;
+    }
+
+    build->fingerprint = hash;
+
+    return TRUE;
+}
+
+static struct accel_entry *lookup_entry(CUdeviceptr buffer, BOOL create)
+{
+    if (entries_capacity)
+    {
+        size_t mask = entries_capacity - 1;
+
+        for (size_t i = hash_u64(0, (uintptr_t)buffer) & mask;; i = (i + 1) & mask)
+        {
+            if (entries[i].buffer == buffer) return &entries[i];
+            if (!entries[i].buffer) break;
+        }
+    }
+
+    if (!create) return NULL;
+
+    if ((entries_count + 1) * 2 > entries_capacity)
+    {
+        size_t capacity = entries_capacity ? entries_capacity * 2 : 256;
+        struct accel_entry *new_entries = calloc(capacity, sizeof(struct accel_entry));
+
+        if (!new_entries)
+        {
+            ERR("Failed to allocate accel build entries\n");
+            return NULL;
+        }
+
+        for (size_t i = 0; i < entries_capacity; i++)
+        {
+            if (!entries[i].buffer) continue;
+
+            size_t j = hash_u64(0, (uintptr_t)entries[i].buffer) & (capacity - 1);
+
+            while (new_entries[j].buffer) j = (j + 1) & (capacity - 1);
+            new_entries[j] = entries[i];
+        }
+
+        free(entries);
+        entries = new_entries;
+        entries_capacity = capacity;
+    }
+
+    size_t mask = entries_capacity - 1, i = hash_u64(0, (uintptr_t)buffer) & mask;
+
+    while (entries[i].buffer) i = (i + 1) & mask;
+
+    entries[i].buffer = buffer;
+    entries_count++;
+
+    return &entries[i];
+}
+
+static void report(const char *what, const struct accel_stats *stats)
+{
+    if (!stats->redundant) return;
+
+    WARN("%s: %u of %u builds redundant (%s), %.3f ms and %zu temp bytes wasted\n",
+         what, stats->redundant, stats->builds, hash_mode_names[analysis_hash], stats->wasted_us / 1e3, stats->wasted_temp);
+}
+
+// GPU time harvested since the last frame was reported, builds still running count for a later frame
+
+static void take_wasted(void)
+{
+    unsigned long long us = __atomic_load_n(&wasted_us, __ATOMIC_RELAXED);
+
+    frame_stats.wasted_us = us - frame_wasted_us;
+    total_stats.wasted_us = us;
+    frame_wasted_us = us;
+}
+
+// a frame ends with the first build after a launch
+
+static void next_frame(void)
+{
+    if (!InterlockedCompareExchange(&launched, 0, 1)) return;
+
+    char what[32];
+
+    take_wasted();
+
+    snprintf(what, sizeof(what), "Frame %u", frame);
+    report(what, &frame_stats);
+
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    frame++;
+}
+
+void accel_build_launch(void)
+{
+    launched = 1;
+}
+
+void accel_build_begin(struct accel_build *build, int abi, CUstream stream, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs, size_t tempBufferSizeInBytes,
+                       CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes)
+{
+    struct accel_entry *entry;
+
+    memset(build, 0, sizeof(*build));
+
+    if (!accel_analysis_enabled() || !accelOptions) return;
+
+    build->active = TRUE;
+    build->abi = abi;
+    build->stream = stream;
+    build->options = *(const struct accel_build_options *)accelOptions;
+    build->tempBufferSizeInBytes = tempBufferSizeInBytes;
+    build->outputBuffer = outputBuffer;
+    build->outputBufferSizeInBytes = outputBufferSizeInBytes;
+    build->fingerprinted = fingerprint(build, buildInputs, numBuildInputs);
+
+    if (pthread_mutex_lock(&entries_lock))
+    {
+        ERR("Failed to acquire accel build lock\n");
+        build->active = FALSE;
+        return;
+    }
+
+    next_frame();
+
+    frame_stats.builds++;
+    total_stats.builds++;
+
+    if (build->fingerprinted && (entry = lookup_entry(outputBuffer, FALSE)) && entry->valid &&
+        entry->fingerprint == build->fingerprint && entry->size == outputBufferSizeInBytes)
+    {
+        build->redundant = TRUE;
+        frame_stats.redundant++;
+        total_stats.redundant++;
+        frame_stats.wasted_temp += tempBufferSizeInBytes;
+        total_stats.wasted_temp += tempBufferSizeInBytes;
+    }
+
+    if (pthread_mutex_unlock(&entries_lock))
+        ERR("Failed to release accel build lock\n");
+
+    if (build->redundant) gpu_timing_begin(&build->timing, stream);
+}
+
+void accel_build_end(struct accel_build *build, OptixResult result)
+{
+    struct accel_entry *entry;
+
+    if (!build->active) return;
+
+    gpu_timing_accumulate(&build->timing, result, &wasted_us);
+
+    if (pthread_mutex_lock(&entries_lock))
+    {
+        ERR("Failed to acquire accel build lock\n");
+        return;
+    }
+
+    if ((entry = lookup_entry(build->outputBuffer, TRUE)))
+    {
+        entry->size = build->outputBufferSizeInBytes;
+        entry->fingerprint = build->fingerprint;
+        entry->valid = result == OPTIX_SUCCESS && build->fingerprinted;
+    }
+
+    if (pthread_mutex_unlock(&entries_lock))
+        ERR("Failed to release accel build lock\n");
+}
+
+static void refit_init(void)
+{
+    if (!(refit_enabled = profile_get_int("accel_refit_conversion", 0))) return;
+
+    refit_interval = max(profile_get_int("accel_refit_rebuild_interval", 16), 1);
+
+    WARN("Rebuild to refit conversion enabled, forcing a rebuild every %u frames\n", refit_interval);
+}
+
+_Bool accel_refit_enabled(void)
+{
+    pthread_once(&refit_once, refit_init);
+
+    return refit_enabled;
+}
+
+// everything that has to stay the same for an update: the counts, formats, index buffers
+// and per primitive data, but not the vertex or AABB buffers
+
+static BOOL hash_topology(uint64_t *hash, const struct accel_build_options *options, const struct accel_build_input *inputs, unsigned int numBuildInputs)
+{
+    *hash = 0xcbf29ce484222325ull;
+    *hash = hash_u64(*hash, options->buildFlags);
+    *hash = hash_data(*hash, &options->numKeys, sizeof(*options) - offsetof(struct accel_build_options, numKeys));
+    *hash = hash_u64(*hash, numBuildInputs);
+
+    if (!inputs || !numBuildInputs) return FALSE;
+
+    for (unsigned int i = 0; i < numBuildInputs; i++)
+    {
+        const struct accel_build_input *input = &inputs[i];
+
+        *hash = hash_u64(*hash, input->type);
+
+        if (input->type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES && tail_is_zero(input, sizeof(struct accel_triangle_array)))
+        {
+            const struct accel_triangle_array *array = &input->triangleArray;
+
+            if (array->numSbtRecords && !array->flags) return FALSE;
+
+            *hash = hash_data(*hash, &array->numVertices, offsetof(struct accel_triangle_array, preTransform) - offsetof(struct accel_triangle_array, numVertices));
+            *hash = hash_u64(*hash, array->preTransform != NULL);
+            *hash = hash_data(*hash, &array->numSbtRecords, sizeof(*array) - offsetof(struct accel_triangle_array, numSbtRecords));
+            *hash = hash_data(*hash, array->flags, array->numSbtRecords * sizeof(unsigned int));
+        }
+        else if (input->type == OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES && tail_is_zero(input, sizeof(struct accel_custom_primitive_array)))
+        {
+            const struct accel_custom_primitive_array *array = &input->customPrimitiveArray;
+
+            if (array->numSbtRecords && !array->flags) return FALSE;
+
+            *hash = hash_data(*hash, &array->numPrimitives, 2 * sizeof(unsigned int));
+            *hash = hash_data(*hash, &array->numSbtRecords, sizeof(*array) - offsetof(struct accel_custom_primitive_array, numSbtRecords));
+            *hash = hash_data(*hash, array->flags, array->numSbtRecords * sizeof(unsigned int));
+        }
+        else
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+BOOL accel_refit_begin(struct accel_refit *refit, const void *accelOptions, const void *buildInputs, unsigned int numBuildInputs,
+                       CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, unsigned int numEmittedProperties)
+{
+    const struct accel_build_options *options = accelOptions;
+    struct accel_entry *entry;
+    uint64_t hash;
+
+    memset(refit, 0, sizeof(*refit));
+
+    if (!accel_refit_enabled() || !options || !(options->buildFlags & OPTIX_BUILD_FLAG_ALLOW_UPDATE)) return FALSE;
+
+    refit->active = TRUE;
+    refit->outputBuffer = outputBuffer;
+    refit->outputBufferSizeInBytes = outputBufferSizeInBytes;
+    refit->refittable = hash_topology(&hash, options, buildInputs, numBuildInputs);
+    refit->topology = hash;
+
+    // emitted properties of the application's build would be those of an update, leave those alone
+
+    if (!refit->refittable || numEmittedProperties || options->operation != OPTIX_BUILD_OPERATION_BUILD) return FALSE;
+
+    if (pthread_mutex_lock(&entries_lock))
+    {
+        ERR("Failed to acquire accel build lock\n");
+        refit->active = FALSE;
+        return FALSE;
+    }
+
+    if ((entry = lookup_entry(outputBuffer, FALSE)) && entry->refittable &&
+        entry->topology == refit->topology && entry->size == outputBufferSizeInBytes)
+    {
+        if (entry->updates + 1 >= refit_interval)
+            InterlockedIncrement(&refit_forced);
+        else
+            refit->converted = TRUE;
+    }
+
+    if (pthread_mutex_unlock(&entries_lock))
+        ERR("Failed to release accel build lock\n");
+
+    return refit->converted;
+}
+
+void accel_refit_reject(struct accel_refit *refit)
+{
+    refit->converted = FALSE;
+    InterlockedIncrement(&refit_rejected);
+}
+
+void accel_refit_end(struct accel_refit *refit, OptixResult result, int operation)
+{
+    struct accel_entry *entry;
+
+    if (!refit->active) return;
+
+    if (pthread_mutex_lock(&entries_lock))
+    {
+        ERR("Failed to acquire accel build lock\n");
+        return;
+    }
+
+    if ((entry = lookup_entry(refit->outputBuffer, TRUE)))
+    {
+        if (result != OPTIX_SUCCESS)
+        {
+            entry->refittable = FALSE;
+        }
+        else if (refit->converted)
+        {
+            TRACE("Converted rebuild of %p to refit %u\n", refit->outputBuffer, entry->updates + 1);
+
+            entry->updates++;
+            InterlockedIncrement(&refit_converted);
+        }
+        else if (operation == OPTIX_BUILD_OPERATION_BUILD)
+        {
+            entry->size = refit->outputBufferSizeInBytes;
+            entry->topology = refit->topology;
+            entry->refittable = refit->refittable;
+            entry->updates = 0;
+        }
+    }
+
+    if (pthread_mutex_unlock(&entries_lock))
+        ERR("Failed to release accel build lock\n");
+}
+
+// compaction and relocation write acceleration structures without a build
+
+void accel_build_invalidate(CUdeviceptr buffer)
+{
+    struct accel_entry *entry;
+
+    accel_compaction_forget(buffer);
+
+    if (!accel_analysis_enabled() && !accel_refit_enabled()) return;
+
+    if (pthread_mutex_lock(&entries_lock))
+    {
+        ERR("Failed to acquire accel build lock\n");
+        return;
+    }
+
+    if ((entry = lookup_entry(buffer, FALSE))) entry->valid = entry->refittable = FALSE;
+
+    if (pthread_mutex_unlock(&entries_lock))
+        ERR("Failed to release accel build lock\n");
+}
+
+void accel_build_close(void)
+{
+    if (analysis_enabled)
+    {
+        char what[32];
+
+        take_wasted();
+
+        snprintf(what, sizeof(what), "Frame %u", frame);
+        report(what, &frame_stats);
+        report("All frames", &total_stats);
+    }
+
+    if (refit_enabled)
+        WARN("Converted %ld rebuilds to refits, forced %ld rebuilds, %ld refits rejected for temp buffer size\n",
+             (long)refit_converted, (long)refit_forced, (long)refit_rejected);
+
+    free(entries);
+    entries = NULL;
+    entries_capacity = entries_count = 0;
+}
@@ -0,0 +1,502 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_cuda.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+
+#define OPTIX_PROPERTY_TYPE_COMPACTED_SIZE 0x2181
+
+#define OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT 128
+#define SIZE_SLOTS 64
+
+struct accel_emit_desc
+{
+    CUdeviceptr result;
+    int type;
+};
+
+C_ASSERT(sizeof(struct accel_emit_desc) == 16);
+
+// compacted sizes are emitted into a device slab of the current CUDA context and copied
+// to its pinned host mirror on the build stream
+
+struct size_slab
+{
+    CUcontext context;
+    CUdeviceptr device;
+    uint64_t *host;
+    uint64_t used;
+};
+
+// compacted copy of the structure the application built into `buffer`
+
+struct compact_entry
+{
+    CUdeviceptr buffer;
+    OptixDeviceContext context;
+    size_t size;
+    struct accel_pool_block block;
+};
+
+static pthread_once_t compaction_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t compaction_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool compaction_enabled;
+
+static struct size_slab *slabs = NULL;
+static size_t slabs_count = 0;
+
+static struct accel_pool_block *free_blocks = NULL;
+static size_t free_blocks_count = 0;
+static struct accel_pool_block *pending_blocks = NULL;
+static size_t pending_blocks_count = 0;
+
+static struct compact_entry *compacted = NULL;
+static size_t compacted_count = 0;
+
+static size_t pool_limit;
+static size_t pool_allocated;
+static size_t pool_high;
+
+static unsigned long compacted_total;
+static unsigned long skipped;
+static unsigned long failed;
+static size_t live_size;
+static size_t live_compacted;
+
+static void compaction_init(void)
+{
+    if (!(compaction_enabled = profile_get_int("accel_compaction", 0))) return;
+
+    if (!cuda_available())
+    {
+        ERR("Accel compaction needs libcuda.so.1, disabled\n");
+        compaction_enabled = FALSE;
+        return;
+    }
+
+    pool_limit = (size_t)max(profile_get_int("accel_compaction_pool_mb", 1024), 1) << 20;
+
+    WARN("Compacting acceleration structures into a pool of at most %zu MiB\n", pool_limit >> 20);
+}
+
+_Bool accel_compaction_enabled(void)
+{
+    pthread_once(&compaction_once, compaction_init);
+
+    return compaction_enabled;
+}
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&compaction_lock)) return TRUE;
+
+    ERR("Failed to acquire accel compaction lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&compaction_lock))
+        ERR("Failed to release accel compaction lock\n");
+}
+
+static BOOL take_slot(unsigned int *slab, unsigned int *slot)
+{
+    struct size_slab *new_slabs;
+    CUcontext context;
+    size_t i;
+
+    if (cuda.pcuCtxGetCurrent(&context) != CUDA_SUCCESS || !context) return FALSE;
+
+    for (i = 0; i < slabs_count; i++)
+    {
+        if (slabs[i].context == context) break;
+    }
+
+    if (i == slabs_count)
+    {
+        if (!(new_slabs = reallocarray(slabs, slabs_count + 1, sizeof(struct size_slab))))
+        {
+            ERR("Failed to reallocate compacted size slabs\n");
+            return FALSE;
+        }
+
+        slabs = new_slabs;
+        memset(&slabs[i], 0, sizeof(struct size_slab));
+
+        if (cuda.pcuMemAlloc(&slabs[i].device, SIZE_SLOTS * sizeof(uint64_t)) != CUDA_SUCCESS)
+            return FALSE;
+
+        if (cuda.pcuMemAllocHost((void **)&slabs[i].host, SIZE_SLOTS * sizeof(uint64_t)) != CUDA_SUCCESS)
+        {
+            cuda.pcuMemFree(slabs[i].device);
+            return FALSE;
+        }
+
+        slabs[i].context = context;
+        slabs_count++;
+    }
+
+    if (!~slabs[i].used) return FALSE;
+
+    *slab = i;
+    *slot = __builtin_ctzll(~slabs[i].used);
+    slabs[i].used |= 1ull << *slot;
+
+    return TRUE;
+}
+
+static void give_slot(unsigned int slab, unsigned int slot)
+{
+    slabs[slab].used &= ~(1ull << slot);
+}
+
+static BOOL append_block(struct accel_pool_block **blocks, size_t *count, const struct accel_pool_block *block)
+{
+    struct accel_pool_block *new_blocks = reallocarray(*blocks, *count + 1, sizeof(struct accel_pool_block));
+
+    if (!new_blocks)
+    {
+        ERR("Failed to reallocate compaction pool blocks\n");
+        return FALSE;
+    }
+
+    *blocks = new_blocks;
+    (*blocks)[(*count)++] = *block;
+
+    return TRUE;
+}
+
+static void free_block(const struct accel_pool_block *block)
+{
+    if (block->event) cuda.pcuEventDestroy(block->event);
+
+    if (cuda.pcuMemFree(block->ptr) != CUDA_SUCCESS)
+        ERR("Failed to free compacted buffer %p\n", block->ptr);
+
+    pool_allocated -= block->size;
+}
+
+// moves released blocks whose last use has completed to the free list, never waits for the GPU
+
+static void pool_reclaim(void)
+{
+    for (size_t i = 0; i < pending_blocks_count;)
+    {
+        struct accel_pool_block block = pending_blocks[i];
+
+        if (block.event && cuda.pcuEventQuery(block.event) == CUDA_ERROR_NOT_READY)
+        {
+            i++;
+            continue;
+        }
+
+        pending_blocks[i] = pending_blocks[--pending_blocks_count];
+
+        if (block.event) cuda.pcuEventDestroy(block.event);
+        block.event = NULL;
+
+        if (!append_block(&free_blocks, &free_blocks_count, &block)) free_block(&block);
+    }
+}
+
+static BOOL pool_alloc(size_t size, struct accel_pool_block *block)
+{
+    size_t best = free_blocks_count;
+
+    size = (size + OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT - 1) & ~(size_t)(OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT - 1);
+
+    pool_reclaim();
+
+    // reuse the smallest free block that fits without wasting more than half of it
+
+    for (size_t i = 0; i < free_blocks_count; i++)
+    {
+        if (free_blocks[i].size < size || free_blocks[i].size > size * 2) continue;
+        if (best == free_blocks_count || free_blocks[i].size < free_blocks[best].size) best = i;
+    }
+
+    if (best != free_blocks_count)
+    {
+        *block = free_blocks[best];
+        free_blocks[best] = free_blocks[--free_blocks_count];
+        return TRUE;
+    }
+
+    while (pool_allocated + size > pool_limit && free_blocks_count)
+        free_block(&free_blocks[--free_blocks_count]);
+
+    if (pool_allocated + size > pool_limit) return FALSE;
+
+    memset(block, 0, sizeof(*block));
+
+    if (cuda.pcuMemAlloc(&block->ptr, size) != CUDA_SUCCESS) return FALSE;
+
+    block->size = size;
+    pool_allocated += size;
+    pool_high = max(pool_high, pool_allocated);
+
+    return TRUE;
+}
+
+// the block may still be read by work queued on the stream, it is reused once that is done
+
+static void pool_release(struct accel_pool_block *block, CUstream stream)
+{
+    CUevent event = NULL;
+
+    if (cuda.pcuEventCreate(&event, CU_EVENT_DISABLE_TIMING) != CUDA_SUCCESS)
+        event = NULL;
+    else if (cuda.pcuEventRecord(event, stream) != CUDA_SUCCESS)
+        cuda.pcuEventSynchronize(event);
+
+    block->event = event;
+
+    if (!append_block(&pending_blocks, &pending_blocks_count, block))
+    {
+        if (block->event) cuda.pcuEventSynchronize(block->event);
+        free_block(block);
+    }
+}
+
+static struct compact_entry *find_entry(CUdeviceptr buffer)
+{
+    for (size_t i = 0; i < compacted_count; i++)
+    {
+        if (compacted[i].buffer == buffer) return &compacted[i];
+    }
+
+    return NULL;
+}
+
+static void remove_entry(struct compact_entry *entry, CUstream stream)
+{
+    live_size -= entry->size;
+    live_compacted -= entry->block.size;
+    pool_release(&entry->block, stream);
+    *entry = compacted[--compacted_count];
+}
+
+// any new build into a buffer replaces the compacted copy of its previous contents
+
+void accel_compaction_begin(struct accel_compaction *compaction, OptixDeviceContext context, CUstream stream, const void *accelOptions,
+                            CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, const void **emittedProperties, unsigned int *numEmittedProperties)
+{
+    const struct accel_build_options *options = accelOptions;
+    const struct accel_emit_desc *emitted = *emittedProperties;
+    struct compact_entry *entry;
+    struct accel_emit_desc *props;
+    BOOL updated = FALSE;
+
+    memset(compaction, 0, sizeof(*compaction));
+
+    if (!accel_compaction_enabled() || !options) return;
+
+    if (!lock()) return;
+
+    if ((entry = find_entry(outputBuffer)))
+    {
+        remove_entry(entry, stream);
+        updated = TRUE;
+    }
+
+    if (!(options->buildFlags & OPTIX_BUILD_FLAG_ALLOW_COMPACTION) || options->operation != OPTIX_BUILD_OPERATION_BUILD) goto done;
+
+    // the application compacts on its own
+
+    for (unsigned int i = 0; i < *numEmittedProperties; i++)
+    {
+        if (emitted && emitted[i].type == OPTIX_PROPERTY_TYPE_COMPACTED_SIZE) goto done;
+    }
+
+    if (!(props = malloc((*numEmittedProperties + 1) * sizeof(struct accel_emit_desc))) ||
+        !take_slot(&compaction->slab, &compaction->slot))
+    {
+        free(props);
+        failed++;
+        goto done;
+    }
+
+    if (*numEmittedProperties) memcpy(props, emitted, *numEmittedProperties * sizeof(struct accel_emit_desc));
+    props[*numEmittedProperties].result = slabs[compaction->slab].device + compaction->slot * sizeof(uint64_t);
+    props[*numEmittedProperties].type = OPTIX_PROPERTY_TYPE_COMPACTED_SIZE;
+
+    compaction->active = TRUE;
+    compaction->context = context;
+    compaction->stream = stream;
+    compaction->outputBuffer = outputBuffer;
+    compaction->outputBufferSizeInBytes = outputBufferSizeInBytes;
+    compaction->emitted = props;
+
+    *emittedProperties = props;
+    (*numEmittedProperties)++;
+
+done:
+    unlock();
+
+    if (updated) stats_update();
+}
+
+// copies the compacted size back behind the build, waits for that copy only and takes a block
+// of the pool for it, the caller compacts into compaction->block when this returns TRUE
+
+BOOL accel_compaction_prepare(struct accel_compaction *compaction, OptixResult result)
+{
+    uint64_t *host, size = 0;
+    CUdeviceptr device;
+    CUevent event = NULL;
+    BOOL queued = FALSE, copied = FALSE, ret = FALSE;
+
+    if (!compaction->active) return FALSE;
+
+    free(compaction->emitted);
+    compaction->emitted = NULL;
+    compaction->active = FALSE;
+
+    if (!lock()) return FALSE;
+
+    host = slabs[compaction->slab].host + compaction->slot;
+    device = slabs[compaction->slab].device + compaction->slot * sizeof(uint64_t);
+
+    unlock();
+
+    if (result == OPTIX_SUCCESS)
+    {
+        queued = cuda.pcuMemcpyDtoHAsync(host, device, sizeof(uint64_t), compaction->stream) == CUDA_SUCCESS;
+        copied = queued && cuda.pcuEventCreate(&event, CU_EVENT_DISABLE_TIMING) == CUDA_SUCCESS &&
+                 cuda.pcuEventRecord(event, compaction->stream) == CUDA_SUCCESS && cuda.pcuEventSynchronize(event) == CUDA_SUCCESS;
+    }
+
+    if (event) cuda.pcuEventDestroy(event);
+    if (copied) size = *host;
+
+    if (!lock()) return FALSE;
+
+    // a copy that may still be queued keeps its slot rather than have it overwritten under it
+
+    if (!queued || copied) give_slot(compaction->slab, compaction->slot);
+
+    if (result == OPTIX_SUCCESS)
+    {
+        if (!size)
+            failed++;
+        else if (size >= compaction->outputBufferSizeInBytes || !(ret = pool_alloc(size, &compaction->block)))
+            skipped++;
+    }
+
+    unlock();
+
+    return compaction->active = ret;
+}
+
+// hands the compacted handle to the application, the block goes back to the pool on failure
+
+void accel_compaction_end(struct accel_compaction *compaction, OptixResult result, OptixTraversableHandle compactedHandle, OptixTraversableHandle *outputHandle)
+{
+    struct compact_entry entry = { compaction->outputBuffer, compaction->context, compaction->outputBufferSizeInBytes, compaction->block };
+    struct compact_entry *new_compacted;
+
+    if (!compaction->active || !lock()) return;
+
+    if (result != OPTIX_SUCCESS)
+    {
+        WARN("Failed to compact %p: %d\n", compaction->outputBuffer, result);
+        pool_release(&entry.block, compaction->stream);
+        failed++;
+    }
+    else if (!(new_compacted = reallocarray(compacted, compacted_count + 1, sizeof(struct compact_entry))))
+    {
+        ERR("Failed to reallocate compacted structures\n");
+        pool_release(&entry.block, compaction->stream);
+        failed++;
+    }
+    else
+    {
+        TRACE("Compacted %p (%zu bytes) to %p (%zu bytes), handle %#llx -> %#llx\n", compaction->outputBuffer, compaction->outputBufferSizeInBytes,
+              entry.block.ptr, entry.block.size, *outputHandle, compactedHandle);
+
+        compacted = new_compacted;
+        compacted[compacted_count++] = entry;
+        *outputHandle = compactedHandle;
+
+        compacted_total++;
+        live_size += entry.size;
+        live_compacted += entry.block.size;
+    }
+
+    unlock();
+
+    stats_update();
+}
+
+void accel_compaction_forget(CUdeviceptr buffer)
+{
+    struct compact_entry *entry;
+
+    if (!accel_compaction_enabled() || !lock()) return;
+
+    if ((entry = find_entry(buffer))) remove_entry(entry, NULL);
+
+    unlock();
+}
+
+void accel_compaction_context_destroy(OptixDeviceContext context)
+{
+    if (!accel_compaction_enabled() || !lock()) return;
+
+    for (size_t i = 0; i < compacted_count;)
+    {
+        if (compacted[i].context == context)
+            remove_entry(&compacted[i], NULL);
+        else
+            i++;
+    }
+
+    unlock();
+}
+
+void accel_compaction_stats(FILE *file)
+{
+    if (!compaction_enabled || !lock()) return;
+
+    fprintf(file, "\n[accel compaction]\ncompacted %lu, skipped %lu, failed %lu\n", compacted_total, skipped, failed);
+    fprintf(file, "live %zu, %zu bytes compacted to %zu bytes, pool %zu bytes, high-water %zu bytes\n",
+            compacted_count, live_size, live_compacted, pool_allocated, pool_high);
+
+    unlock();
+}
+
+void accel_compaction_close(void)
+{
+    if (!compaction_enabled || !lock()) return;
+
+    WARN("Compacted %lu acceleration structures, %zu live ones take %zu instead of %zu bytes; %lu skipped, %lu failed, pool high-water mark %zu bytes\n",
+         compacted_total, compacted_count, live_compacted, live_size, skipped, failed, pool_high);
+
+    // the CUDA contexts may already be gone at process exit, leave the device memory and events to the driver
+
+    free(slabs);
+    free(compacted);
+    free(free_blocks);
+    free(pending_blocks);
+    slabs = NULL;
+    compacted = NULL;
+    free_blocks = NULL;
+    pending_blocks = NULL;
+    slabs_count = compacted_count = free_blocks_count = pending_blocks_count = 0;
+    live_size = live_compacted = pool_allocated = 0;
+
+    unlock();
+}
@@ -0,0 +1,568 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_cuda.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+
+#define OPTIX_TRAVERSABLE_TYPE_STATIC_TRANSFORM 0x21C1
+#define OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM 0x21C2
+#define OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM 0x21C3
+
+#define OPTIX_INSTANCE_SIZE 80
+#define OPTIX_INSTANCE_HANDLE_OFFSET 64
+
+#define INSTANCE_CHUNK 4096
+
+// pointed to instances closer together than this are read with one copy
+
+#define INSTANCE_SPAN_GAP 4096
+#define INSTANCE_SPAN_MAX (1 << 20)
+
+// a graph below a handle the relay didn't see being made has an unknown depth
+
+#define DEPTH_UNKNOWN ~0u
+
+// depth of the graph below every traversable handle, open addressing keyed on the handle
+
+struct graph_entry
+{
+    OptixTraversableHandle handle;
+    unsigned int depth;
+};
+
+// relocation info is an opaque blob the application may copy around, matched by content
+
+struct graph_relocation
+{
+    unsigned long long info[4];
+    unsigned int depth;
+};
+
+struct graph_pipeline
+{
+    OptixPipeline pipeline;
+    unsigned int stack_sizes[3];
+    unsigned int requested;
+    unsigned int applied;
+};
+
+static pthread_once_t graph_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t graph_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool graph_enabled;
+static _Bool graph_clamp;
+
+static struct graph_entry *entries = NULL;
+static size_t entries_capacity = 0;
+static size_t entries_count = 0;
+
+static struct graph_relocation *relocations = NULL;
+static size_t relocations_count = 0;
+
+static struct graph_pipeline *pipelines = NULL;
+static size_t pipelines_count = 0;
+
+// deepest graph built so far, graphs are never assumed to get shallower again
+
+static unsigned int graph_depth;
+static _Bool graph_unknown;
+static LONG clamped;
+static LONG raised;
+
+static void graph_init(void)
+{
+    graph_clamp = profile_get_int("accel_graph_clamp", 0);
+    graph_enabled = graph_clamp || profile_get_int("accel_graph_tracking", 0);
+
+    if (!graph_enabled) return;
+
+    if (!cuda_available())
+    {
+        ERR("Traversable graph tracking needs libcuda.so.1, disabled\n");
+        graph_enabled = graph_clamp = FALSE;
+        return;
+    }
+
+    WARN("Traversable graph tracking enabled%s\n", graph_clamp ? ", clamping maxTraversableGraphDepth" : "");
+}
+
+_Bool accel_graph_enabled(void)
+{
+    pthread_once(&graph_once, graph_init);
+
+    return graph_enabled;
+}
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&graph_lock)) return TRUE;
+
+    ERR("Failed to acquire traversable graph lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&graph_lock))
+        ERR("Failed to release traversable graph lock\n");
+}
+
+static size_t hash_handle(OptixTraversableHandle handle)
+{
+    uint64_t hash = handle * 0x9e3779b97f4a7c15ull;
+
+    return hash ^ (hash >> 32);
+}
+
+static struct graph_entry *lookup_entry(OptixTraversableHandle handle, BOOL create)
+{
+    if (entries_capacity)
+    {
+        size_t mask = entries_capacity - 1;
+
+        for (size_t i = hash_handle(handle) & mask;; i = (i + 1) & mask)
+        {
+            if (entries[i].handle == handle) return &entries[i];
+            if (!entries[i].handle) break;
+        }
+    }
+
+    if (!create) return NULL;
+
+    if ((entries_count + 1) * 2 > entries_capacity)
+    {
+        size_t capacity = entries_capacity ? entries_capacity * 2 : 256;
+        struct graph_entry *new_entries = calloc(capacity, sizeof(struct graph_entry));
+
+        if (!new_entries)
+        {
+            ERR("Failed to allocate traversable graph entries\n");
+            return NULL;
+        }
+
+        for (size_t i = 0; i < entries_capacity; i++)
+        {
+            if (!entries[i].handle) continue;
+
+            size_t j = hash_handle(entries[i].handle) & (capacity - 1);
+
+            while (new_entries[j].handle) j = (j + 1) & (capacity - 1);
+            new_entries[j] = entries[i];
+        }
+
+        free(entries);
+        entries = new_entries;
+        entries_capacity = capacity;
+    }
+
+    size_t mask = entries_capacity - 1, i = hash_handle(handle) & mask;
+
+    while (entries[i].handle) i = (i + 1) & mask;
+
+    entries[i].handle = handle;
+    entries_count++;
+
+    return &entries[i];
+}
+
+static unsigned int handle_depth(OptixTraversableHandle handle)
+{
+    struct graph_entry *entry = lookup_entry(handle, FALSE);
+
+    return entry ? entry->depth : DEPTH_UNKNOWN;
+}
+
+static unsigned int child_depth(unsigned int depth)
+{
+    return depth == DEPTH_UNKNOWN ? DEPTH_UNKNOWN : depth + 1;
+}
+
+static void set_depth(OptixTraversableHandle handle, unsigned int depth, const char *what)
+{
+    struct graph_entry *entry;
+
+    if (!handle || !(entry = lookup_entry(handle, TRUE))) return;
+
+    entry->depth = depth;
+
+    if (depth == DEPTH_UNKNOWN)
+    {
+        if (!graph_unknown) WARN("Depth of %s %#llx is unknown, not clamping maxTraversableGraphDepth\n", what, handle);
+        graph_unknown = TRUE;
+    }
+    else if (depth > graph_depth)
+    {
+        TRACE("Traversable graph depth %u from %s %#llx\n", depth, what, handle);
+        graph_depth = depth;
+    }
+}
+
+// null instances are allowed and don't add to the depth
+
+static void instance_depth(unsigned int *depth, OptixTraversableHandle handle)
+{
+    if (handle && *depth != DEPTH_UNKNOWN) *depth = max(*depth, child_depth(handle_depth(handle)));
+}
+
+static int compare_pointers(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(const CUdeviceptr *)a, y = (uintptr_t)*(const CUdeviceptr *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// sorts the pointers and reads runs of nearby instances with one copy each, instance
+// pointers usually point into a few arrays
+
+static void pointed_instances_depth(unsigned int *depth, CUdeviceptr *pointers, unsigned int count, unsigned char *span)
+{
+    unsigned int i = 0, j;
+
+    qsort(pointers, count, sizeof(CUdeviceptr), compare_pointers);
+
+    while (i < count && !pointers[i]) i++;
+
+    for (; i < count && *depth != DEPTH_UNKNOWN; i = j)
+    {
+        uintptr_t start = (uintptr_t)pointers[i], end = start + OPTIX_INSTANCE_SIZE;
+
+        for (j = i + 1; j < count; j++)
+        {
+            uintptr_t next = (uintptr_t)pointers[j];
+
+            if (next > end + INSTANCE_SPAN_GAP || next + OPTIX_INSTANCE_SIZE - start > INSTANCE_SPAN_MAX) break;
+
+            end = max(end, next + OPTIX_INSTANCE_SIZE);
+        }
+
+        if (cuda.pcuMemcpyDtoH(span, pointers[i], end - start) != CUDA_SUCCESS)
+        {
+            *depth = DEPTH_UNKNOWN;
+            break;
+        }
+
+        for (unsigned int k = i; k < j; k++)
+        {
+            OptixTraversableHandle handle;
+
+            memcpy(&handle, span + ((uintptr_t)pointers[k] - start) + OPTIX_INSTANCE_HANDLE_OFFSET, sizeof(handle));
+            instance_depth(depth, handle);
+        }
+    }
+}
+
+static unsigned int instances_depth(int abi, const struct accel_build_input *input)
+{
+    const struct accel_instance_array *array = &input->instanceArray;
+    unsigned int stride = abi >= 68 && array->instanceStride ? array->instanceStride : OPTIX_INSTANCE_SIZE;
+    unsigned int depth = 1, count;
+    unsigned char *data, *span = NULL;
+
+    if (!array->numInstances) return depth;
+
+    if (!(data = malloc((size_t)INSTANCE_CHUNK * max(stride, sizeof(CUdeviceptr))))) return DEPTH_UNKNOWN;
+
+    if (input->type == OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS && !(span = malloc(INSTANCE_SPAN_MAX)))
+    {
+        free(data);
+        return DEPTH_UNKNOWN;
+    }
+
+    for (unsigned int i = 0; i < array->numInstances && depth != DEPTH_UNKNOWN; i += count)
+    {
+        count = min(array->numInstances - i, INSTANCE_CHUNK);
+
+        if (input->type == OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS)
+        {
+            if (cuda.pcuMemcpyDtoH(data, (char *)array->instances + (size_t)i * sizeof(CUdeviceptr), count * sizeof(CUdeviceptr)) != CUDA_SUCCESS)
+            {
+                depth = DEPTH_UNKNOWN;
+                break;
+            }
+
+            pointed_instances_depth(&depth, (CUdeviceptr *)data, count, span);
+        }
+        else
+        {
+            if (cuda.pcuMemcpyDtoH(data, (char *)array->instances + (size_t)i * stride, (size_t)(count - 1) * stride + OPTIX_INSTANCE_SIZE) != CUDA_SUCCESS)
+            {
+                depth = DEPTH_UNKNOWN;
+                break;
+            }
+
+            for (unsigned int j = 0; j < count; j++)
+            {
+                OptixTraversableHandle handle;
+
+                memcpy(&handle, data + (size_t)j * stride + OPTIX_INSTANCE_HANDLE_OFFSET, sizeof(handle));
+                instance_depth(&depth, handle);
+            }
+        }
+    }
+
+    free(span);
+    free(data);
+
+    return depth;
+}
+
+// instance acceleration structures are one level above the deepest graph they reference,
+// the instances are read back after the build so the stream has to be synchronized, the
+// calling thread waits for the build and everything queued before it
+
+void accel_graph_build(int abi, CUstream stream, OptixResult result, const void *buildInputs, unsigned int numBuildInputs, const OptixTraversableHandle *outputHandle)
+{
+    const struct accel_build_input *inputs = buildInputs;
+    unsigned int depth = 1;
+
+    if (!accel_graph_enabled() || result != OPTIX_SUCCESS || !outputHandle || !inputs) return;
+
+    if (numBuildInputs && (inputs[0].type == OPTIX_BUILD_INPUT_TYPE_INSTANCES || inputs[0].type == OPTIX_BUILD_INPUT_TYPE_INSTANCE_POINTERS))
+    {
+        if (cuda.pcuStreamSynchronize(stream) != CUDA_SUCCESS || !lock()) return;
+
+        // an instance build has exactly one build input
+
+        depth = instances_depth(abi, &inputs[0]);
+        set_depth(*outputHandle, depth, "instance acceleration structure");
+    }
+    else
+    {
+        if (!lock()) return;
+
+        set_depth(*outputHandle, depth, "geometry acceleration structure");
+    }
+
+    unlock();
+
+    stats_update();
+}
+
+void accel_graph_compact(OptixResult result, OptixTraversableHandle inputHandle, const OptixTraversableHandle *outputHandle)
+{
+    if (!accel_graph_enabled() || result != OPTIX_SUCCESS || !outputHandle || !lock()) return;
+
+    set_depth(*outputHandle, handle_depth(inputHandle), "compacted acceleration structure");
+
+    unlock();
+}
+
+// transforms have the handle of their child at the start
+
+void accel_graph_transform(OptixResult result, CUdeviceptr pointer, int traversableType, const OptixTraversableHandle *traversableHandle)
+{
+    OptixTraversableHandle child = 0;
+    BOOL known = FALSE;
+
+    if (!accel_graph_enabled() || result != OPTIX_SUCCESS || !traversableHandle) return;
+
+    if (traversableType != OPTIX_TRAVERSABLE_TYPE_STATIC_TRANSFORM && traversableType != OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM &&
+        traversableType != OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM)
+        WARN("Unknown traversable type %#x\n", traversableType);
+    else if (!(known = cuda.pcuMemcpyDtoH(&child, pointer, sizeof(child)) == CUDA_SUCCESS))
+        ERR("Failed to read child of transform %p\n", pointer);
+
+    if (!lock()) return;
+
+    set_depth(*traversableHandle, known ? child_depth(handle_depth(child)) : DEPTH_UNKNOWN, "transform");
+
+    unlock();
+}
+
+void accel_graph_relocation_info(OptixResult result, OptixTraversableHandle handle, const void *info)
+{
+    struct graph_relocation *new_relocations;
+
+    if (!accel_graph_enabled() || result != OPTIX_SUCCESS || !info || !lock()) return;
+
+    for (size_t i = 0; i < relocations_count; i++)
+    {
+        if (memcmp(relocations[i].info, info, sizeof(relocations[i].info))) continue;
+
+        relocations[i].depth = handle_depth(handle);
+        unlock();
+        return;
+    }
+
+    if (!(new_relocations = reallocarray(relocations, relocations_count + 1, sizeof(struct graph_relocation))))
+    {
+        ERR("Failed to reallocate relocation infos\n");
+    }
+    else
+    {
+        relocations = new_relocations;
+        memcpy(relocations[relocations_count].info, info, sizeof(relocations[relocations_count].info));
+        relocations[relocations_count++].depth = handle_depth(handle);
+    }
+
+    unlock();
+}
+
+void accel_graph_relocate(OptixResult result, const void *info, const OptixTraversableHandle *targetHandle)
+{
+    unsigned int depth = DEPTH_UNKNOWN;
+
+    if (!accel_graph_enabled() || result != OPTIX_SUCCESS || !targetHandle || !lock()) return;
+
+    for (size_t i = 0; info && i < relocations_count; i++)
+    {
+        if (!memcmp(relocations[i].info, info, sizeof(relocations[i].info))) depth = relocations[i].depth;
+    }
+
+    set_depth(*targetHandle, depth, "relocated acceleration structure");
+
+    unlock();
+}
+
+static unsigned int clamp_depth(unsigned int requested)
+{
+    if (!graph_clamp || graph_unknown || !graph_depth) return requested;
+
+    return min(requested, graph_depth);
+}
+
+static struct graph_pipeline *lookup_pipeline(OptixPipeline pipeline, BOOL create)
+{
+    struct graph_pipeline *new_pipelines;
+
+    for (size_t i = 0; i < pipelines_count; i++)
+    {
+        if (pipelines[i].pipeline == pipeline) return &pipelines[i];
+    }
+
+    if (!create) return NULL;
+
+    if (!(new_pipelines = reallocarray(pipelines, pipelines_count + 1, sizeof(struct graph_pipeline))))
+    {
+        ERR("Failed to reallocate pipelines\n");
+        return NULL;
+    }
+
+    pipelines = new_pipelines;
+    memset(&pipelines[pipelines_count], 0, sizeof(struct graph_pipeline));
+    pipelines[pipelines_count].pipeline = pipeline;
+
+    return &pipelines[pipelines_count++];
+}
+
+// pipelines usually get their stack size before the scene is built, the depth is checked again at every launch
+
+void accel_graph_stack_size(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState,
+                            unsigned int continuationStackSize, unsigned int *maxTraversableGraphDepth)
+{
+    struct graph_pipeline *entry;
+
+    if (!accel_graph_enabled() || !graph_clamp || !lock()) return;
+
+    if ((entry = lookup_pipeline(pipeline, TRUE)))
+    {
+        entry->stack_sizes[0] = directCallableStackSizeFromTraversal;
+        entry->stack_sizes[1] = directCallableStackSizeFromState;
+        entry->stack_sizes[2] = continuationStackSize;
+        entry->requested = *maxTraversableGraphDepth;
+        entry->applied = clamp_depth(entry->requested);
+
+        if (entry->applied != entry->requested)
+        {
+            WARN("Clamping maxTraversableGraphDepth of pipeline %p from %u to %u\n", pipeline, entry->requested, entry->applied);
+            InterlockedIncrement(&clamped);
+        }
+
+        *maxTraversableGraphDepth = entry->applied;
+    }
+
+    unlock();
+}
+
+// returns TRUE with the arguments in `args` when the stack size of the pipeline has to be set again
+
+BOOL accel_graph_launch(OptixPipeline pipeline, unsigned int args[4])
+{
+    struct graph_pipeline *entry;
+    BOOL ret = FALSE;
+
+    if (!accel_graph_enabled() || !graph_clamp || !lock()) return FALSE;
+
+    if ((entry = lookup_pipeline(pipeline, FALSE)))
+    {
+        unsigned int depth = clamp_depth(entry->requested);
+
+        if (depth != entry->applied)
+        {
+            if (depth > entry->applied)
+            {
+                WARN("Traversable graph deepened to %u, raising maxTraversableGraphDepth of pipeline %p from %u\n", depth, pipeline, entry->applied);
+                InterlockedIncrement(&raised);
+            }
+            else
+            {
+                WARN("Clamping maxTraversableGraphDepth of pipeline %p from %u to %u\n", pipeline, entry->requested, depth);
+                InterlockedIncrement(&clamped);
+            }
+
+            memcpy(args, entry->stack_sizes, sizeof(entry->stack_sizes));
+            args[3] = entry->applied = depth;
+            ret = TRUE;
+        }
+    }
+
+    unlock();
+
+    return ret;
+}
+
+void accel_graph_pipeline_destroy(OptixPipeline pipeline)
+{
+    struct graph_pipeline *entry;
+
+    if (!accel_graph_enabled() || !graph_clamp || !lock()) return;
+
+    if ((entry = lookup_pipeline(pipeline, FALSE))) *entry = pipelines[--pipelines_count];
+
+    unlock();
+}
+
+void accel_graph_stats(FILE *file)
+{
+    if (!accel_graph_enabled() || !lock()) return;
+
+    fprintf(file, "\n[traversable graph]\n");
+
+    if (graph_unknown)
+        fprintf(file, "depth unknown, deepest known %u\n", graph_depth);
+    else
+        fprintf(file, "depth %u\n", graph_depth);
+
+    fprintf(file, "handles %zu, clamped %ld, raised %ld\n", entries_count, (long)clamped, (long)raised);
+
+    unlock();
+}
+
+void accel_graph_close(void)
+{
+    if (!graph_enabled) return;
+
+    if (graph_unknown)
+        WARN("Traversable graph depth unknown, deepest known %u\n", graph_depth);
+    else
+        WARN("Traversable graph depth %u, maxTraversableGraphDepth clamped %ld times, raised %ld times\n", graph_depth, (long)clamped, (long)raised);
+
+    free(entries);
+    free(relocations);
+    free(pipelines);
+    entries = NULL;
+    relocations = NULL;
+    pipelines = NULL;
+    entries_capacity = entries_count = relocations_count = pipelines_count = 0;
+}
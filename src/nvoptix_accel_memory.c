@@ -0,0 +1,446 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+
+enum memory_kind
+{
+    MEMORY_OUTPUT,
+    MEMORY_COMPACTED,
+    MEMORY_MICROMAP,
+    MEMORY_TEMP,
+    MEMORY_KIND_COUNT,
+};
+
+static const char *memory_kind_names[] = { "output", "compacted", "micromap", "temp" };
+static const char *query_kind_names[] = { "accel", "opacity micromap", "displacement micromap" };
+
+// device buffer last seen as build or compaction target, open addressing keyed on the address
+
+struct memory_buffer
+{
+    CUdeviceptr buffer;
+    OptixDeviceContext context;
+    enum memory_kind kind;
+    size_t size;
+    OptixTraversableHandle handle;
+};
+
+struct memory_query
+{
+    unsigned long count;
+    size_t output_high;
+    size_t temp_high;
+};
+
+struct memory_context
+{
+    OptixDeviceContext context;
+    _Bool destroyed;
+    _Bool over_budget;
+    size_t live[MEMORY_KIND_COUNT];
+    size_t high[MEMORY_KIND_COUNT];
+    size_t buffers[MEMORY_KIND_COUNT];
+    size_t total_high;
+    size_t temp_largest;
+    unsigned long builds;
+    unsigned long compactions;
+    unsigned long micromap_builds;
+    struct memory_query queries[ACCEL_MEMORY_QUERY_COUNT];
+};
+
+static pthread_once_t memory_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t memory_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool memory_enabled;
+static size_t memory_budget;
+
+static struct memory_buffer *buffers = NULL;
+static size_t buffers_capacity = 0;
+static size_t buffers_count = 0;
+
+static struct memory_context *contexts = NULL;
+static size_t contexts_count = 0;
+
+static void memory_init(void)
+{
+    memory_enabled = profile_get_int("accel_memory_accounting", 0) || stats_enabled();
+    memory_budget = (size_t)max(profile_get_int("accel_memory_budget_mb", 0), 0) << 20;
+
+    if (!memory_enabled) return;
+
+    if (memory_budget)
+        WARN("Accel memory accounting enabled, budget %zu MiB per context\n", memory_budget >> 20);
+    else
+        WARN("Accel memory accounting enabled\n");
+}
+
+_Bool accel_memory_enabled(void)
+{
+    pthread_once(&memory_once, memory_init);
+
+    return memory_enabled;
+}
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&memory_lock)) return TRUE;
+
+    ERR("Failed to acquire accel memory lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&memory_lock))
+        ERR("Failed to release accel memory lock\n");
+}
+
+static size_t hash_buffer(CUdeviceptr buffer)
+{
+    uint64_t hash = (uintptr_t)buffer * 0x9e3779b97f4a7c15ull;
+
+    return hash ^ (hash >> 32);
+}
+
+static struct memory_buffer *lookup_buffer(CUdeviceptr buffer, BOOL create)
+{
+    if (buffers_capacity)
+    {
+        size_t mask = buffers_capacity - 1;
+
+        for (size_t i = hash_buffer(buffer) & mask;; i = (i + 1) & mask)
+        {
+            if (buffers[i].buffer == buffer) return &buffers[i];
+            if (!buffers[i].buffer) break;
+        }
+    }
+
+    if (!create) return NULL;
+
+    if ((buffers_count + 1) * 2 > buffers_capacity)
+    {
+        size_t capacity = buffers_capacity ? buffers_capacity * 2 : 256;
+        struct memory_buffer *new_buffers = calloc(capacity, sizeof(struct memory_buffer));
+
+        if (!new_buffers)
+        {
+            ERR("Failed to allocate accel memory buffers\n");
+            return NULL;
+        }
+
+        for (size_t i = 0; i < buffers_capacity; i++)
+        {
+            if (!buffers[i].buffer) continue;
+
+            size_t j = hash_buffer(buffers[i].buffer) & (capacity - 1);
+
+            while (new_buffers[j].buffer) j = (j + 1) & (capacity - 1);
+            new_buffers[j] = buffers[i];
+        }
+
+        free(buffers);
+        buffers = new_buffers;
+        buffers_capacity = capacity;
+    }
+
+    size_t mask = buffers_capacity - 1, i = hash_buffer(buffer) & mask;
+
+    while (buffers[i].buffer) i = (i + 1) & mask;
+
+    memset(&buffers[i], 0, sizeof(buffers[i]));
+    buffers[i].buffer = buffer;
+    buffers_count++;
+
+    return &buffers[i];
+}
+
+// backward shift deletion keeps every probe sequence intact without tombstones
+
+static void remove_buffer(struct memory_buffer *entry)
+{
+    size_t mask = buffers_capacity - 1, i = entry - buffers, j = i;
+
+    for (;;)
+    {
+        j = (j + 1) & mask;
+
+        if (!buffers[j].buffer) break;
+
+        size_t home = hash_buffer(buffers[j].buffer) & mask;
+
+        if (((j - home) & mask) < ((j - i) & mask)) continue;
+
+        buffers[i] = buffers[j];
+        i = j;
+    }
+
+    memset(&buffers[i], 0, sizeof(buffers[i]));
+    buffers_count--;
+}
+
+// destroyed contexts are kept for the report, a new context at the same address gets a new record
+
+static struct memory_context *lookup_context(OptixDeviceContext context)
+{
+    struct memory_context *new_contexts;
+
+    for (size_t i = contexts_count; i > 0; i--)
+    {
+        if (contexts[i - 1].context == context && !contexts[i - 1].destroyed) return &contexts[i - 1];
+    }
+
+    if (!(new_contexts = reallocarray(contexts, contexts_count + 1, sizeof(struct memory_context))))
+    {
+        ERR("Failed to reallocate accel memory contexts\n");
+        return NULL;
+    }
+
+    contexts = new_contexts;
+    memset(&contexts[contexts_count], 0, sizeof(struct memory_context));
+    contexts[contexts_count].context = context;
+
+    return &contexts[contexts_count++];
+}
+
+static size_t live_total(const struct memory_context *ctx)
+{
+    size_t total = 0;
+
+    for (int kind = 0; kind < MEMORY_KIND_COUNT; kind++) total += ctx->live[kind];
+
+    return total;
+}
+
+static void untrack(struct memory_buffer *entry)
+{
+    struct memory_context *ctx = lookup_context(entry->context);
+
+    if (ctx)
+    {
+        ctx->live[entry->kind] -= entry->size;
+        ctx->buffers[entry->kind]--;
+    }
+}
+
+// temp buffers are reused between builds, they count with the largest size they were used with
+
+static void track(OptixDeviceContext context, CUdeviceptr buffer, enum memory_kind kind, size_t size, OptixTraversableHandle handle)
+{
+    struct memory_context *ctx;
+    struct memory_buffer *entry;
+    size_t total;
+
+    if (!buffer || !(entry = lookup_buffer(buffer, TRUE))) return;
+
+    if (entry->context)
+    {
+        if (kind == MEMORY_TEMP && entry->kind == MEMORY_TEMP && entry->context == context) size = max(size, entry->size);
+        untrack(entry);
+    }
+
+    entry->context = context;
+    entry->kind = kind;
+    entry->size = size;
+    entry->handle = handle;
+
+    if (!(ctx = lookup_context(context))) return;
+
+    ctx->live[kind] += size;
+    ctx->buffers[kind]++;
+    ctx->high[kind] = max(ctx->high[kind], ctx->live[kind]);
+    ctx->total_high = max(ctx->total_high, total = live_total(ctx));
+
+    if (memory_budget && total > memory_budget && !ctx->over_budget)
+    {
+        WARN("Context %p is over its acceleration structure budget, %zu of %zu MiB\n", context, total >> 20, memory_budget >> 20);
+        ctx->over_budget = TRUE;
+    }
+    else if (total <= memory_budget)
+    {
+        ctx->over_budget = FALSE;
+    }
+}
+
+void accel_memory_query(OptixDeviceContext context, enum accel_memory_query kind, OptixResult result, const void *bufferSizes)
+{
+    const struct accel_buffer_sizes *sizes = bufferSizes;
+    struct memory_context *ctx;
+
+    if (!accel_memory_enabled() || result != OPTIX_SUCCESS || !sizes) return;
+
+    TRACE("Context %p %s sizes: output %zu, temp %zu\n", context, query_kind_names[kind], sizes->outputSizeInBytes, sizes->tempSizeInBytes);
+
+    if (!lock()) return;
+
+    if ((ctx = lookup_context(context)))
+    {
+        ctx->queries[kind].count++;
+        ctx->queries[kind].output_high = max(ctx->queries[kind].output_high, sizes->outputSizeInBytes);
+        ctx->queries[kind].temp_high = max(ctx->queries[kind].temp_high, sizes->tempSizeInBytes);
+    }
+
+    unlock();
+}
+
+void accel_memory_build(OptixDeviceContext context, OptixResult result, CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes,
+                        CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle handle)
+{
+    struct memory_context *ctx;
+
+    if (!accel_memory_enabled() || result != OPTIX_SUCCESS) return;
+
+    TRACE("Context %p built %p (%zu bytes, temp %p %zu bytes), handle %#llx\n", context, outputBuffer, outputBufferSizeInBytes,
+          tempBuffer, tempBufferSizeInBytes, handle);
+
+    if (!lock()) return;
+
+    track(context, tempBuffer, MEMORY_TEMP, tempBufferSizeInBytes, 0);
+    track(context, outputBuffer, MEMORY_OUTPUT, outputBufferSizeInBytes, handle);
+
+    if ((ctx = lookup_context(context)))
+    {
+        ctx->builds++;
+        ctx->temp_largest = max(ctx->temp_largest, tempBufferSizeInBytes);
+    }
+
+    unlock();
+
+    stats_update();
+}
+
+void accel_memory_compact(OptixDeviceContext context, OptixResult result, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes, OptixTraversableHandle handle)
+{
+    struct memory_context *ctx;
+
+    if (!accel_memory_enabled() || result != OPTIX_SUCCESS) return;
+
+    TRACE("Context %p compacted to %p (%zu bytes), handle %#llx\n", context, outputBuffer, outputBufferSizeInBytes, handle);
+
+    if (!lock()) return;
+
+    track(context, outputBuffer, MEMORY_COMPACTED, outputBufferSizeInBytes, handle);
+
+    if ((ctx = lookup_context(context))) ctx->compactions++;
+
+    unlock();
+
+    stats_update();
+}
+
+void accel_memory_micromap_build(OptixDeviceContext context, OptixResult result, const void *buffers)
+{
+    const struct accel_micromap_buffers *micromap = buffers;
+    struct memory_context *ctx;
+
+    if (!accel_memory_enabled() || result != OPTIX_SUCCESS || !micromap) return;
+
+    TRACE("Context %p built micromap %p (%zu bytes, temp %p %zu bytes)\n", context, micromap->output, micromap->outputSizeInBytes,
+          micromap->temp, micromap->tempSizeInBytes);
+
+    if (!lock()) return;
+
+    track(context, micromap->temp, MEMORY_TEMP, micromap->tempSizeInBytes, 0);
+    track(context, micromap->output, MEMORY_MICROMAP, micromap->outputSizeInBytes, 0);
+
+    if ((ctx = lookup_context(context)))
+    {
+        ctx->micromap_builds++;
+        ctx->temp_largest = max(ctx->temp_largest, micromap->tempSizeInBytes);
+    }
+
+    unlock();
+
+    stats_update();
+}
+
+void accel_memory_context_destroy(OptixDeviceContext context)
+{
+    struct memory_context *ctx;
+
+    if (!accel_memory_enabled() || !lock()) return;
+
+    for (size_t i = 0; i < buffers_capacity;)
+    {
+        // removal shifts a later entry into this slot, look at it again
+
+        if (buffers[i].buffer && buffers[i].context == context)
+        {
+            untrack(&buffers[i]);
+            remove_buffer(&buffers[i]);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    if ((ctx = lookup_context(context))) ctx->destroyed = TRUE;
+
+    unlock();
+
+    stats_update();
+}
+
+void accel_memory_stats(FILE *file)
+{
+    if (!accel_memory_enabled() || !lock()) return;
+
+    for (size_t i = 0; i < contexts_count; i++)
+    {
+        const struct memory_context *ctx = &contexts[i];
+
+        fprintf(file, "\n[accel memory, context %p%s]\n", ctx->context, ctx->destroyed ? ", destroyed" : "");
+
+        for (int kind = 0; kind < MEMORY_KIND_COUNT; kind++)
+        {
+            fprintf(file, "%-10s live %zu bytes in %zu buffers, high-water %zu bytes\n", memory_kind_names[kind],
+                    ctx->live[kind], ctx->buffers[kind], ctx->high[kind]);
+        }
+
+        fprintf(file, "%-10s live %zu bytes, high-water %zu bytes\n", "total", live_total(ctx), ctx->total_high);
+        fprintf(file, "builds %lu, compactions %lu, micromap builds %lu, largest temp %zu bytes\n",
+                ctx->builds, ctx->compactions, ctx->micromap_builds, ctx->temp_largest);
+
+        for (int kind = 0; kind < ACCEL_MEMORY_QUERY_COUNT; kind++)
+        {
+            if (!ctx->queries[kind].count) continue;
+
+            fprintf(file, "%s size queries %lu, largest output %zu bytes, largest temp %zu bytes\n", query_kind_names[kind],
+                    ctx->queries[kind].count, ctx->queries[kind].output_high, ctx->queries[kind].temp_high);
+        }
+    }
+
+    unlock();
+}
+
+void accel_memory_close(void)
+{
+    if (!memory_enabled) return;
+
+    for (size_t i = 0; i < contexts_count; i++)
+    {
+        const struct memory_context *ctx = &contexts[i];
+
+        WARN("Context %p acceleration memory high-water marks: output %zu, compacted %zu, micromap %zu, temp %zu, total %zu bytes; %lu builds, %lu compactions, %lu micromap builds\n",
+             ctx->context, ctx->high[MEMORY_OUTPUT], ctx->high[MEMORY_COMPACTED], ctx->high[MEMORY_MICROMAP], ctx->high[MEMORY_TEMP],
+             ctx->total_high, ctx->builds, ctx->compactions, ctx->micromap_builds);
+    }
+
+    free(buffers);
+    free(contexts);
+    buffers = NULL;
+    contexts = NULL;
+    buffers_capacity = buffers_count = contexts_count = 0;
+}
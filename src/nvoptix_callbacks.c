@@ -1,3 +1,5 @@
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
 #include "windef.h"
 #include "winbase.h"
 #include "wine/debug.h"
@@ -6,9 +8,15 @@ WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
 #include "nvoptix.h"
+#include "nvoptix_compile.h"
+#include "nvoptix_probe.h"
+#ifdef WINE_UNIX_LIB
+#include "nvoptix_unixlib.h"
+#endif
 
 pthread_rwlock_t callbacks_lock;
 struct callback_t *callbacks = NULL;
@@ -37,7 +45,9 @@ _Bool callbacks_enabled(void)
     return enabled;
 }
 
-void *wrap_callback(OptixLogCallback func, void *data)
+// func is NULL when only the relay listens, level is the one the application asked for
+
+void *wrap_callback(OptixLogCallback func, void *data, unsigned int level)
 {
     if (pthread_rwlock_wrlock(&callbacks_lock))
     {
@@ -64,6 +74,7 @@ void *wrap_callback(OptixLogCallback func, void *data)
 
     *(void**)&callback->func = func;
     callback->data = data;
+    callback->level = level;
 
     ptrdiff_t offset = callbacks_count++;
 
@@ -71,16 +82,88 @@ void *wrap_callback(OptixLogCallback func, void *data)
         ERR("(%p, %p): Failed to release writer lock\n", func, data);
 
     TRACE("(%p, %p) = %td\n", func, data, offset);
+    PROBE(wrap_callback, func, data, offset);
 
     return (void*)offset;
 }
 
+#ifdef WINE_UNIX_LIB
+
+// the application's callback is PE code, the Unix side of a unixlib build queues its messages.
+// The PE side takes the whole queue when the call that logged them returns, or the next call
+// if OptiX logged from a thread of its own.
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct log_message *log_head = NULL;
+static struct log_message **log_tail = &log_head;
+
+static void log_queue(void *func, unsigned int level, const char *tag, const char *message, void *data)
+{
+    size_t tag_size = strlen(tag) + 1, message_size = strlen(message) + 1;
+    struct log_message *entry = malloc(sizeof(*entry) + tag_size + message_size);
+
+    if (!entry)
+    {
+        ERR("(%p, %p): Failed to queue a log message\n", func, data);
+        return;
+    }
+
+    entry->next = NULL;
+    *(void**)&entry->func = func;
+    entry->data = data;
+    entry->level = level;
+    entry->tag = memcpy(entry + 1, tag, tag_size);
+    entry->message = memcpy((char *)(entry + 1) + tag_size, message, message_size);
+
+    pthread_mutex_lock(&log_lock);
+
+    __atomic_store_n(log_tail, entry, __ATOMIC_RELEASE);
+    log_tail = &entry->next;
+
+    pthread_mutex_unlock(&log_lock);
+}
+
+// what every Unix call returns, checked without the lock
+
+NTSTATUS log_status(void)
+{
+    return __atomic_load_n(&log_head, __ATOMIC_ACQUIRE) ? NVOPTIX_LOGS_PENDING : STATUS_SUCCESS;
+}
+
+NTSTATUS unixlib_log_drain(void *args)
+{
+    struct log_drain_params *params = args;
+
+    while (params->done)
+    {
+        struct log_message *next = params->done->next;
+
+        free(params->done);
+        params->done = next;
+    }
+
+    pthread_mutex_lock(&log_lock);
+
+    params->messages = log_head;
+    __atomic_store_n(&log_head, NULL, __ATOMIC_RELAXED);
+    log_tail = &log_head;
+
+    pthread_mutex_unlock(&log_lock);
+
+    return STATUS_SUCCESS;
+}
+
+#endif
+
 void log_callback(unsigned int level, const char *tag, const char *message, void *cbdata)
 {
     TRACE("(%u, %s, %p, %p)\n", level, tag, message, cbdata);
+    PROBE(log_callback, level, tag, message, cbdata);
 
     ptrdiff_t offset = (ptrdiff_t)cbdata;
 
+    if (compile_stats_enabled()) compile_log(level, tag, message);
+
     if (offset < 0 || offset >= callbacks_count)
     {
         ERR("Failed to find callback for offset = %td\n", offset);
@@ -97,9 +180,14 @@ void log_callback(unsigned int level, const char *tag, const char *message, void
 
     OptixLogCallback __attribute((ms_abi)) func = callback->func;
     void *data = callback->data;
+    unsigned int callback_level = callback->level;
 
     if (pthread_rwlock_unlock(&callbacks_lock))
         ERR("Failed to release reader lock for offset = %td\n", offset);
 
-    func(level, tag, message, data);
+#ifdef WINE_UNIX_LIB
+    if (func && level <= callback_level) log_queue((void*)func, level, tag, message, data);
+#else
+    if (func && level <= callback_level) func(level, tag, message, data);
+#endif
 }
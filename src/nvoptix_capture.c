@@ -0,0 +1,691 @@
+#include <dlfcn.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nvoptix.h"
+#include "nvoptix_capture.h"
+#include "nvoptix_manifest.h"
+#include "nvoptix_profile.h"
+
+// chunks are handed to the writer once they reach CAPTURE_CHUNK_SIZE, a record larger
+// than that gets a chunk of its own; a partial chunk is written after CAPTURE_FLUSH_MS
+
+#define CAPTURE_CHUNK_SIZE (1 << 20)
+#define CAPTURE_FLUSH_MS 1000
+#define CAPTURE_STRINGS 1024
+
+struct capture_chunk
+{
+    struct capture_chunk *next;
+    size_t size;
+    size_t capacity;
+    unsigned char *data;
+};
+
+struct capture_string
+{
+    const char *str;
+    uint32_t id;
+};
+
+static struct
+{
+    size_t (*pZSTD_compressBound)(size_t srcSize);
+    size_t (*pZSTD_compress)(void *dst, size_t dstCapacity, const void *src, size_t srcSize, int compressionLevel);
+    unsigned (*pZSTD_isError)(size_t code);
+} zstd;
+
+static pthread_once_t capture_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t capture_space = PTHREAD_COND_INITIALIZER;
+static _Bool capture;
+static int capture_fd = -1;
+static int compress_level;
+static size_t buffer_limit;
+static void *libzstd_handle = NULL;
+
+// the writer is a plain pthread without a Wine TEB, it must not log
+
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+static _Bool writer_stop;
+static _Bool writer_busy;
+static int write_error;
+
+static struct capture_chunk *current = NULL;
+static struct capture_chunk *queue_head = NULL;
+static struct capture_chunk **queue_tail = &queue_head;
+static size_t queued_bytes;
+
+static struct capture_string strings[CAPTURE_STRINGS];
+static uint32_t strings_count;
+
+static uint64_t *blobs = NULL;
+static size_t blobs_capacity;
+static size_t blobs_count;
+
+static uint32_t threads_count;
+static __thread uint32_t thread_id;
+
+static unsigned long events, blobs_deduplicated, stalls, chunks;
+static uint64_t raw_bytes, written_bytes;
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&capture_lock)) return TRUE;
+
+    ERR("Failed to acquire capture lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&capture_lock))
+        ERR("Failed to release capture lock\n");
+}
+
+static uint64_t hash_blob(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    // 0 marks a free slot of the blob set
+
+    return hash ? hash : 1;
+}
+
+static void deadline_after(struct timespec *deadline, unsigned int ms)
+{
+    clock_gettime(CLOCK_REALTIME, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (ms % 1000) * 1000000;
+    deadline->tv_sec += deadline->tv_nsec / 1000000000;
+    deadline->tv_nsec %= 1000000000;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static BOOL write_all(const void *data, size_t size)
+{
+    for (size_t written = 0; written < size;)
+    {
+        ssize_t ret = write(capture_fd, (const unsigned char *)data + written, size - written);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR) continue;
+            write_error = errno;
+            return FALSE;
+        }
+
+        written += ret;
+    }
+
+    return TRUE;
+}
+
+static void write_chunk(const struct capture_chunk *chunk)
+{
+    struct capture_chunk_header header = {0};
+    const void *payload = chunk->data;
+    void *compressed = NULL;
+
+    header.size = header.raw_size = chunk->size;
+
+    if (compress_level)
+    {
+        size_t bound = zstd.pZSTD_compressBound(chunk->size), ret;
+
+        if ((compressed = malloc(bound)) &&
+            !zstd.pZSTD_isError((ret = zstd.pZSTD_compress(compressed, bound, chunk->data, chunk->size, compress_level))))
+        {
+            header.flags |= NVOPTIX_CAPTURE_ZSTD;
+            header.size = ret;
+            payload = compressed;
+        }
+    }
+
+    if (write_all(&header, sizeof(header)) && write_all(payload, header.size))
+    {
+        chunks++;
+        raw_bytes += header.raw_size;
+        written_bytes += sizeof(header) + header.size;
+    }
+
+    free(compressed);
+}
+
+static void enqueue_current(void)
+{
+    if (!current || !current->size) return;
+
+    queued_bytes += current->size;
+    *queue_tail = current;
+    queue_tail = &current->next;
+    current = NULL;
+
+    pthread_cond_signal(&writer_cond);
+}
+
+static void *writer(void *arg)
+{
+    struct capture_chunk *chunk;
+    struct timespec deadline;
+
+    pthread_mutex_lock(&capture_lock);
+
+    for (;;)
+    {
+        if (!queue_head && !writer_stop)
+        {
+            deadline_after(&deadline, CAPTURE_FLUSH_MS);
+
+            if (pthread_cond_timedwait(&writer_cond, &capture_lock, &deadline) == ETIMEDOUT)
+                enqueue_current();
+
+            continue;
+        }
+
+        if (!(chunk = queue_head)) break;
+
+        if (!(queue_head = chunk->next)) queue_tail = &queue_head;
+
+        writer_busy = TRUE;
+        pthread_mutex_unlock(&capture_lock);
+        write_chunk(chunk);
+        pthread_mutex_lock(&capture_lock);
+        writer_busy = FALSE;
+
+        queued_bytes -= chunk->size;
+        pthread_cond_broadcast(&capture_space);
+
+        free(chunk->data);
+        free(chunk);
+    }
+
+    pthread_mutex_unlock(&capture_lock);
+
+    return NULL;
+}
+
+static void load_zstd(void)
+{
+    if (!(libzstd_handle = dlopen("libzstd.so.1", RTLD_NOW)))
+    {
+        ERR("Failed to load libzstd.so.1, capturing uncompressed: %s\n", dlerror());
+        compress_level = 0;
+        return;
+    }
+
+    #define LOAD_FUNCPTR(f) if (!(*(void **)(&zstd.p##f) = dlsym(libzstd_handle, #f))) { ERR("Can't find symbol %s.\n", #f); goto fail; }
+
+    LOAD_FUNCPTR(ZSTD_compressBound);
+    LOAD_FUNCPTR(ZSTD_compress);
+    LOAD_FUNCPTR(ZSTD_isError);
+
+    #undef LOAD_FUNCPTR
+
+    return;
+
+fail:
+    dlclose(libzstd_handle);
+    libzstd_handle = NULL;
+    compress_level = 0;
+}
+
+// `%p` in the path is replaced with the process id, so child processes get their own file
+
+static BOOL capture_open(const char *path)
+{
+    char expanded[4096];
+    size_t len = 0;
+
+    for (const char *p = path; *p && len < sizeof(expanded) - 1; p++)
+    {
+        if (p[0] == '%' && p[1] == 'p')
+        {
+            len += snprintf(expanded + len, sizeof(expanded) - len, "%d", (int)getpid());
+            len = min(len, sizeof(expanded) - 1);
+            p++;
+        }
+        else
+        {
+            expanded[len++] = *p;
+        }
+    }
+
+    expanded[len] = 0;
+
+    if ((capture_fd = open(expanded, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) == -1)
+    {
+        ERR("Failed to open capture file %s: %s\n", debugstr_a(expanded), strerror(errno));
+        return FALSE;
+    }
+
+    if (!write_all(NVOPTIX_CAPTURE_MAGIC, 8))
+    {
+        ERR("Failed to write capture header: %s\n", strerror(write_error));
+        close(capture_fd);
+        capture_fd = -1;
+        return FALSE;
+    }
+
+    WARN("Capturing OptiX calls to %s%s\n", debugstr_a(expanded), compress_level ? ", zstd compressed" : "");
+
+    return TRUE;
+}
+
+static void capture_init(void)
+{
+    const char *path = profile_get("capture_file");
+
+    if (!path || !*path) return;
+
+#ifdef NVOPTIX_HOT_THUNKS
+    ERR("Not capturing, nvoptix was built with hot_thunks, which leaves the hot calls out of captures\n");
+    return;
+#endif
+
+    buffer_limit = (size_t)max(profile_get_int("capture_buffer_mb", 64), 2) << 20;
+
+    if ((compress_level = profile_get_int("capture_compress", 0)) > 0) load_zstd();
+    else compress_level = 0;
+
+    if (!capture_open(path)) return;
+
+    if (pthread_create(&writer_thread, NULL, writer, NULL))
+    {
+        ERR("Failed to start capture writer\n");
+        close(capture_fd);
+        capture_fd = -1;
+        return;
+    }
+
+    capture = TRUE;
+}
+
+_Bool capture_enabled(void)
+{
+    pthread_once(&capture_once, capture_init);
+
+    return capture;
+}
+
+// blocks while the queued chunks use up the buffer, before a call appends any of its records
+// so the records of one call are never separated by those of another thread
+
+static void wait_space(size_t size)
+{
+    while (capture && queue_head && queued_bytes + (current ? current->size : 0) + size > buffer_limit)
+    {
+        stalls++;
+        pthread_cond_wait(&capture_space, &capture_lock);
+    }
+}
+
+static void *append(uint32_t kind, size_t size)
+{
+    struct capture_record_header header;
+    size_t needed = sizeof(header) + size;
+    void *record;
+
+    if (!current && !(current = calloc(1, sizeof(*current)))) return NULL;
+
+    if (current->size + needed > current->capacity)
+    {
+        size_t capacity = max(current->capacity ? current->capacity * 2 : CAPTURE_CHUNK_SIZE, current->size + needed);
+        unsigned char *new_data = realloc(current->data, capacity);
+
+        if (!new_data) return NULL;
+
+        current->data = new_data;
+        current->capacity = capacity;
+    }
+
+    if (!thread_id) thread_id = ++threads_count;
+
+    header.kind = kind;
+    header.thread = thread_id;
+    header.size = size;
+
+    memcpy(current->data + current->size, &header, sizeof(header));
+    record = current->data + current->size + sizeof(header);
+    current->size += needed;
+
+    return record;
+}
+
+static void finish_record(void)
+{
+    if (current && current->size >= CAPTURE_CHUNK_SIZE) enqueue_current();
+}
+
+static uint32_t string_id(const char *str)
+{
+    size_t i = ((uintptr_t)str >> 3) % CAPTURE_STRINGS, len = strlen(str);
+    unsigned char *record;
+    uint32_t id;
+
+    // names are string literals, their address identifies them
+
+    for (size_t probes = 0; probes < CAPTURE_STRINGS; probes++, i = (i + 1) % CAPTURE_STRINGS)
+    {
+        if (strings[i].str == str) return strings[i].id;
+        if (!strings[i].str) break;
+    }
+
+    if (!(record = append(CAPTURE_RECORD_STRING, sizeof(uint32_t) + len))) return 0;
+
+    // past CAPTURE_STRINGS names are sent again on every use
+
+    id = ++strings_count;
+
+    if (!strings[i].str)
+    {
+        strings[i].str = str;
+        strings[i].id = id;
+    }
+
+    memcpy(record, &id, sizeof(uint32_t));
+    memcpy(record + sizeof(uint32_t), str, len);
+
+    return id;
+}
+
+static BOOL add_blob(uint64_t hash)
+{
+    uint64_t *new_blobs;
+    size_t i;
+
+    if (blobs_count * 2 >= blobs_capacity)
+    {
+        size_t capacity = blobs_capacity ? blobs_capacity * 2 : 1024;
+
+        if (!(new_blobs = calloc(capacity, sizeof(uint64_t)))) return FALSE;
+
+        for (size_t j = 0; j < blobs_capacity; j++)
+        {
+            if (!blobs[j]) continue;
+            for (i = blobs[j] % capacity; new_blobs[i]; i = (i + 1) % capacity);
+            new_blobs[i] = blobs[j];
+        }
+
+        free(blobs);
+        blobs = new_blobs;
+        blobs_capacity = capacity;
+    }
+
+    for (i = hash % blobs_capacity; blobs[i]; i = (i + 1) % blobs_capacity)
+    {
+        if (blobs[i] == hash) return FALSE;
+    }
+
+    blobs[i] = hash;
+    blobs_count++;
+
+    return TRUE;
+}
+
+void capture_event(const char *function, const char *probe, const uint64_t *args, unsigned int count)
+{
+    uint64_t time = now_ns();
+    uint32_t function_id, probe_id;
+    unsigned char *record;
+
+    if (!lock()) return;
+
+    wait_space(count * sizeof(uint64_t));
+
+    if (capture)
+    {
+        function_id = string_id(function);
+        probe_id = string_id(probe);
+
+        if ((record = append(CAPTURE_RECORD_EVENT, sizeof(uint64_t) + 3 * sizeof(uint32_t) + count * sizeof(uint64_t))))
+        {
+            memcpy(record, &time, sizeof(uint64_t));
+            memcpy(record + 8, &function_id, sizeof(uint32_t));
+            memcpy(record + 12, &probe_id, sizeof(uint32_t));
+            memcpy(record + 16, &count, sizeof(uint32_t));
+            memcpy(record + 20, args, count * sizeof(uint64_t));
+            events++;
+        }
+
+        finish_record();
+    }
+
+    unlock();
+}
+
+void capture_data(uint32_t kind, unsigned int arg, const void *data, size_t size)
+{
+    unsigned char *record;
+    uint64_t hash, size64 = size;
+    uint32_t arg32 = arg;
+
+    if (!data || !capture_enabled()) return;
+
+    hash = hash_blob(data, size);
+
+    if (!lock()) return;
+
+    wait_space(size);
+
+    if (capture)
+    {
+        if (!add_blob(hash))
+        {
+            blobs_deduplicated++;
+        }
+        else if ((record = append(CAPTURE_RECORD_BLOB, sizeof(uint64_t) + size)))
+        {
+            memcpy(record, &hash, sizeof(uint64_t));
+            memcpy(record + sizeof(uint64_t), data, size);
+        }
+
+        if ((record = append(CAPTURE_RECORD_DATA, 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t))))
+        {
+            memcpy(record, &kind, sizeof(uint32_t));
+            memcpy(record + 4, &arg32, sizeof(uint32_t));
+            memcpy(record + 8, &hash, sizeof(uint64_t));
+            memcpy(record + 16, &size64, sizeof(uint64_t));
+        }
+
+        finish_record();
+    }
+
+    unlock();
+}
+
+void capture_manifest(unsigned int arg, uint32_t kind, int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const void *data, size_t dataSize)
+{
+    void *record;
+    size_t size;
+
+    if (!capture_enabled()) return;
+
+    if (!(record = manifest_encode(kind, abi, moduleCompileOptions, moduleCompileOptionsSize, pipelineCompileOptions, pipelineCompileOptionsSize, data, dataSize, &size)))
+    {
+        ERR("Failed to allocate capture manifest record\n");
+        return;
+    }
+
+    capture_data(CAPTURE_DATA_MANIFEST, arg, record, size);
+    free(record);
+}
+
+static size_t put_string(unsigned char *buf, const char *str)
+{
+    uint32_t len = str ? strlen(str) : NVOPTIX_MANIFEST_NULL;
+
+    if (buf) memcpy(buf, &len, sizeof(len));
+    if (buf && str) memcpy(buf + sizeof(len), str, len);
+
+    return sizeof(len) + (str ? len : 0);
+}
+
+static unsigned int program_group_entries(int kind)
+{
+    switch (kind)
+    {
+    case OPTIX_PROGRAM_GROUP_KIND_RAYGEN:
+    case OPTIX_PROGRAM_GROUP_KIND_MISS:
+    case OPTIX_PROGRAM_GROUP_KIND_EXCEPTION: return 1;
+    case OPTIX_PROGRAM_GROUP_KIND_CALLABLES: return 2;
+    case OPTIX_PROGRAM_GROUP_KIND_HITGROUP: return 3;
+    default: return 0;
+    }
+}
+
+// two passes, the first one only sizes the encoding
+
+static size_t encode_program_groups(unsigned char *buf, const struct capture_program_group_desc *descs, unsigned int count)
+{
+    size_t size = sizeof(uint32_t);
+
+    if (buf) memcpy(buf, &count, sizeof(uint32_t));
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        uint32_t header[3] = { descs[i].kind, descs[i].flags, program_group_entries(descs[i].kind) };
+
+        if (buf) memcpy(buf + size, header, sizeof(header));
+        size += sizeof(header);
+
+        for (unsigned int j = 0; j < header[2]; j++)
+        {
+            uint64_t module = (uintptr_t)descs[i].entries[j].module;
+
+            if (buf) memcpy(buf + size, &module, sizeof(module));
+            size += sizeof(module);
+            size += put_string(buf ? buf + size : NULL, descs[i].entries[j].entryFunctionName);
+        }
+    }
+
+    return size;
+}
+
+void capture_program_groups(unsigned int arg, const void *programDescriptions, unsigned int numProgramGroups)
+{
+    unsigned char *buf;
+    size_t size;
+
+    if (!programDescriptions || !capture_enabled()) return;
+
+    size = encode_program_groups(NULL, programDescriptions, numProgramGroups);
+
+    if (!(buf = malloc(size)))
+    {
+        ERR("Failed to allocate capture program group record\n");
+        return;
+    }
+
+    encode_program_groups(buf, programDescriptions, numProgramGroups);
+    capture_data(CAPTURE_DATA_PROGRAM_GROUPS, arg, buf, size);
+    free(buf);
+}
+
+// called on process exit instead of capture_close: other Wine threads are already gone and
+// may have died holding the lock, so it is only waited for briefly. The writer is a plain
+// pthread and still running, it is given time to drain the queue; whatever is left once it
+// has stopped is written from this thread.
+
+void capture_flush(void)
+{
+    struct capture_chunk *chunk;
+    struct timespec deadline;
+
+    if (!capture) return;
+
+    deadline_after(&deadline, CAPTURE_FLUSH_MS);
+
+    if (pthread_mutex_timedlock(&capture_lock, &deadline))
+    {
+        ERR("Capture lock held by an exited thread, the last records are lost\n");
+        return;
+    }
+
+    capture = FALSE;
+    enqueue_current();
+    writer_stop = TRUE;
+    pthread_cond_signal(&writer_cond);
+    pthread_cond_broadcast(&capture_space);
+
+    deadline_after(&deadline, CAPTURE_FLUSH_MS);
+
+    while ((queue_head || writer_busy) && pthread_cond_timedwait(&capture_space, &capture_lock, &deadline) != ETIMEDOUT);
+
+    if (!writer_busy)
+    {
+        while ((chunk = queue_head))
+        {
+            queue_head = chunk->next;
+            write_chunk(chunk);
+            free(chunk->data);
+            free(chunk);
+        }
+
+        queue_tail = &queue_head;
+        queued_bytes = 0;
+    }
+
+    pthread_mutex_unlock(&capture_lock);
+
+    if (write_error) ERR("Failed to write capture: %s\n", strerror(write_error));
+}
+
+void capture_close(void)
+{
+    if (!capture) return;
+
+    pthread_mutex_lock(&capture_lock);
+    capture = FALSE;
+    enqueue_current();
+    writer_stop = TRUE;
+    pthread_cond_signal(&writer_cond);
+    pthread_cond_broadcast(&capture_space);
+    pthread_mutex_unlock(&capture_lock);
+
+    pthread_join(writer_thread, NULL);
+
+    if (write_error) ERR("Failed to write capture: %s\n", strerror(write_error));
+
+    WARN("Captured %lu events in %lu chunks, %.1f MiB written for %.1f MiB of records, %zu blobs, %lu deduplicated, %lu stalls\n",
+         events, chunks, written_bytes / 1048576.0, raw_bytes / 1048576.0, blobs_count, blobs_deduplicated, stalls);
+
+    close(capture_fd);
+    capture_fd = -1;
+
+    if (libzstd_handle) dlclose(libzstd_handle);
+    libzstd_handle = NULL;
+
+    free(blobs);
+    blobs = NULL;
+    blobs_capacity = blobs_count = 0;
+}
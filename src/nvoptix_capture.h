@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// API capture, written by the relay and read by nvoptix-replay
+//
+// The file starts with NVOPTIX_CAPTURE_MAGIC followed by chunks. Each chunk is a
+// struct capture_chunk_header followed by `size` bytes, zstd compressed when
+// NVOPTIX_CAPTURE_ZSTD is set in `flags`, `raw_size` bytes once decompressed.
+// Decompressed chunks hold whole records, each a struct capture_record_header
+// followed by `size` bytes of payload:
+//
+//   STRING : u32 id, bytes                     function and probe names, sent once
+//   BLOB   : u64 hash, bytes                   content addressed, sent once per hash
+//   EVENT  : u64 time ns, u32 function, u32 probe, u32 count, count * u64 arguments
+//   DATA   : u32 kind, u32 argument, u64 hash, u64 size
+//
+// `function` and `probe` are STRING ids, eg. "optixLaunch_93" and "optixLaunch__entry".
+// An `__entry` EVENT carries the arguments the thunk's TRACE line prints, a `__return`
+// EVENT the result. The DATA records a thread writes between the two refer to the BLOB
+// with that hash, which was sent before them, and belong to the argument with that index:
+//
+//   INPUT          : what the argument pointed to on entry, raw structures of the ABI
+//   OUTPUT         : what the call wrote through the argument, only after success
+//   MANIFEST       : a module manifest record (see nvoptix_manifest.h) describing the
+//                    compile or link options and the module input
+//   PROGRAM_GROUPS : count * { u32 kind, u32 flags, u32 count,
+//                              count * { u64 module, string entryFunctionName } }
+//
+// Records of one thread are in call order. Nested host arrays of option structures and
+// build inputs, and the contents of device memory, are not captured. All values are
+// little endian, blob and string encodings are the manifest's.
+
+#define NVOPTIX_CAPTURE_MAGIC "NVOXCAP1"
+#define NVOPTIX_CAPTURE_ZSTD 0x1
+
+// OptixShaderBindingTable has the same layout in every ABI
+
+#define CAPTURE_SBT_SIZE 64
+
+// so has OptixProgramGroupDesc, its union holds up to three pairs of module and entry
+// function name
+
+#define OPTIX_PROGRAM_GROUP_KIND_RAYGEN 0x2421
+#define OPTIX_PROGRAM_GROUP_KIND_MISS 0x2422
+#define OPTIX_PROGRAM_GROUP_KIND_EXCEPTION 0x2423
+#define OPTIX_PROGRAM_GROUP_KIND_HITGROUP 0x2424
+#define OPTIX_PROGRAM_GROUP_KIND_CALLABLES 0x2425
+
+struct capture_program_group_desc
+{
+    int kind;
+    unsigned int flags;
+    struct
+    {
+        void *module;
+        const char *entryFunctionName;
+    } entries[3];
+};
+
+enum capture_record_kind
+{
+    CAPTURE_RECORD_STRING = 1,
+    CAPTURE_RECORD_BLOB = 2,
+    CAPTURE_RECORD_EVENT = 3,
+    CAPTURE_RECORD_DATA = 4,
+};
+
+enum capture_data_kind
+{
+    CAPTURE_DATA_INPUT = 1,
+    CAPTURE_DATA_OUTPUT = 2,
+    CAPTURE_DATA_MANIFEST = 3,
+    CAPTURE_DATA_PROGRAM_GROUPS = 4,
+};
+
+struct capture_chunk_header
+{
+    uint32_t flags;
+    uint32_t reserved;
+    uint64_t size;
+    uint64_t raw_size;
+};
+
+struct capture_record_header
+{
+    uint32_t kind;
+    uint32_t thread;
+    uint64_t size;
+};
+
+_Bool capture_enabled(void);
+void capture_event(const char *function, const char *probe, const uint64_t *args, unsigned int count);
+void capture_data(uint32_t kind, unsigned int arg, const void *data, size_t size);
+void capture_manifest(unsigned int arg, uint32_t kind, int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const void *data, size_t dataSize);
+void capture_program_groups(unsigned int arg, const void *programDescriptions, unsigned int numProgramGroups);
+void capture_flush(void);
+void capture_close(void);
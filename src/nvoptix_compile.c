@@ -0,0 +1,406 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "nvoptix.h"
+#include "nvoptix_compile.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+
+#define COMPILE_LINE_MAX 512
+
+struct compile_kind_stats
+{
+    unsigned long calls;
+    unsigned long failed;
+    unsigned long spilling;
+    double total_ms;
+    double max_ms;
+    unsigned int max_registers;
+    unsigned long long instructions;
+};
+
+struct compile_cache
+{
+    void *context;
+    unsigned long hits;
+    unsigned long misses;
+};
+
+// the context each pending OptixTask was created for, executed tasks are removed
+
+struct compile_task
+{
+    void *task;
+    void *context;
+};
+
+static const char *const kind_names[COMPILE_KIND_COUNT] =
+{
+    [COMPILE_MODULE] = "module",
+    [COMPILE_TASK] = "task",
+    [COMPILE_PROGRAM_GROUP] = "program group",
+    [COMPILE_PIPELINE] = "pipeline",
+};
+
+static pthread_once_t compile_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t compile_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool enabled;
+
+// messages of the log callback belong to the compile running on the same thread
+
+static __thread struct compile_stats *current;
+
+static struct compile_kind_stats kinds[COMPILE_KIND_COUNT];
+static struct compile_cache *caches = NULL;
+static size_t caches_count = 0;
+static struct compile_task *tasks = NULL;
+static size_t tasks_count = 0;
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&compile_lock)) return TRUE;
+
+    ERR("Failed to acquire compile statistics lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&compile_lock))
+        ERR("Failed to release compile statistics lock\n");
+}
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void compile_init(void)
+{
+    if ((enabled = profile_get_int("compile_stats", 0)))
+        WARN("Collecting compile statistics from OptiX log messages\n");
+}
+
+_Bool compile_stats_enabled(void)
+{
+    pthread_once(&compile_once, compile_init);
+
+    return enabled;
+}
+
+static const char *skip_space(const char *str)
+{
+    while (isspace((unsigned char)*str)) str++;
+
+    return str;
+}
+
+static BOOL starts_with(const char *str, const char *prefix)
+{
+    return !strncmp(str, prefix, strlen(prefix));
+}
+
+// one "<value> <key>" or "<key> : <value>" item, as in "Pipeline has 1 module(s), 3 entry function(s), ..."
+// and in the lines of the "Pipeline statistics" table
+
+static void parse_item(struct compile_stats *compile, const char *item)
+{
+    const char *key, *colon;
+    unsigned long value;
+    char *end;
+
+    item = skip_space(item);
+
+    if (isdigit((unsigned char)*item))
+    {
+        value = strtoul(item, &end, 10);
+        key = skip_space(end);
+    }
+    else if ((colon = strchr(item, ':')))
+    {
+        key = item;
+        value = strtoul(colon + 1, &end, 10);
+        if (end == colon + 1) return;
+    }
+    else
+    {
+        return;
+    }
+
+    if (starts_with(key, "instruction(s)")) compile->instructions += value;
+    else if (starts_with(key, "basic block(s)")) compile->basic_blocks += value;
+}
+
+static void parse_line(struct compile_stats *compile, char *line)
+{
+    unsigned int stack, stores, loads, registers;
+    const char *ptr;
+    char *item, *saveptr;
+
+    if (strstr(line, "Cache hit") || strstr(line, "cache hit")) compile->cache_hits++;
+    if (strstr(line, "Cache miss") || strstr(line, "cache miss")) compile->cache_misses++;
+
+    if ((ptr = strstr(line, "Function properties for ")))
+    {
+        ptr += strlen("Function properties for ");
+        snprintf(compile->function, sizeof(compile->function), "%.*s", (int)strcspn(ptr, " \t\r\n"), ptr);
+        return;
+    }
+
+    if ((ptr = strstr(line, "Used ")) && sscanf(ptr, "Used %u registers", &registers) == 1)
+        compile->registers = max(compile->registers, registers);
+
+    if (sscanf(skip_space(line), "%u bytes stack frame, %u bytes spill stores, %u bytes spill loads", &stack, &stores, &loads) == 3)
+    {
+        compile->stack_frame = max(compile->stack_frame, stack);
+
+        if (stores || loads)
+        {
+            compile->spill_stores += stores;
+            compile->spill_loads += loads;
+            compile->spilling_functions++;
+
+            WARN("%s %s spills %u bytes of stores and %u bytes of loads, %u bytes stack frame\n", kind_names[compile->kind],
+                 compile->function[0] ? compile->function : "function", stores, loads, stack);
+        }
+
+        return;
+    }
+
+    if (strstr(line, "instruction(s)") || strstr(line, "basic block(s)"))
+    {
+        if ((ptr = strstr(line, " has "))) line = (char *)ptr + strlen(" has ");
+
+        for (item = strtok_r(line, ",", &saveptr); item; item = strtok_r(NULL, ",", &saveptr)) parse_item(compile, item);
+    }
+}
+
+static void parse_text(struct compile_stats *compile, const char *text, size_t size)
+{
+    char line[COMPILE_LINE_MAX];
+
+    while (size)
+    {
+        size_t len = 0;
+
+        while (len < size && text[len] && text[len] != '\n') len++;
+
+        snprintf(line, sizeof(line), "%.*s", (int)min(len, sizeof(line) - 1), text);
+        parse_line(compile, line);
+
+        if (len < size && !text[len]) break;
+
+        text += min(len + 1, size);
+        size -= min(len + 1, size);
+    }
+}
+
+static void add_cache(void *context, unsigned int hits, unsigned int misses)
+{
+    struct compile_cache *new_caches;
+
+    for (size_t i = 0; i < caches_count; i++)
+    {
+        if (caches[i].context != context) continue;
+
+        caches[i].hits += hits;
+        caches[i].misses += misses;
+        return;
+    }
+
+    if (!(new_caches = reallocarray(caches, caches_count + 1, sizeof(struct compile_cache))))
+    {
+        ERR("Failed to reallocate compile cache statistics\n");
+        return;
+    }
+
+    caches = new_caches;
+    caches[caches_count].context = context;
+    caches[caches_count].hits = hits;
+    caches[caches_count++].misses = misses;
+}
+
+void compile_begin(struct compile_stats *compile, enum compile_kind kind, void *context, const char *logString, const size_t *logStringSize)
+{
+    if (!(compile->active = compile_stats_enabled())) return;
+
+    memset(compile, 0, sizeof(*compile));
+
+    compile->active = TRUE;
+    compile->kind = kind;
+    compile->context = context;
+    compile->logString = logString;
+    compile->logStringSize = logStringSize;
+    compile->logStringCapacity = logString && logStringSize ? *logStringSize : 0;
+    compile->start = monotonic_ns();
+
+    current = compile;
+}
+
+void compile_end(struct compile_stats *compile, OptixResult result)
+{
+    struct compile_kind_stats *stats;
+    double ms;
+
+    if (!compile->active) return;
+
+    stats = &kinds[compile->kind];
+    ms = (monotonic_ns() - compile->start) / 1e6;
+    current = NULL;
+
+    // the log string repeats what the callback already delivered, it is only read without one
+
+    if (!compile->messages && compile->logStringCapacity)
+        parse_text(compile, compile->logString, min(compile->logStringCapacity, *compile->logStringSize));
+
+    if (!lock()) return;
+
+    stats->calls++;
+    stats->total_ms += ms;
+    stats->max_ms = max(stats->max_ms, ms);
+    stats->max_registers = max(stats->max_registers, compile->registers);
+    stats->instructions += compile->instructions;
+
+    if (result != OPTIX_SUCCESS) stats->failed++;
+    if (compile->spilling_functions) stats->spilling++;
+
+    if (compile->cache_hits || compile->cache_misses)
+        add_cache(compile->context, compile->cache_hits, compile->cache_misses);
+
+    unlock();
+
+    TRACE("%s compile: %.3f ms, %u registers, %u bytes spilled, %u instructions, %u cache hits, %u misses\n", kind_names[compile->kind], ms,
+          compile->registers, compile->spill_stores + compile->spill_loads, compile->instructions, compile->cache_hits, compile->cache_misses);
+
+    stats_update();
+}
+
+void compile_task_add(void *task, void *context)
+{
+    struct compile_task *new_tasks;
+
+    if (!compile_stats_enabled() || !task || !lock()) return;
+
+    if ((new_tasks = reallocarray(tasks, tasks_count + 1, sizeof(struct compile_task))))
+    {
+        tasks = new_tasks;
+        tasks[tasks_count].task = task;
+        tasks[tasks_count++].context = context;
+    }
+    else
+    {
+        ERR("Failed to reallocate compile task contexts\n");
+    }
+
+    unlock();
+}
+
+void *compile_task_take(void *task)
+{
+    void *context = NULL;
+
+    if (!compile_stats_enabled() || !lock()) return NULL;
+
+    for (size_t i = 0; i < tasks_count; i++)
+    {
+        if (tasks[i].task != task) continue;
+
+        context = tasks[i].context;
+        tasks[i] = tasks[--tasks_count];
+        break;
+    }
+
+    unlock();
+
+    if (!context) WARN("Task %p of no known module, its cache messages count for no context\n", task);
+
+    return context;
+}
+
+void compile_log(unsigned int level, const char *tag, const char *message)
+{
+    struct compile_stats *compile = current, orphan;
+
+    if (!message) return;
+
+    // cache messages outside any compile, eg. of the disk cache being opened, count for no context
+
+    if (!compile)
+    {
+        memset(&orphan, 0, sizeof(orphan));
+        compile = &orphan;
+    }
+
+    compile->messages++;
+    parse_text(compile, message, strlen(message));
+
+    if (compile == &orphan && (orphan.cache_hits || orphan.cache_misses) && lock())
+    {
+        add_cache(NULL, orphan.cache_hits, orphan.cache_misses);
+        unlock();
+    }
+}
+
+void compile_stats(FILE *file)
+{
+    if (!enabled || !lock()) return;
+
+    fprintf(file, "\n[compile]\n");
+
+    for (unsigned int i = 0; i < COMPILE_KIND_COUNT; i++)
+    {
+        const struct compile_kind_stats *stats = &kinds[i];
+
+        if (!stats->calls) continue;
+
+        fprintf(file, "%s: count %lu, failed %lu, spilling %lu, mean %.3f ms, max %.3f ms, max registers %u, instructions %llu\n",
+                kind_names[i], stats->calls, stats->failed, stats->spilling, stats->total_ms / stats->calls, stats->max_ms,
+                stats->max_registers, stats->instructions);
+    }
+
+    for (size_t i = 0; i < caches_count; i++)
+        fprintf(file, "context %p: cache hits %lu, misses %lu\n", caches[i].context, caches[i].hits, caches[i].misses);
+
+    unlock();
+}
+
+void compile_close(void)
+{
+    if (!enabled) return;
+
+    for (unsigned int i = 0; i < COMPILE_KIND_COUNT; i++)
+    {
+        const struct compile_kind_stats *stats = &kinds[i];
+
+        if (!stats->calls) continue;
+
+        WARN("Compiled %lu %ss (%lu failed, %lu spilling) in %.3f ms, max %.3f ms, max %u registers\n", stats->calls, kind_names[i],
+             stats->failed, stats->spilling, stats->total_ms, stats->max_ms, stats->max_registers);
+    }
+
+    for (size_t i = 0; i < caches_count; i++)
+        WARN("Context %p: %lu disk cache hits, %lu misses\n", caches[i].context, caches[i].hits, caches[i].misses);
+
+    free(caches);
+    caches = NULL;
+    caches_count = 0;
+    free(tasks);
+    tasks = NULL;
+    tasks_count = 0;
+    memset(kinds, 0, sizeof(kinds));
+}
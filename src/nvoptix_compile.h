@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+// compile statistics (nvoptix_compile.c)
+//
+// With `compile_stats=1` the relay asks OptiX for log level 4 on every context, forwarding
+// only the messages the application asked for, and parses what OptiX reports during module
+// compiles, tasks, program group creation and pipeline links, through the log callback or,
+// when no message arrived that way (log callbacks disabled), the call's logString: register
+// use, spills, stack frames, pipeline statistics and disk cache hits and misses. Together with
+// the wall time of the call they are kept per kind of compile and the cache counts per
+// context, in the stats file and logged on unload. Every function that spills is logged when
+// it is compiled. Tasks count for the context of the module they were created for.
+
+enum compile_kind
+{
+    COMPILE_MODULE,
+    COMPILE_TASK,
+    COMPILE_PROGRAM_GROUP,
+    COMPILE_PIPELINE,
+    COMPILE_KIND_COUNT,
+};
+
+struct compile_stats
+{
+    _Bool active;
+    enum compile_kind kind;
+    void *context;
+    const char *logString;
+    size_t logStringCapacity;
+    const size_t *logStringSize;
+    unsigned long long start;
+    unsigned int messages;
+    unsigned int registers;
+    unsigned int spill_stores;
+    unsigned int spill_loads;
+    unsigned int stack_frame;
+    unsigned int spilling_functions;
+    unsigned int instructions;
+    unsigned int basic_blocks;
+    unsigned int cache_hits;
+    unsigned int cache_misses;
+    char function[64];
+};
+
+_Bool compile_stats_enabled(void);
+void compile_begin(struct compile_stats *compile, enum compile_kind kind, void *context, const char *logString, const size_t *logStringSize);
+void compile_end(struct compile_stats *compile, OptixResult result);
+void compile_task_add(void *task, void *context);
+void *compile_task_take(void *task);
+void compile_log(unsigned int level, const char *tag, const char *message);
+void compile_close(void);
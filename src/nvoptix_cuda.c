@@ -0,0 +1,66 @@
+#include <dlfcn.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_cuda.h"
+
+struct cuda_funcs cuda;
+
+static pthread_once_t cuda_once = PTHREAD_ONCE_INIT;
+static void *libcuda_handle = NULL;
+
+static void cuda_init(void)
+{
+    if (!(libcuda_handle = dlopen("libcuda.so.1", RTLD_NOW)))
+    {
+        ERR("Failed to load libcuda.so.1: %s\n", dlerror());
+        return;
+    }
+
+    #define LOAD_FUNCPTR(f, s) if (!(*(void **)(&cuda.p##f) = dlsym(libcuda_handle, s))) { ERR("Can't find symbol %s.\n", s); goto fail; }
+
+    LOAD_FUNCPTR(cuCtxGetCurrent, "cuCtxGetCurrent");
+    LOAD_FUNCPTR(cuStreamSynchronize, "cuStreamSynchronize");
+    LOAD_FUNCPTR(cuMemAlloc, "cuMemAlloc_v2");
+    LOAD_FUNCPTR(cuMemFree, "cuMemFree_v2");
+    LOAD_FUNCPTR(cuMemAllocHost, "cuMemAllocHost_v2");
+    LOAD_FUNCPTR(cuMemcpyDtoH, "cuMemcpyDtoH_v2");
+    LOAD_FUNCPTR(cuMemcpyDtoHAsync, "cuMemcpyDtoHAsync_v2");
+    LOAD_FUNCPTR(cuEventCreate, "cuEventCreate");
+    LOAD_FUNCPTR(cuEventDestroy, "cuEventDestroy_v2");
+    LOAD_FUNCPTR(cuEventRecord, "cuEventRecord");
+    LOAD_FUNCPTR(cuEventQuery, "cuEventQuery");
+    LOAD_FUNCPTR(cuEventSynchronize, "cuEventSynchronize");
+    LOAD_FUNCPTR(cuEventElapsedTime, "cuEventElapsedTime");
+
+    #undef LOAD_FUNCPTR
+
+    return;
+
+fail:
+    dlclose(libcuda_handle);
+    libcuda_handle = NULL;
+}
+
+_Bool cuda_available(void)
+{
+    pthread_once(&cuda_once, cuda_init);
+
+    return libcuda_handle != NULL;
+}
+
+void cuda_close(void)
+{
+    if (libcuda_handle)
+    {
+        dlclose(libcuda_handle);
+        libcuda_handle = NULL;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// the bits of the native CUDA driver API the relay uses itself, libcuda.so.1 is
+// already loaded by nvcuda so dlopen only hands out another reference to it
+
+typedef int CUresult;
+typedef struct CUevent_st *CUevent;
+
+#define CUDA_SUCCESS 0
+#define CUDA_ERROR_NOT_READY 600
+
+#define CU_EVENT_DEFAULT 0x0
+#define CU_EVENT_BLOCKING_SYNC 0x1
+#define CU_EVENT_DISABLE_TIMING 0x2
+
+struct cuda_funcs
+{
+    CUresult (*pcuCtxGetCurrent)(CUcontext *ctx);
+    CUresult (*pcuStreamSynchronize)(CUstream stream);
+    CUresult (*pcuMemAlloc)(CUdeviceptr *ptr, size_t size);
+    CUresult (*pcuMemFree)(CUdeviceptr ptr);
+    CUresult (*pcuMemAllocHost)(void **ptr, size_t size);
+    CUresult (*pcuMemcpyDtoH)(void *dst, CUdeviceptr src, size_t size);
+    CUresult (*pcuMemcpyDtoHAsync)(void *dst, CUdeviceptr src, size_t size, CUstream stream);
+    CUresult (*pcuEventCreate)(CUevent *event, unsigned int flags);
+    CUresult (*pcuEventDestroy)(CUevent event);
+    CUresult (*pcuEventRecord)(CUevent event, CUstream stream);
+    CUresult (*pcuEventQuery)(CUevent event);
+    CUresult (*pcuEventSynchronize)(CUevent event);
+    CUresult (*pcuEventElapsedTime)(float *ms, CUevent start, CUevent end);
+};
+
+extern struct cuda_funcs cuda;
+
+_Bool cuda_available(void);
+void cuda_close(void);
@@ -0,0 +1,1134 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "nvoptix.h"
+#include "nvoptix_denoiser.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+
+// every denoiser created while the pool is enabled, idle ones were destroyed by the application
+
+struct pooled_denoiser
+{
+    OptixDenoiser denoiser;
+    OptixDeviceContext context;
+    _Bool late_model;
+    int kind;
+    uint64_t options;
+    uint64_t model;
+    uint64_t create_ns;
+    uint64_t model_ns;
+    _Bool idle;
+    uint64_t released;
+    denoiser_destroy_func destroy;
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int pool_size;
+
+static struct pooled_denoiser *denoisers = NULL;
+static size_t denoisers_count = 0;
+static unsigned int idle_count;
+static uint64_t release_sequence;
+
+static unsigned long created;
+static unsigned long reused;
+static unsigned long models_skipped;
+static unsigned long evicted;
+static uint64_t saved_ns;
+
+static pthread_once_t setup_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t setup_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool setup_skip;
+
+static struct denoiser_setup *setups = NULL;
+static size_t setups_count = 0;
+
+static unsigned long setups_run;
+static unsigned long setups_skipped;
+
+// denoisers whose resources were sized for tiles
+
+struct tiled_denoiser
+{
+    OptixDenoiser denoiser;
+    OptixDeviceContext context;
+    unsigned int overlap;
+};
+
+#define LAYER_INPUT 0
+#define LAYER_PREVIOUS_OUTPUT 1
+#define LAYER_OUTPUT 2
+
+static pthread_once_t tiling_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t tiling_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int tile_size;
+
+static struct tiled_denoiser *tiled = NULL;
+static size_t tiled_count = 0;
+
+static unsigned long tiled_invokes;
+static unsigned long tiles_invoked;
+
+// model kind of every denoiser created while timing, ABIs before 47 set it later
+
+struct timed_denoiser
+{
+    OptixDenoiser denoiser;
+    OptixDeviceContext context;
+    int kind;
+};
+
+static pthread_once_t timing_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t timing_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool timing;
+
+static struct timed_denoiser *timed = NULL;
+static size_t timed_count = 0;
+
+// context of every live denoiser while setups, tiles or timings are tracked, a destroyed
+// context takes only its own denoisers' entries along
+
+struct denoiser_owner
+{
+    OptixDenoiser denoiser;
+    OptixDeviceContext context;
+};
+
+static pthread_mutex_t owners_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct denoiser_owner *owners = NULL;
+static size_t owners_count = 0;
+
+static void pool_init(void)
+{
+    pool_size = max(profile_get_int("denoiser_pool", 0), 0);
+
+    if (pool_size) WARN("Denoiser pool enabled, keeping up to %u idle denoisers\n", pool_size);
+}
+
+_Bool denoiser_pool_enabled(void)
+{
+    pthread_once(&pool_once, pool_init);
+
+    return pool_size != 0;
+}
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&pool_lock)) return TRUE;
+
+    ERR("Failed to acquire denoiser pool lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&pool_lock))
+        ERR("Failed to release denoiser pool lock\n");
+}
+
+static void timing_model(OptixDenoiser denoiser, OptixDeviceContext context, int kind);
+static void owner_add(OptixDenoiser denoiser, OptixDeviceContext context);
+static void owner_remove(OptixDenoiser denoiser);
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t hash_data(const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; bytes && i < size; i++) hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+    return hash;
+}
+
+static struct pooled_denoiser *find_denoiser(OptixDenoiser denoiser)
+{
+    for (size_t i = 0; i < denoisers_count; i++)
+    {
+        if (denoisers[i].denoiser == denoiser) return &denoisers[i];
+    }
+
+    return NULL;
+}
+
+static void destroy_denoiser(struct pooled_denoiser *entry)
+{
+    OptixResult result = entry->destroy(entry->denoiser);
+
+    if (result != OPTIX_SUCCESS) WARN("Failed to destroy pooled denoiser %p: %d\n", entry->denoiser, result);
+
+    idle_count--;
+    *entry = denoisers[--denoisers_count];
+}
+
+static void evict(void)
+{
+    while (idle_count > pool_size)
+    {
+        struct pooled_denoiser *oldest = NULL;
+
+        for (size_t i = 0; i < denoisers_count; i++)
+        {
+            if (denoisers[i].idle && (!oldest || denoisers[i].released < oldest->released)) oldest = &denoisers[i];
+        }
+
+        TRACE("Evicting denoiser %p\n", oldest->denoiser);
+
+        destroy_denoiser(oldest);
+        evicted++;
+    }
+}
+
+// hands out an idle denoiser with the same key, or starts timing the real creation
+
+BOOL denoiser_pool_acquire(struct denoiser_create *create, OptixDeviceContext context, int modelKind, const void *options, size_t optionsSize,
+                           const void *userData, size_t userDataSize, OptixDenoiser *returnHandle)
+{
+    struct pooled_denoiser *entry = NULL;
+
+    memset(create, 0, sizeof(*create));
+
+    create->context = context;
+    create->kind = modelKind;
+
+    if (!denoiser_pool_enabled() || !returnHandle) return FALSE;
+
+    create->options = options ? hash_data(options, optionsSize) : 0;
+    create->model = hash_data(userData, userDataSize);
+
+    if (!lock()) return FALSE;
+
+    for (size_t i = 0; i < denoisers_count && !entry; i++)
+    {
+        struct pooled_denoiser *candidate = &denoisers[i];
+
+        if (!candidate->idle || candidate->context != context || candidate->options != create->options) continue;
+
+        if (modelKind == DENOISER_MODEL_LATER ? candidate->late_model : (candidate->kind == modelKind && candidate->model == create->model))
+            entry = candidate;
+    }
+
+    if (entry)
+    {
+        TRACE("Reusing denoiser %p\n", entry->denoiser);
+
+        entry->idle = FALSE;
+        idle_count--;
+        reused++;
+        saved_ns += entry->create_ns;
+        *returnHandle = entry->denoiser;
+    }
+
+    unlock();
+
+    if (entry)
+    {
+        stats_update();
+        return TRUE;
+    }
+
+    create->active = TRUE;
+    create->start = monotonic_ns();
+
+    return FALSE;
+}
+
+void denoiser_pool_created(struct denoiser_create *create, OptixResult result, const OptixDenoiser *returnHandle)
+{
+    struct pooled_denoiser *new_denoisers;
+    uint64_t elapsed = monotonic_ns() - create->start;
+
+    if (result == OPTIX_SUCCESS && returnHandle)
+    {
+        owner_add(*returnHandle, create->context);
+        timing_model(*returnHandle, create->context, create->kind);
+    }
+
+    if (!create->active || result != OPTIX_SUCCESS || !lock()) return;
+
+    if (!(new_denoisers = reallocarray(denoisers, denoisers_count + 1, sizeof(struct pooled_denoiser))))
+    {
+        ERR("Failed to reallocate pooled denoisers\n");
+    }
+    else
+    {
+        struct pooled_denoiser *entry = &new_denoisers[denoisers_count++];
+
+        denoisers = new_denoisers;
+        memset(entry, 0, sizeof(*entry));
+        entry->denoiser = *returnHandle;
+        entry->context = create->context;
+        entry->late_model = create->kind == DENOISER_MODEL_LATER;
+        entry->kind = create->kind;
+        entry->options = create->options;
+        entry->model = create->model;
+        entry->create_ns = elapsed;
+        created++;
+
+        TRACE("Created denoiser %p in %.3f ms\n", entry->denoiser, elapsed / 1e6);
+    }
+
+    unlock();
+}
+
+// returns TRUE when the denoiser already has this model loaded
+
+BOOL denoiser_pool_set_model(struct denoiser_create *create, OptixDenoiser denoiser, int kind, const void *data, size_t sizeInBytes)
+{
+    struct pooled_denoiser *entry;
+    BOOL ret = FALSE;
+
+    memset(create, 0, sizeof(*create));
+
+    create->denoiser = denoiser;
+    create->kind = kind;
+
+    if (!denoiser_pool_enabled() || !lock()) return FALSE;
+
+    if ((entry = find_denoiser(denoiser)))
+    {
+        create->model = hash_data(data, sizeInBytes);
+
+        if (entry->kind == kind && entry->model == create->model)
+        {
+            TRACE("Denoiser %p already has model %d\n", denoiser, kind);
+
+            models_skipped++;
+            saved_ns += entry->model_ns;
+            ret = TRUE;
+        }
+        else
+        {
+            create->active = TRUE;
+            create->start = monotonic_ns();
+        }
+    }
+
+    unlock();
+
+    return ret;
+}
+
+void denoiser_pool_model_set(struct denoiser_create *create, OptixResult result)
+{
+    struct pooled_denoiser *entry;
+    uint64_t elapsed = monotonic_ns() - create->start;
+
+    if (result == OPTIX_SUCCESS) timing_model(create->denoiser, NULL, create->kind);
+
+    if (!create->active || !lock()) return;
+
+    if ((entry = find_denoiser(create->denoiser)))
+    {
+        // a failed load may have left the old model in any state
+
+        entry->kind = result == OPTIX_SUCCESS ? create->kind : DENOISER_MODEL_LATER;
+        entry->model = create->model;
+        entry->model_ns = elapsed;
+    }
+
+    unlock();
+}
+
+// returns TRUE when the pool keeps the denoiser instead of destroying it
+
+BOOL denoiser_pool_release(OptixDenoiser denoiser, denoiser_destroy_func destroy)
+{
+    struct pooled_denoiser *entry;
+    BOOL ret = FALSE;
+
+    if (!denoiser_pool_enabled() || !lock())
+    {
+        owner_remove(denoiser);
+        return FALSE;
+    }
+
+    if ((entry = find_denoiser(denoiser)) && !entry->idle)
+    {
+        entry->idle = TRUE;
+        entry->released = ++release_sequence;
+        entry->destroy = destroy;
+        idle_count++;
+
+        evict();
+        ret = TRUE;
+    }
+    else if (entry)
+    {
+        WARN("Denoiser %p destroyed twice\n", denoiser);
+    }
+
+    unlock();
+
+    if (!ret) owner_remove(denoiser);
+
+    return ret;
+}
+
+static BOOL owners_tracked(void)
+{
+    return denoiser_setup_skip_enabled() || denoiser_tiling_enabled() || denoiser_timing_enabled();
+}
+
+// a new denoiser at the address of a destroyed one takes over its entry
+
+static void owner_add(OptixDenoiser denoiser, OptixDeviceContext context)
+{
+    struct denoiser_owner *new_owners;
+    size_t i;
+
+    if (!owners_tracked() || pthread_mutex_lock(&owners_lock)) return;
+
+    for (i = 0; i < owners_count && owners[i].denoiser != denoiser; i++);
+
+    if (i < owners_count)
+    {
+        owners[i].context = context;
+    }
+    else if (!(new_owners = reallocarray(owners, owners_count + 1, sizeof(struct denoiser_owner))))
+    {
+        ERR("Failed to reallocate denoiser owners\n");
+    }
+    else
+    {
+        owners = new_owners;
+        owners[owners_count].denoiser = denoiser;
+        owners[owners_count++].context = context;
+    }
+
+    pthread_mutex_unlock(&owners_lock);
+}
+
+static void owner_remove(OptixDenoiser denoiser)
+{
+    if (!owners_tracked() || pthread_mutex_lock(&owners_lock)) return;
+
+    for (size_t i = 0; i < owners_count; i++)
+    {
+        if (owners[i].denoiser == denoiser)
+        {
+            owners[i] = owners[--owners_count];
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&owners_lock);
+}
+
+// NULL for denoisers created before tracking started, they go with any destroyed context
+
+static OptixDeviceContext owner_context(OptixDenoiser denoiser)
+{
+    OptixDeviceContext context = NULL;
+
+    if (pthread_mutex_lock(&owners_lock)) return NULL;
+
+    for (size_t i = 0; i < owners_count; i++)
+    {
+        if (owners[i].denoiser == denoiser) context = owners[i].context;
+    }
+
+    pthread_mutex_unlock(&owners_lock);
+
+    return context;
+}
+
+static BOOL owned_by(OptixDeviceContext owner, OptixDeviceContext context)
+{
+    return !owner || owner == context;
+}
+
+// the driver frees every denoiser of a destroyed context, nothing of it may be handed out again
+// and a new denoiser may get the address of an old one
+
+void denoiser_context_destroy(OptixDeviceContext context)
+{
+    if (denoiser_setup_skip_enabled() && !pthread_mutex_lock(&setup_lock))
+    {
+        for (size_t i = 0; i < setups_count;)
+        {
+            if (owned_by(setups[i].context, context))
+                setups[i] = setups[--setups_count];
+            else
+                i++;
+        }
+
+        pthread_mutex_unlock(&setup_lock);
+    }
+
+    if (denoiser_tiling_enabled() && !pthread_mutex_lock(&tiling_lock))
+    {
+        for (size_t i = 0; i < tiled_count;)
+        {
+            if (owned_by(tiled[i].context, context))
+                tiled[i] = tiled[--tiled_count];
+            else
+                i++;
+        }
+
+        pthread_mutex_unlock(&tiling_lock);
+    }
+
+    if (denoiser_timing_enabled() && !pthread_mutex_lock(&timing_lock))
+    {
+        for (size_t i = 0; i < timed_count;)
+        {
+            if (owned_by(timed[i].context, context))
+                timed[i] = timed[--timed_count];
+            else
+                i++;
+        }
+
+        pthread_mutex_unlock(&timing_lock);
+    }
+
+    if (owners_tracked() && !pthread_mutex_lock(&owners_lock))
+    {
+        for (size_t i = 0; i < owners_count;)
+        {
+            if (owners[i].context == context)
+                owners[i] = owners[--owners_count];
+            else
+                i++;
+        }
+
+        pthread_mutex_unlock(&owners_lock);
+    }
+
+    if (!denoiser_pool_enabled() || !lock()) return;
+
+    for (size_t i = 0; i < denoisers_count;)
+    {
+        if (denoisers[i].context != context)
+            i++;
+        else if (denoisers[i].idle)
+            destroy_denoiser(&denoisers[i]);
+        else
+            denoisers[i] = denoisers[--denoisers_count];
+    }
+
+    unlock();
+}
+
+static void setup_init(void)
+{
+    if ((setup_skip = profile_get_int("denoiser_setup_skip", 0)))
+        WARN("Skipping repeated identical denoiser setups\n");
+}
+
+_Bool denoiser_setup_skip_enabled(void)
+{
+    pthread_once(&setup_once, setup_init);
+
+    return setup_skip;
+}
+
+static struct denoiser_setup *find_setup(OptixDenoiser denoiser)
+{
+    for (size_t i = 0; i < setups_count; i++)
+    {
+        if (setups[i].denoiser == denoiser) return &setups[i];
+    }
+
+    return NULL;
+}
+
+static BOOL same_setup(const struct denoiser_setup *a, const struct denoiser_setup *b)
+{
+    return a->stream == b->stream && a->width == b->width && a->height == b->height && a->state == b->state &&
+           a->stateSizeInBytes == b->stateSizeInBytes && a->scratch == b->scratch && a->scratchSizeInBytes == b->scratchSizeInBytes;
+}
+
+static BOOL overlaps(CUdeviceptr a, size_t a_size, CUdeviceptr b, size_t b_size)
+{
+    return (uintptr_t)a < (uintptr_t)b + b_size && (uintptr_t)b < (uintptr_t)a + a_size;
+}
+
+// returns TRUE when the setup is identical to the last one of the denoiser and can be skipped
+
+BOOL denoiser_setup_begin(struct denoiser_setup *setup, OptixDenoiser denoiser, CUstream stream, unsigned int width, unsigned int height,
+                          CUdeviceptr state, size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    struct denoiser_setup *last;
+    BOOL ret = FALSE;
+
+    memset(setup, 0, sizeof(*setup));
+
+    if (!denoiser_setup_skip_enabled()) return FALSE;
+
+    setup->denoiser = denoiser;
+    setup->stream = stream;
+    setup->width = width;
+    setup->height = height;
+    setup->state = state;
+    setup->stateSizeInBytes = stateSizeInBytes;
+    setup->scratch = scratch;
+    setup->scratchSizeInBytes = scratchSizeInBytes;
+
+    if (pthread_mutex_lock(&setup_lock))
+    {
+        ERR("Failed to acquire denoiser setup lock\n");
+        return FALSE;
+    }
+
+    if ((last = find_setup(denoiser)) && same_setup(last, setup))
+    {
+        TRACE("Skipping repeated setup of denoiser %p\n", denoiser);
+        setups_skipped++;
+        ret = TRUE;
+    }
+    else
+    {
+        // the state is rewritten from here on, also for any denoiser sharing its memory
+
+        for (size_t i = 0; i < setups_count;)
+        {
+            if (setups[i].denoiser == denoiser || overlaps(setups[i].state, setups[i].stateSizeInBytes, state, stateSizeInBytes))
+                setups[i] = setups[--setups_count];
+            else
+                i++;
+        }
+
+        setup->active = TRUE;
+        setups_run++;
+    }
+
+    if (pthread_mutex_unlock(&setup_lock))
+        ERR("Failed to release denoiser setup lock\n");
+
+    return ret;
+}
+
+void denoiser_setup_end(struct denoiser_setup *setup, OptixResult result)
+{
+    struct denoiser_setup *new_setups;
+
+    if (!setup->active || result != OPTIX_SUCCESS) return;
+
+    setup->context = owner_context(setup->denoiser);
+
+    if (pthread_mutex_lock(&setup_lock))
+    {
+        ERR("Failed to acquire denoiser setup lock\n");
+        return;
+    }
+
+    if (!(new_setups = reallocarray(setups, setups_count + 1, sizeof(struct denoiser_setup))))
+    {
+        ERR("Failed to reallocate denoiser setups\n");
+    }
+    else
+    {
+        setups = new_setups;
+        setups[setups_count++] = *setup;
+    }
+
+    if (pthread_mutex_unlock(&setup_lock))
+        ERR("Failed to release denoiser setup lock\n");
+}
+
+void denoiser_setup_forget(OptixDenoiser denoiser)
+{
+    struct denoiser_setup *last;
+
+    if (!denoiser_setup_skip_enabled()) return;
+
+    if (pthread_mutex_lock(&setup_lock))
+    {
+        ERR("Failed to acquire denoiser setup lock\n");
+        return;
+    }
+
+    if ((last = find_setup(denoiser))) *last = setups[--setups_count];
+
+    if (pthread_mutex_unlock(&setup_lock))
+        ERR("Failed to release denoiser setup lock\n");
+}
+
+static void tiling_init(void)
+{
+    tile_size = max(profile_get_int("denoiser_tile_size", 0), 0);
+
+    if (tile_size) WARN("Tiled denoising enabled, tiles of %u pixels\n", tile_size);
+}
+
+_Bool denoiser_tiling_enabled(void)
+{
+    pthread_once(&tiling_once, tiling_init);
+
+    return tile_size != 0;
+}
+
+static BOOL tiling_lock_acquire(void)
+{
+    if (!pthread_mutex_lock(&tiling_lock)) return TRUE;
+
+    ERR("Failed to acquire denoiser tiling lock\n");
+    return FALSE;
+}
+
+static void tiling_lock_release(void)
+{
+    if (pthread_mutex_unlock(&tiling_lock))
+        ERR("Failed to release denoiser tiling lock\n");
+}
+
+static struct tiled_denoiser *find_tiled(OptixDenoiser denoiser)
+{
+    for (size_t i = 0; i < tiled_count; i++)
+    {
+        if (tiled[i].denoiser == denoiser) return &tiled[i];
+    }
+
+    return NULL;
+}
+
+// sizes the resources for a tile when the application asks for a larger image
+
+void denoiser_tiling_query(struct denoiser_resources *resources, OptixDenoiser denoiser, unsigned int *maximumWidth, unsigned int *maximumHeight)
+{
+    memset(resources, 0, sizeof(*resources));
+
+    if (!denoiser_tiling_enabled()) return;
+
+    if (*maximumWidth > tile_size || *maximumHeight > tile_size)
+    {
+        TRACE("Sizing denoiser %p for %ux%u tiles instead of %ux%u\n", denoiser, min(*maximumWidth, tile_size), min(*maximumHeight, tile_size),
+              *maximumWidth, *maximumHeight);
+
+        resources->active = TRUE;
+        resources->denoiser = denoiser;
+        *maximumWidth = min(*maximumWidth, tile_size);
+        *maximumHeight = min(*maximumHeight, tile_size);
+    }
+    else
+    {
+        denoiser_tiling_forget(denoiser);
+    }
+}
+
+void denoiser_tiling_queried(struct denoiser_resources *resources, OptixResult result, void *returnSizes)
+{
+    struct denoiser_sizes *sizes = returnSizes;
+    struct tiled_denoiser *entry, *new_tiled;
+    OptixDeviceContext context;
+
+    if (!resources->active || result != OPTIX_SUCCESS) return;
+
+    context = owner_context(resources->denoiser);
+
+    if (!tiling_lock_acquire()) return;
+
+    // every tile but the single one of a small image is invoked with overlap
+
+    sizes->withOverlapScratchSizeInBytes = max(sizes->withOverlapScratchSizeInBytes, sizes->withoutOverlapScratchSizeInBytes);
+    sizes->withoutOverlapScratchSizeInBytes = sizes->withOverlapScratchSizeInBytes;
+
+    if ((entry = find_tiled(resources->denoiser)))
+    {
+        entry->context = context;
+        entry->overlap = sizes->overlapWindowSizeInPixels;
+    }
+    else if (!(new_tiled = reallocarray(tiled, tiled_count + 1, sizeof(struct tiled_denoiser))))
+    {
+        ERR("Failed to reallocate tiled denoisers\n");
+    }
+    else
+    {
+        tiled = new_tiled;
+        entry = &tiled[tiled_count++];
+        memset(entry, 0, sizeof(*entry));
+        entry->denoiser = resources->denoiser;
+        entry->context = context;
+        entry->overlap = sizes->overlapWindowSizeInPixels;
+    }
+
+    tiling_lock_release();
+}
+
+// the setup covers a tile with its overlap on both sides
+
+void denoiser_tiling_setup(OptixDenoiser denoiser, unsigned int *width, unsigned int *height)
+{
+    struct tiled_denoiser *entry;
+
+    if (!denoiser_tiling_enabled() || !tiling_lock_acquire()) return;
+
+    if ((entry = find_tiled(denoiser)))
+    {
+        *width = min(*width, tile_size + 2 * entry->overlap);
+        *height = min(*height, tile_size + 2 * entry->overlap);
+    }
+
+    tiling_lock_release();
+}
+
+static unsigned int pixel_stride(const struct denoiser_image *image)
+{
+    if (image->pixelStrideInBytes) return image->pixelStrideInBytes;
+
+    switch (image->format)
+    {
+        case 0x2201: return 6;  // OPTIX_PIXEL_FORMAT_HALF3
+        case 0x2202: return 8;  // OPTIX_PIXEL_FORMAT_HALF4
+        case 0x2203: return 12; // OPTIX_PIXEL_FORMAT_FLOAT3
+        case 0x2204: return 16; // OPTIX_PIXEL_FORMAT_FLOAT4
+        case 0x2205: return 3;  // OPTIX_PIXEL_FORMAT_UCHAR3
+        case 0x2206: return 4;  // OPTIX_PIXEL_FORMAT_UCHAR4
+        case 0x2207: return 4;  // OPTIX_PIXEL_FORMAT_HALF2
+        case 0x2208: return 8;  // OPTIX_PIXEL_FORMAT_FLOAT2
+        case 0x220a: return 2;  // OPTIX_PIXEL_FORMAT_HALF1
+        case 0x220b: return 4;  // OPTIX_PIXEL_FORMAT_FLOAT1
+        default: return 0;
+    }
+}
+
+// internal guide layers have no documented layout and are not split
+
+static BOOL splittable(const struct denoiser_image *image, unsigned int width, unsigned int height)
+{
+    return !image->data || (image->format != 0x2209 && pixel_stride(image) && image->width == width && image->height == height);
+}
+
+static struct denoiser_image *layer_image(const void *layers, size_t layerSize, unsigned int layer, unsigned int image)
+{
+    return (struct denoiser_image *)((char *)layers + layer * layerSize) + image;
+}
+
+// returns TRUE when the invoke is split, denoiser_tiling_next then yields the tiles
+
+BOOL denoiser_tiling_begin(struct denoiser_tiling *tiling, OptixDenoiser denoiser, unsigned int inputOffsetX, unsigned int inputOffsetY,
+                           const void *inputs, unsigned int numInputs, const void *layers, size_t layerSize, unsigned int numLayers,
+                           const void *output)
+{
+    const struct denoiser_image *input = numLayers ? layer_image(layers, layerSize, 0, LAYER_INPUT) : inputs;
+    const struct denoiser_image *first_output = output ? output : numLayers ? layer_image(layers, layerSize, 0, LAYER_OUTPUT) : NULL;
+    struct tiled_denoiser *entry;
+    BOOL ret = TRUE;
+
+    memset(tiling, 0, sizeof(*tiling));
+
+    if (!inputs) numInputs = 0;
+
+    if (!denoiser_tiling_enabled() || !input || !first_output || inputOffsetX || inputOffsetY || !tiling_lock_acquire()) return FALSE;
+
+    if ((entry = find_tiled(denoiser)))
+    {
+        tiling->tile_width = tiling->tile_height = tile_size;
+        tiling->overlap = entry->overlap;
+    }
+
+    tiling_lock_release();
+
+    // images fitting a single tile with its overlap go through unchanged
+
+    if (!entry || (input->width <= tile_size + 2 * tiling->overlap && input->height <= tile_size + 2 * tiling->overlap)) return FALSE;
+
+    tiling->width = input->width;
+    tiling->height = input->height;
+    tiling->upscale_x = first_output->width / input->width;
+    tiling->upscale_y = first_output->height / input->height;
+
+    if (!tiling->upscale_x || !tiling->upscale_y || numInputs > DENOISER_TILING_INPUTS) ret = FALSE;
+
+    for (unsigned int i = 0; ret && i < numInputs; i++)
+        ret = splittable(&((const struct denoiser_image *)inputs)[i], tiling->width, tiling->height);
+
+    for (unsigned int i = 0; ret && i < numLayers; i++)
+    {
+        ret = splittable(layer_image(layers, layerSize, i, LAYER_INPUT), tiling->width, tiling->height) &&
+              splittable(layer_image(layers, layerSize, i, LAYER_PREVIOUS_OUTPUT), tiling->width, tiling->height) &&
+              splittable(layer_image(layers, layerSize, i, LAYER_OUTPUT), tiling->upscale_x * tiling->width, tiling->upscale_y * tiling->height);
+    }
+
+    if (ret && output)
+        ret = splittable(output, tiling->upscale_x * tiling->width, tiling->upscale_y * tiling->height);
+
+    if (ret && numLayers && !(tiling->layers = malloc(numLayers * layerSize)))
+    {
+        ERR("Failed to allocate tiled denoiser layers\n");
+        ret = FALSE;
+    }
+
+    if (!ret)
+    {
+        WARN("Denoiser %p invoked with %ux%u images that cannot be tiled\n", denoiser, input->width, input->height);
+        return FALSE;
+    }
+
+    TRACE("Tiling %ux%u invoke of denoiser %p, overlap %u\n", tiling->width, tiling->height, denoiser, tiling->overlap);
+
+    if (numInputs) memcpy(tiling->inputs, inputs, numInputs * sizeof(struct denoiser_image));
+    if (numLayers) memcpy(tiling->layers, layers, numLayers * layerSize);
+    if (output) tiling->output = *(const struct denoiser_image *)output;
+
+    tiling->active = TRUE;
+    tiling->input_source = inputs;
+    tiling->numInputs = numInputs;
+    tiling->layer_source = layers;
+    tiling->layerSize = layerSize;
+    tiling->numLayers = numLayers;
+    tiling->output_source = output;
+
+    return TRUE;
+}
+
+// same split as optixUtilDenoiserSplitImage, the first tile of a row or column has no leading overlap
+
+BOOL denoiser_tiling_next(struct denoiser_tiling *tiling, unsigned int *inputOffsetX, unsigned int *inputOffsetY)
+{
+    unsigned int input_width, input_height, offset_x, offset_y, copy_x, copy_y;
+
+    if (!tiling->active || tiling->y >= tiling->height) return FALSE;
+
+    // the last tile of a row or column is moved back to keep its full input size
+
+    input_width = min(tiling->tile_width + 2 * tiling->overlap, tiling->width);
+    input_height = min(tiling->tile_height + 2 * tiling->overlap, tiling->height);
+    offset_x = tiling->x ? max(tiling->overlap, input_width - min(input_width, tiling->width - tiling->x)) : 0;
+    offset_y = tiling->y ? max(tiling->overlap, input_height - min(input_height, tiling->height - tiling->y)) : 0;
+    copy_x = tiling->x ? min(tiling->tile_width, tiling->width - tiling->x) : min(tiling->width, tiling->tile_width + tiling->overlap);
+    copy_y = tiling->y ? min(tiling->tile_height, tiling->height - tiling->y) : min(tiling->height, tiling->tile_height + tiling->overlap);
+
+#define SPLIT_INPUT(tile, image) \
+    do { \
+        if (!(image)->data) break; \
+        (tile)->data = (image)->data + (uint64_t)(tiling->y - offset_y) * (image)->rowStrideInBytes + \
+                       (uint64_t)(tiling->x - offset_x) * pixel_stride(image); \
+        (tile)->width = input_width; \
+        (tile)->height = input_height; \
+    } while (0)
+
+#define SPLIT_OUTPUT(tile, image) \
+    do { \
+        if (!(image)->data) break; \
+        (tile)->data = (image)->data + (uint64_t)tiling->upscale_y * tiling->y * (image)->rowStrideInBytes + \
+                       (uint64_t)tiling->upscale_x * tiling->x * pixel_stride(image); \
+        (tile)->width = tiling->upscale_x * copy_x; \
+        (tile)->height = tiling->upscale_y * copy_y; \
+    } while (0)
+
+    for (unsigned int i = 0; i < tiling->numInputs; i++)
+        SPLIT_INPUT(&tiling->inputs[i], &tiling->input_source[i]);
+
+    for (unsigned int i = 0; i < tiling->numLayers; i++)
+    {
+        SPLIT_INPUT(layer_image(tiling->layers, tiling->layerSize, i, LAYER_INPUT), layer_image(tiling->layer_source, tiling->layerSize, i, LAYER_INPUT));
+        SPLIT_INPUT(layer_image(tiling->layers, tiling->layerSize, i, LAYER_PREVIOUS_OUTPUT),
+                    layer_image(tiling->layer_source, tiling->layerSize, i, LAYER_PREVIOUS_OUTPUT));
+        SPLIT_OUTPUT(layer_image(tiling->layers, tiling->layerSize, i, LAYER_OUTPUT), layer_image(tiling->layer_source, tiling->layerSize, i, LAYER_OUTPUT));
+    }
+
+    if (tiling->output_source) SPLIT_OUTPUT(&tiling->output, tiling->output_source);
+
+#undef SPLIT_INPUT
+#undef SPLIT_OUTPUT
+
+    *inputOffsetX = offset_x;
+    *inputOffsetY = offset_y;
+
+    tiling->x += tiling->x ? tiling->tile_width : tiling->tile_width + tiling->overlap;
+
+    if (tiling->x >= tiling->width)
+    {
+        tiling->x = 0;
+        tiling->y += tiling->y ? tiling->tile_height : tiling->tile_height + tiling->overlap;
+    }
+
+    tiling->count++;
+
+    return TRUE;
+}
+
+void denoiser_tiling_end(struct denoiser_tiling *tiling, OptixResult result)
+{
+    if (!tiling->active) return;
+
+    if (result != OPTIX_SUCCESS) WARN("Tile %u of denoiser invoke failed: %d\n", tiling->count, result);
+
+    free(tiling->layers);
+
+    if (!tiling_lock_acquire()) return;
+
+    tiled_invokes++;
+    tiles_invoked += tiling->count;
+
+    tiling_lock_release();
+}
+
+void denoiser_tiling_forget(OptixDenoiser denoiser)
+{
+    struct tiled_denoiser *entry;
+
+    if (!denoiser_tiling_enabled() || !tiling_lock_acquire()) return;
+
+    if ((entry = find_tiled(denoiser))) *entry = tiled[--tiled_count];
+
+    tiling_lock_release();
+}
+
+static void timing_init(void)
+{
+    if ((timing = profile_get_int("denoiser_timing", 0)))
+        WARN("Timing denoiser invokes on the GPU\n");
+}
+
+_Bool denoiser_timing_enabled(void)
+{
+    pthread_once(&timing_once, timing_init);
+
+    return timing;
+}
+
+// a context of NULL keeps the one the entry has, ABIs before 47 set the model later
+
+static void timing_model(OptixDenoiser denoiser, OptixDeviceContext context, int kind)
+{
+    struct timed_denoiser *new_timed;
+    size_t i;
+
+    if (!denoiser_timing_enabled()) return;
+
+    if (pthread_mutex_lock(&timing_lock))
+    {
+        ERR("Failed to acquire denoiser timing lock\n");
+        return;
+    }
+
+    // a pooled denoiser or a new one at the address of a destroyed one keeps its entry
+
+    for (i = 0; i < timed_count && timed[i].denoiser != denoiser; i++);
+
+    if (i < timed_count)
+    {
+        if (context) timed[i].context = context;
+        timed[i].kind = kind;
+    }
+    else if (!(new_timed = reallocarray(timed, timed_count + 1, sizeof(struct timed_denoiser))))
+    {
+        ERR("Failed to reallocate timed denoisers\n");
+    }
+    else
+    {
+        timed = new_timed;
+        timed[timed_count].denoiser = denoiser;
+        timed[timed_count].context = context;
+        timed[timed_count++].kind = kind;
+    }
+
+    if (pthread_mutex_unlock(&timing_lock))
+        ERR("Failed to release denoiser timing lock\n");
+}
+
+void denoiser_timing_begin(struct denoiser_timing *timing, const char *call, OptixDenoiser denoiser, CUstream stream, const void *image,
+                           unsigned int numLayers)
+{
+    const struct denoiser_image *input = image;
+    int kind = DENOISER_MODEL_LATER;
+    char model[16];
+
+    timing->gpu.active = FALSE;
+
+    if (!denoiser_timing_enabled() || !input) return;
+
+    if (!pthread_mutex_lock(&timing_lock))
+    {
+        for (size_t i = 0; i < timed_count; i++)
+        {
+            if (timed[i].denoiser == denoiser) kind = timed[i].kind;
+        }
+
+        pthread_mutex_unlock(&timing_lock);
+    }
+
+    if (kind == DENOISER_MODEL_USER)
+        snprintf(model, sizeof(model), "user");
+    else if (kind == DENOISER_MODEL_LATER)
+        snprintf(model, sizeof(model), "unset");
+    else
+        snprintf(model, sizeof(model), "%#x", kind);
+
+    snprintf(timing->bucket, sizeof(timing->bucket), "denoiser %s, model %s, %u layers, %ux%u", call, model, numLayers,
+             input->width, input->height);
+
+    gpu_timing_begin(&timing->gpu, stream);
+}
+
+void denoiser_timing_end(struct denoiser_timing *timing, OptixResult result)
+{
+    gpu_timing_end(&timing->gpu, result, timing->bucket);
+}
+
+void denoiser_stats(FILE *file)
+{
+    if (denoiser_tiling_enabled())
+        fprintf(file, "\n[denoiser tiling]\ninvokes %lu, tiles %lu\n", tiled_invokes, tiles_invoked);
+
+    if (denoiser_setup_skip_enabled())
+        fprintf(file, "\n[denoiser setup]\nrun %lu, skipped %lu\n", setups_run, setups_skipped);
+
+    if (!denoiser_pool_enabled() || !lock()) return;
+
+    fprintf(file, "\n[denoiser pool]\n");
+    fprintf(file, "denoisers %zu, idle %u, created %lu, reused %lu, models kept %lu, evicted %lu, saved %.3f ms\n",
+            denoisers_count, idle_count, created, reused, models_skipped, evicted, saved_ns / 1e6);
+
+    unlock();
+}
+
+void denoiser_close(void)
+{
+    if (tile_size)
+        WARN("Split %lu denoiser invokes into %lu tiles\n", tiled_invokes, tiles_invoked);
+
+    free(tiled);
+    tiled = NULL;
+    tiled_count = 0;
+
+    free(timed);
+    timed = NULL;
+    timed_count = 0;
+
+    free(owners);
+    owners = NULL;
+    owners_count = 0;
+
+    if (setup_skip)
+        WARN("Ran %lu denoiser setups, skipped %lu identical ones\n", setups_run, setups_skipped);
+
+    free(setups);
+    setups = NULL;
+    setups_count = 0;
+
+    if (!pool_size) return;
+
+    WARN("Created %lu denoisers, reused %lu, kept the model of %lu, evicted %lu, saved %.3f ms of creation time\n",
+         created, reused, models_skipped, evicted, saved_ns / 1e6);
+
+    // the CUDA context may already be gone at process exit, leave the denoisers to the driver
+
+    free(denoisers);
+    denoisers = NULL;
+    denoisers_count = idle_count = 0;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nvoptix_timing.h"
+
+// denoiser pool (nvoptix_denoiser.c)
+//
+// With `denoiser_pool` set to a count, destroyed denoisers are kept alive and handed out
+// again by the next create with the same context, model kind, options and user model.
+// ABIs before 47 load the model with optixDenoiserSetModel after creation, their pooled
+// denoisers are matched on the options and setting the model they already have is skipped.
+
+#define DENOISER_MODEL_LATER -1
+#define DENOISER_MODEL_USER -2
+
+typedef OptixResult (*denoiser_destroy_func)(OptixDenoiser handle);
+
+struct denoiser_create
+{
+    _Bool active;
+    OptixDenoiser denoiser;
+    OptixDeviceContext context;
+    int kind;
+    uint64_t options;
+    uint64_t model;
+    uint64_t start;
+};
+
+_Bool denoiser_pool_enabled(void);
+BOOL denoiser_pool_acquire(struct denoiser_create *create, OptixDeviceContext context, int modelKind, const void *options, size_t optionsSize,
+                           const void *userData, size_t userDataSize, OptixDenoiser *returnHandle);
+void denoiser_pool_created(struct denoiser_create *create, OptixResult result, const OptixDenoiser *returnHandle);
+BOOL denoiser_pool_set_model(struct denoiser_create *create, OptixDenoiser denoiser, int kind, const void *data, size_t sizeInBytes);
+void denoiser_pool_model_set(struct denoiser_create *create, OptixResult result);
+BOOL denoiser_pool_release(OptixDenoiser denoiser, denoiser_destroy_func destroy);
+void denoiser_context_destroy(OptixDeviceContext context);
+
+// setup elision
+//
+// With `denoiser_setup_skip=1` an optixDenoiserSetup with the same stream, size, state and
+// scratch buffers as the last successful one of that denoiser is skipped. Setups of other
+// denoisers overlapping the state buffer, setting the model and destroying the denoiser
+// make the next setup run again.
+
+struct denoiser_setup
+{
+    _Bool active;
+    OptixDenoiser denoiser;
+    OptixDeviceContext context;
+    CUstream stream;
+    unsigned int width;
+    unsigned int height;
+    CUdeviceptr state;
+    size_t stateSizeInBytes;
+    CUdeviceptr scratch;
+    size_t scratchSizeInBytes;
+};
+
+_Bool denoiser_setup_skip_enabled(void);
+BOOL denoiser_setup_begin(struct denoiser_setup *setup, OptixDenoiser denoiser, CUstream stream, unsigned int width, unsigned int height,
+                          CUdeviceptr state, size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes);
+void denoiser_setup_end(struct denoiser_setup *setup, OptixResult result);
+void denoiser_setup_forget(OptixDenoiser denoiser);
+
+// tiled denoising
+//
+// With `denoiser_tile_size` set to a size in pixels, memory resources queried for a larger
+// image are sized for a tile of that size instead, and invokes of such images are split into
+// overlapping tiles through the input offsets like optixUtilDenoiserInvokeTiled does. Images
+// and layers match the OptixImage2D_NN and OptixDenoiserLayer_NN duplicates of every ABI.
+
+#define DENOISER_TILING_INPUTS 8
+
+struct denoiser_image
+{
+    CUdeviceptr data;
+    unsigned int width;
+    unsigned int height;
+    unsigned int rowStrideInBytes;
+    unsigned int pixelStrideInBytes;
+    int format;
+};
+
+// common beginning of OptixDenoiserSizes, ABIs before 47 call the scratch sizes minimum and recommended
+
+struct denoiser_sizes
+{
+    size_t stateSizeInBytes;
+    size_t withOverlapScratchSizeInBytes;
+    size_t withoutOverlapScratchSizeInBytes;
+    unsigned int overlapWindowSizeInPixels;
+};
+
+struct denoiser_resources
+{
+    _Bool active;
+    OptixDenoiser denoiser;
+};
+
+struct denoiser_tiling
+{
+    _Bool active;
+    unsigned int tile_width;
+    unsigned int tile_height;
+    unsigned int overlap;
+    unsigned int width;
+    unsigned int height;
+    unsigned int upscale_x;
+    unsigned int upscale_y;
+    unsigned int x;
+    unsigned int y;
+    unsigned int count;
+    const struct denoiser_image *input_source;
+    unsigned int numInputs;
+    struct denoiser_image inputs[DENOISER_TILING_INPUTS];
+    const void *layer_source;
+    size_t layerSize;
+    unsigned int numLayers;
+    void *layers;
+    const struct denoiser_image *output_source;
+    struct denoiser_image output;
+};
+
+_Bool denoiser_tiling_enabled(void);
+void denoiser_tiling_query(struct denoiser_resources *resources, OptixDenoiser denoiser, unsigned int *maximumWidth, unsigned int *maximumHeight);
+void denoiser_tiling_queried(struct denoiser_resources *resources, OptixResult result, void *returnSizes);
+void denoiser_tiling_setup(OptixDenoiser denoiser, unsigned int *width, unsigned int *height);
+BOOL denoiser_tiling_begin(struct denoiser_tiling *tiling, OptixDenoiser denoiser, unsigned int inputOffsetX, unsigned int inputOffsetY,
+                           const void *inputs, unsigned int numInputs, const void *layers, size_t layerSize, unsigned int numLayers,
+                           const void *output);
+BOOL denoiser_tiling_next(struct denoiser_tiling *tiling, unsigned int *inputOffsetX, unsigned int *inputOffsetY);
+void denoiser_tiling_end(struct denoiser_tiling *tiling, OptixResult result);
+void denoiser_tiling_forget(OptixDenoiser denoiser);
+
+// GPU timing
+//
+// With `denoiser_timing=1` invokes, intensity and average color computations are timed on
+// the GPU and bucketed by call, model kind, layer count and input size.
+
+struct denoiser_timing
+{
+    struct gpu_timing gpu;
+    char bucket[96];
+};
+
+_Bool denoiser_timing_enabled(void);
+void denoiser_timing_begin(struct denoiser_timing *timing, const char *call, OptixDenoiser denoiser, CUstream stream, const void *image,
+                           unsigned int numLayers);
+void denoiser_timing_end(struct denoiser_timing *timing, OptixResult result);
+
+void denoiser_close(void);
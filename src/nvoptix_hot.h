@@ -0,0 +1,25 @@
+#pragma once
+
+// hot thunks
+//
+// The entries marked `hot` in nvoptix_abi.txt, optixLaunch, optixAccelBuild,
+// optixSbtRecordPackHeader and optixDenoiserInvoke, run per frame or per record. Built with
+// `-Dhot_thunks=true` gen_abi.py gives each of them a bare forwarder instead of the traced
+// thunk: no TRACE channel check, USDT probes, API capture or NVTX ranges, just the __cdecl
+// (ms_abi) entry calling the native sysv function, which the compiler reduces to saving the
+// registers sysv does not preserve around the call. The forwarders and the _impl bodies behind
+// them are placed in one .text.hot section. The profile features, accel build rules, timing and
+// tiling keep working. Every other thunk stays fully traced. As a capture without the hot calls
+// cannot be replayed, such a build refuses to capture.
+
+#ifdef NVOPTIX_HOT_THUNKS
+
+#define HOT_THUNK __attribute__((hot, section(".text.hot")))
+#define HOT_CAPTURE_DATA(kind, arg, data, size) do { } while (0)
+
+#else
+
+#define HOT_THUNK
+#define HOT_CAPTURE_DATA capture_data
+
+#endif
@@ -0,0 +1,302 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "nvoptix.h"
+#include "nvoptix_manifest.h"
+#include "nvoptix_93.h"
+
+// the ABI 93 structures are the newest layout, older ABIs are a prefix of them
+
+struct manifest_buffer
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    _Bool failed;
+};
+
+static pthread_mutex_t manifest_lock = PTHREAD_MUTEX_INITIALIZER;
+static int manifest_fd = -1;
+static uint64_t *manifest_hashes = NULL;
+static size_t manifest_hashes_count = 0;
+
+_Bool manifest_enabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled == -1)
+    {
+        char *env = getenv("WINE_NVOPTIX_MODULE_MANIFEST");
+
+        enabled = env && *env ? 1 : 0;
+    }
+
+    return enabled;
+}
+
+static void put(struct manifest_buffer *buf, const void *data, size_t size)
+{
+    if (buf->failed || !size) return;
+
+    if (buf->size + size > buf->capacity)
+    {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+
+        while (capacity < buf->size + size) capacity *= 2;
+
+        unsigned char *new_data = realloc(buf->data, capacity);
+
+        if (!new_data)
+        {
+            buf->failed = 1;
+            return;
+        }
+
+        buf->data = new_data;
+        buf->capacity = capacity;
+    }
+
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+}
+
+static void put_u32(struct manifest_buffer *buf, uint32_t value)
+{
+    put(buf, &value, sizeof(value));
+}
+
+static void put_u64(struct manifest_buffer *buf, uint64_t value)
+{
+    put(buf, &value, sizeof(value));
+}
+
+static void put_blob(struct manifest_buffer *buf, const void *data, size_t size)
+{
+    put_u64(buf, data ? size : 0);
+    if (data) put(buf, data, size);
+}
+
+static void put_string(struct manifest_buffer *buf, const char *str)
+{
+    if (!str)
+    {
+        put_u32(buf, NVOPTIX_MANIFEST_NULL);
+        return;
+    }
+
+    size_t len = strlen(str);
+
+    put_u32(buf, len);
+    put(buf, str, len);
+}
+
+static void put_options(struct manifest_buffer *buf, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize)
+{
+    OptixModuleCompileOptions_93 module = {0};
+    OptixPipelineCompileOptions_93 pipeline = {0};
+
+    if (moduleCompileOptions) memcpy(&module, moduleCompileOptions, min(moduleCompileOptionsSize, sizeof(module)));
+    if (pipelineCompileOptions) memcpy(&pipeline, pipelineCompileOptions, min(pipelineCompileOptionsSize, sizeof(pipeline)));
+
+    if (!module.boundValues) module.numBoundValues = 0;
+    if (!module.payloadTypes) module.numPayloadTypes = 0;
+
+    put_u32(buf, module.maxRegisterCount);
+    put_u32(buf, module.optLevel);
+    put_u32(buf, module.debugLevel);
+    put_u32(buf, module.numBoundValues);
+    put_u32(buf, module.numPayloadTypes);
+
+    for (unsigned int i = 0; i < module.numBoundValues; i++)
+    {
+        const OptixModuleCompileBoundValueEntry_93 *entry = &module.boundValues[i];
+
+        put_u64(buf, entry->pipelineParamOffsetInBytes);
+        put_blob(buf, entry->boundValuePtr, entry->sizeInBytes);
+        put_string(buf, entry->annotation);
+    }
+
+    for (unsigned int i = 0; i < module.numPayloadTypes; i++)
+    {
+        const OptixPayloadType_93 *type = &module.payloadTypes[i];
+        unsigned int count = type->payloadSemantics ? type->numPayloadValues : 0;
+
+        put_u32(buf, count);
+        put(buf, type->payloadSemantics, count * sizeof(unsigned int));
+    }
+
+    put_u32(buf, pipeline.usesMotionBlur);
+    put_u32(buf, pipeline.traversableGraphFlags);
+    put_u32(buf, pipeline.numPayloadValues);
+    put_u32(buf, pipeline.numAttributeValues);
+    put_u32(buf, pipeline.exceptionFlags);
+    put_u32(buf, pipeline.usesPrimitiveTypeFlags);
+    put_u32(buf, pipeline.allowOpacityMicromaps);
+    put_string(buf, pipeline.pipelineLaunchParamsVariableName);
+}
+
+static uint64_t hash_record(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static BOOL manifest_open(void)
+{
+    if (manifest_fd != -1) return TRUE;
+
+    const char *path = getenv("WINE_NVOPTIX_MODULE_MANIFEST");
+
+    if ((manifest_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) == -1)
+    {
+        ERR("Failed to open module manifest %s: %s\n", debugstr_a(path), strerror(errno));
+        return FALSE;
+    }
+
+    if (lseek(manifest_fd, 0, SEEK_END) == 0 && write(manifest_fd, NVOPTIX_MANIFEST_MAGIC, 8) != 8)
+    {
+        ERR("Failed to write module manifest header: %s\n", strerror(errno));
+        close(manifest_fd);
+        manifest_fd = -1;
+        return FALSE;
+    }
+
+    TRACE("Recording module manifest to %s\n", debugstr_a(path));
+
+    return TRUE;
+}
+
+static void manifest_write(const unsigned char *data, size_t size)
+{
+    uint64_t hash = hash_record(data, size);
+
+    if (pthread_mutex_lock(&manifest_lock))
+    {
+        ERR("Failed to acquire manifest lock\n");
+        return;
+    }
+
+    for (size_t i = 0; i < manifest_hashes_count; i++)
+    {
+        if (manifest_hashes[i] == hash) goto done;
+    }
+
+    if (!manifest_open()) goto done;
+
+    uint64_t *new_hashes = reallocarray(manifest_hashes, manifest_hashes_count + 1, sizeof(uint64_t));
+
+    if (new_hashes)
+    {
+        manifest_hashes = new_hashes;
+        manifest_hashes[manifest_hashes_count++] = hash;
+    }
+
+    // one write per record so concurrent processes appending to the same manifest don't interleave
+
+    for (size_t written = 0; written < size;)
+    {
+        ssize_t ret = write(manifest_fd, data + written, size - written);
+
+        if (ret < 0)
+        {
+            if (errno == EINTR) continue;
+            ERR("Failed to write module manifest: %s\n", strerror(errno));
+            break;
+        }
+
+        written += ret;
+    }
+
+done:
+    if (pthread_mutex_unlock(&manifest_lock))
+        ERR("Failed to release manifest lock\n");
+}
+
+void *manifest_encode(uint32_t kind, int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const void *data, size_t dataSize, size_t *size)
+{
+    struct manifest_buffer buf = {0};
+    struct manifest_record_header header = {0};
+
+    put(&buf, &header, sizeof(header));
+    put_options(&buf, moduleCompileOptions, moduleCompileOptionsSize, pipelineCompileOptions, pipelineCompileOptionsSize);
+    put_blob(&buf, data, dataSize);
+
+    if (buf.failed)
+    {
+        free(buf.data);
+        return NULL;
+    }
+
+    header.kind = kind;
+    header.abi = abi;
+    header.size = buf.size - sizeof(header);
+    memcpy(buf.data, &header, sizeof(header));
+
+    *size = buf.size;
+    return buf.data;
+}
+
+void manifest_record_module(int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const char *input, size_t inputSize)
+{
+    unsigned char *record;
+    size_t size;
+
+    TRACE("(%d, %p, %p, %p, %zu)\n", abi, moduleCompileOptions, pipelineCompileOptions, input, inputSize);
+
+    if (!(record = manifest_encode(MANIFEST_RECORD_MODULE, abi, moduleCompileOptions, moduleCompileOptionsSize, pipelineCompileOptions, pipelineCompileOptionsSize, input, inputSize, &size)))
+    {
+        ERR("Failed to allocate manifest record\n");
+        return;
+    }
+
+    manifest_write(record, size);
+    free(record);
+}
+
+void manifest_record_builtin(int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const void *builtinISOptions, size_t builtinISOptionsSize)
+{
+    unsigned char *record;
+    size_t size;
+
+    TRACE("(%d, %p, %p, %p)\n", abi, moduleCompileOptions, pipelineCompileOptions, builtinISOptions);
+
+    if (!(record = manifest_encode(MANIFEST_RECORD_BUILTIN_IS, abi, moduleCompileOptions, moduleCompileOptionsSize, pipelineCompileOptions, pipelineCompileOptionsSize, builtinISOptions, builtinISOptionsSize, &size)))
+    {
+        ERR("Failed to allocate manifest record\n");
+        return;
+    }
+
+    manifest_write(record, size);
+    free(record);
+}
+
+void manifest_close(void)
+{
+    if (manifest_fd != -1)
+    {
+        close(manifest_fd);
+        manifest_fd = -1;
+    }
+
+    free(manifest_hashes);
+    manifest_hashes = NULL;
+    manifest_hashes_count = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// module manifest, written by the relay and read by nvoptix-cache-warm
+//
+// The file starts with NVOPTIX_MANIFEST_MAGIC followed by records. Each record
+// is a struct manifest_record_header followed by `size` bytes of payload:
+//
+//   module options   : i32 maxRegisterCount, i32 optLevel, i32 debugLevel,
+//                      u32 numBoundValues, u32 numPayloadTypes,
+//                      numBoundValues * { u64 offset, blob value, string annotation },
+//                      numPayloadTypes * { u32 count, count * u32 semantics }
+//   pipeline options : i32 usesMotionBlur, u32 traversableGraphFlags,
+//                      i32 numPayloadValues, i32 numAttributeValues, u32 exceptionFlags,
+//                      u32 usesPrimitiveTypeFlags, i32 allowOpacityMicromaps,
+//                      string pipelineLaunchParamsVariableName
+//   MODULE           : blob input
+//   BUILTIN_IS       : blob builtinISOptions (raw structure of the recorded ABI)
+//   PIPELINE         : blob pipelineLinkOptions (raw structure of the recorded ABI),
+//                      module options left empty, only found in API captures
+//
+// blob = u64 size + bytes, string = u32 length (NVOPTIX_MANIFEST_NULL for NULL) + bytes.
+// All values are little endian. Option structures of older ABIs are prefixes of the
+// newest layout, so the reader always rebuilds the newest one.
+
+#define NVOPTIX_MANIFEST_MAGIC "NVOXMAN1"
+#define NVOPTIX_MANIFEST_NULL 0xffffffffu
+
+enum manifest_record_kind
+{
+    MANIFEST_RECORD_MODULE = 1,
+    MANIFEST_RECORD_BUILTIN_IS = 2,
+    MANIFEST_RECORD_PIPELINE = 3,
+};
+
+struct manifest_record_header
+{
+    uint32_t kind;
+    uint32_t abi;
+    uint64_t size;
+};
+
+_Bool manifest_enabled(void);
+void *manifest_encode(uint32_t kind, int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const void *data, size_t dataSize, size_t *size);
+void manifest_record_module(int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const char *input, size_t inputSize);
+void manifest_record_builtin(int abi, const void *moduleCompileOptions, size_t moduleCompileOptionsSize, const void *pipelineCompileOptions, size_t pipelineCompileOptionsSize, const void *builtinISOptions, size_t builtinISOptionsSize);
+void manifest_close(void);
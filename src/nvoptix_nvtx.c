@@ -0,0 +1,153 @@
+#include <dlfcn.h>
+
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_nvtx.h"
+#include "nvoptix_profile.h"
+
+// nvtxEventAttributes_t of NVTX version 2, later versions only add to the unions
+
+#define NVTX_VERSION 2
+#define NVTX_COLOR_ARGB 1
+#define NVTX_MESSAGE_TYPE_ASCII 1
+
+typedef struct nvtxDomainRegistration_st *nvtxDomainHandle_t;
+
+typedef struct nvtxEventAttributes_v2
+{
+    uint16_t version;
+    uint16_t size;
+    uint32_t category;
+    int32_t colorType;
+    uint32_t color;
+    int32_t payloadType;
+    int32_t reserved0;
+    uint64_t payload;
+    int32_t messageType;
+    const char *message;
+} nvtxEventAttributes_t;
+
+static const struct
+{
+    const char *name;
+    const char *category;
+    uint32_t color;
+}
+nvtx_domains[NVTX_DOMAIN_COUNT] =
+{
+    [NVTX_CONTEXT] = { "OptiX context", "context", 0xff9e9e9e },
+    [NVTX_MODULE] = { "OptiX module", "module", 0xff42a5f5 },
+    [NVTX_PIPELINE] = { "OptiX pipeline", "pipeline", 0xff7e57c2 },
+    [NVTX_ACCEL] = { "OptiX accel", "accel", 0xff66bb6a },
+    [NVTX_LAUNCH] = { "OptiX launch", "launch", 0xff76b900 },
+    [NVTX_DENOISER] = { "OptiX denoiser", "denoiser", 0xffffa726 },
+};
+
+static struct
+{
+    nvtxDomainHandle_t (*pnvtxDomainCreateA)(const char *name);
+    void (*pnvtxDomainDestroy)(nvtxDomainHandle_t domain);
+    void (*pnvtxDomainNameCategoryA)(nvtxDomainHandle_t domain, uint32_t category, const char *name);
+    int (*pnvtxDomainRangePushEx)(nvtxDomainHandle_t domain, const nvtxEventAttributes_t *eventAttrib);
+    int (*pnvtxDomainRangePop)(nvtxDomainHandle_t domain);
+} nvtx;
+
+static pthread_once_t nvtx_once = PTHREAD_ONCE_INIT;
+static void *libnvtx_handle = NULL;
+static nvtxDomainHandle_t domains[NVTX_DOMAIN_COUNT];
+
+static void nvtx_init(void)
+{
+    const char *library;
+
+    if (!profile_get_int("nvtx", 0)) return;
+
+    if (!(library = profile_get("nvtx_library")) || !*library) library = "libnvToolsExt.so.1";
+
+    if (!(libnvtx_handle = dlopen(library, RTLD_NOW)))
+    {
+        ERR("Failed to load %s: %s\n", library, dlerror());
+        return;
+    }
+
+    #define LOAD_FUNCPTR(f) if (!(*(void **)(&nvtx.p##f) = dlsym(libnvtx_handle, #f))) { ERR("Can't find symbol %s.\n", #f); goto fail; }
+
+    LOAD_FUNCPTR(nvtxDomainCreateA);
+    LOAD_FUNCPTR(nvtxDomainDestroy);
+    LOAD_FUNCPTR(nvtxDomainRangePushEx);
+    LOAD_FUNCPTR(nvtxDomainRangePop);
+
+    #undef LOAD_FUNCPTR
+
+    // naming categories is optional
+
+    *(void **)(&nvtx.pnvtxDomainNameCategoryA) = dlsym(libnvtx_handle, "nvtxDomainNameCategoryA");
+
+    for (unsigned int i = 0; i < NVTX_DOMAIN_COUNT; i++)
+    {
+        domains[i] = nvtx.pnvtxDomainCreateA(nvtx_domains[i].name);
+
+        if (nvtx.pnvtxDomainNameCategoryA) nvtx.pnvtxDomainNameCategoryA(domains[i], i + 1, nvtx_domains[i].category);
+    }
+
+    WARN("Emitting NVTX ranges through %s\n", library);
+    return;
+
+fail:
+    dlclose(libnvtx_handle);
+    libnvtx_handle = NULL;
+}
+
+_Bool nvtx_enabled(void)
+{
+    pthread_once(&nvtx_once, nvtx_init);
+
+    return libnvtx_handle != NULL;
+}
+
+void nvtx_push(struct nvtx_range *range, enum nvtx_domain domain, const char *name)
+{
+    nvtxEventAttributes_t attributes;
+
+    if (!(range->active = nvtx_enabled())) return;
+
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.version = NVTX_VERSION;
+    attributes.size = sizeof(attributes);
+    attributes.category = domain + 1;
+    attributes.colorType = NVTX_COLOR_ARGB;
+    attributes.color = nvtx_domains[domain].color;
+    attributes.messageType = NVTX_MESSAGE_TYPE_ASCII;
+    attributes.message = name;
+
+    range->domain = domain;
+    nvtx.pnvtxDomainRangePushEx(domains[domain], &attributes);
+}
+
+void nvtx_pop(struct nvtx_range *range)
+{
+    if (range->active) nvtx.pnvtxDomainRangePop(domains[range->domain]);
+}
+
+void nvtx_close(void)
+{
+    if (!libnvtx_handle) return;
+
+    for (unsigned int i = 0; i < NVTX_DOMAIN_COUNT; i++)
+    {
+        if (domains[i]) nvtx.pnvtxDomainDestroy(domains[i]);
+        domains[i] = NULL;
+    }
+
+    dlclose(libnvtx_handle);
+    libnvtx_handle = NULL;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+// NVTX ranges (nvoptix_nvtx.c)
+//
+// With `nvtx=1` every relayed call pushes a range named after the OptiX function for its
+// duration, through the NVTX library named by `nvtx_library` (default: libnvToolsExt.so.1).
+// Each subsystem has its own domain and category, so profilers like Nsight Systems can
+// show or hide them separately. The library only forwards to a profiler that injected
+// itself, without one a range costs a call into an empty function.
+
+enum nvtx_domain
+{
+    NVTX_CONTEXT,
+    NVTX_MODULE,
+    NVTX_PIPELINE,
+    NVTX_ACCEL,
+    NVTX_LAUNCH,
+    NVTX_DENOISER,
+    NVTX_DOMAIN_COUNT
+};
+
+struct nvtx_range
+{
+    _Bool active;
+    enum nvtx_domain domain;
+};
+
+_Bool nvtx_enabled(void);
+void nvtx_push(struct nvtx_range *range, enum nvtx_domain domain, const char *name);
+void nvtx_pop(struct nvtx_range *range);
+void nvtx_close(void);
+
+// the range is popped whenever the enclosing function returns
+
+#define NVTX_RANGE(domain, name) \
+    struct nvtx_range nvtx_range __attribute__((cleanup(nvtx_pop))); \
+    nvtx_push(&nvtx_range, domain, name)
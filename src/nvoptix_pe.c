@@ -0,0 +1,169 @@
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winnls.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include "nvoptix.h"
+#include "nvoptix_abi.h"
+#include "nvoptix_unix_calls.h"
+
+// the PE nvoptix.dll of a unixlib build. Everything but what needs the PE side, the name of
+// the executable, DOS paths and the application's log callback, happens in nvoptix.so, the
+// relay built as its Unix side. Every entry is one Unix call; log messages are queued there
+// and delivered here in a batch once a call returns and says that some wait.
+
+static void log_deliver(void)
+{
+    struct log_drain_params params = { NULL, NULL };
+
+    do
+    {
+        WINE_UNIX_CALL(unix_log_drain, &params);
+
+        for (struct log_message *message = params.messages; message; message = message->next)
+            message->func(message->level, message->tag, message->message, message->data);
+
+        params.done = params.messages;
+    }
+    while (params.done);
+}
+
+static inline void unix_call(unsigned int code, void *args)
+{
+    if (WINE_UNIX_CALL(code, args) == NVOPTIX_LOGS_PENDING) log_deliver();
+}
+
+// the cache location is a DOS path for the application, a Unix one for OptiX
+
+static OptixResult optixDeviceContextSetCacheLocation_pe(OptixResult (*call)(OptixDeviceContext, const char *), OptixDeviceContext context, const char *location)
+{
+    if (!location) return OPTIX_ERROR_DISK_CACHE_INVALID_PATH;
+
+    WCHAR location_wide[MAX_PATH];
+
+    MultiByteToWideChar(CP_ACP, 0, location, -1, location_wide, ARRAY_SIZE(location_wide));
+
+    char *unix_location = wine_get_unix_file_name(location_wide);
+
+    OptixResult result = call(context, unix_location);
+
+    HeapFree(GetProcessHeap(), 0, unix_location);
+
+    return result;
+}
+
+static OptixResult optixDeviceContextGetCacheLocation_pe(OptixResult (*call)(OptixDeviceContext, char *, size_t), OptixDeviceContext context, char *location, size_t locationSize)
+{
+    OptixResult result = call(context, location, locationSize);
+
+    if (result != OPTIX_SUCCESS) return result;
+
+    WCHAR *dos_location = wine_get_dos_file_name(location);
+
+    if (!WideCharToMultiByte(CP_ACP, 0, dos_location, -1, location, locationSize, NULL, NULL)) result = OPTIX_ERROR_INVALID_VALUE;
+
+    HeapFree(GetProcessHeap(), 0, dos_location);
+
+    return result;
+}
+
+#include "nvoptix_pe_thunks.h"
+
+// the Unix side checks the query and fills the table with its own thunks, which are replaced
+// with the PE thunks of the ABI
+
+OptixResult __cdecl optixQueryFunctionTable(
+    int abiId,
+    unsigned int numOptions,
+    int *optionKeys,
+    const void **optionValues,
+    void *functionTable,
+    size_t sizeOfTable)
+{
+    struct query_function_table_params params = { abiId, numOptions, optionKeys, optionValues, functionTable, sizeOfTable };
+
+    TRACE("(%d, %u, %p, %p, %p, %zu)\n", abiId, numOptions, optionKeys, optionValues, functionTable, sizeOfTable);
+
+    unix_call(unix_query_function_table, &params);
+
+    if (params.ret != OPTIX_SUCCESS) return params.ret;
+
+    switch (abiId)
+    {
+        #define FILL_ABI(abi) \
+        case abi: \
+            fill_function_table_ ## abi(functionTable); \
+            break;
+
+        NVOPTIX_ABIS(FILL_ABI)
+
+        #undef FILL_ABI
+    }
+
+    return OPTIX_SUCCESS;
+}
+
+int __cdecl rtGetSymbolTable()
+{
+    ERR("(): not implemented\n");
+    return ~0;
+}
+
+// the profile section of the executable, as the winelib build names it
+
+static void executable_name(char *name, size_t size)
+{
+    WCHAR path[MAX_PATH];
+    DWORD len = GetModuleFileNameW(NULL, path, ARRAY_SIZE(path));
+    WCHAR *file = path + len;
+
+    name[0] = 0;
+
+    if (!len || len >= ARRAY_SIZE(path)) return;
+
+    while (file > path && file[-1] != '\\' && file[-1] != '/') file--;
+
+    if (!WideCharToMultiByte(CP_UNIXCP, 0, file, -1, name, size, NULL, NULL)) name[0] = 0;
+}
+
+BOOL WINAPI DllMain(HINSTANCE instance, DWORD reason, LPVOID reserved)
+{
+    TRACE("(%p, %u, %p)\n", instance, reason, reserved);
+
+    switch (reason)
+    {
+        case DLL_PROCESS_ATTACH:
+        {
+            char executable[MAX_PATH];
+            struct process_attach_params params = { executable };
+
+            DisableThreadLibraryCalls(instance);
+
+            if (__wine_init_unix_call())
+            {
+                ERR("Failed to load nvoptix.so\n");
+                return FALSE;
+            }
+
+            executable_name(executable, sizeof(executable));
+
+            if (WINE_UNIX_CALL(unix_process_attach, &params)) return FALSE;
+            break;
+        }
+        case DLL_PROCESS_DETACH:
+        {
+            struct process_detach_params params = { reserved != NULL };
+
+            if (!reserved) log_deliver();
+
+            WINE_UNIX_CALL(unix_process_detach, &params);
+            break;
+        }
+    }
+
+    return TRUE;
+}
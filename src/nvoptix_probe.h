@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nvoptix_capture.h"
+
+// USDT probes, usable with bpftrace or SystemTap on a running application
+//
+// Every thunk fires `<function>__entry` with the arguments its TRACE line prints and
+// `<function>__return` with the result, eg. `usdt:nvoptix.dll:nvoptix:optixLaunch__entry`.
+// A probe nobody is attached to is a single NOP. sys/sdt.h (systemtap-sdt-dev) is required
+// by meson.build.
+//
+// The same sites feed the API capture (nvoptix_capture.h), each probe is one EVENT.
+
+#include <sys/sdt.h>
+
+#define PROBE_SDT(name, ...) STAP_PROBEV(nvoptix, name, ##__VA_ARGS__)
+
+#define PROBE_NARG(...) PROBE_NARG_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define PROBE_NARG_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+#define PROBE_CONCAT(a, b) PROBE_CONCAT_(a, b)
+#define PROBE_CONCAT_(a, b) a##b
+
+#define PROBE_ARG(x) ((uint64_t)(x))
+#define PROBE_ARGS(...) PROBE_CONCAT(PROBE_ARGS_, PROBE_NARG(__VA_ARGS__))(__VA_ARGS__)
+#define PROBE_ARGS_1(a) PROBE_ARG(a)
+#define PROBE_ARGS_2(a, ...) PROBE_ARG(a), PROBE_ARGS_1(__VA_ARGS__)
+#define PROBE_ARGS_3(a, ...) PROBE_ARG(a), PROBE_ARGS_2(__VA_ARGS__)
+#define PROBE_ARGS_4(a, ...) PROBE_ARG(a), PROBE_ARGS_3(__VA_ARGS__)
+#define PROBE_ARGS_5(a, ...) PROBE_ARG(a), PROBE_ARGS_4(__VA_ARGS__)
+#define PROBE_ARGS_6(a, ...) PROBE_ARG(a), PROBE_ARGS_5(__VA_ARGS__)
+#define PROBE_ARGS_7(a, ...) PROBE_ARG(a), PROBE_ARGS_6(__VA_ARGS__)
+#define PROBE_ARGS_8(a, ...) PROBE_ARG(a), PROBE_ARGS_7(__VA_ARGS__)
+#define PROBE_ARGS_9(a, ...) PROBE_ARG(a), PROBE_ARGS_8(__VA_ARGS__)
+#define PROBE_ARGS_10(a, ...) PROBE_ARG(a), PROBE_ARGS_9(__VA_ARGS__)
+#define PROBE_ARGS_11(a, ...) PROBE_ARG(a), PROBE_ARGS_10(__VA_ARGS__)
+#define PROBE_ARGS_12(a, ...) PROBE_ARG(a), PROBE_ARGS_11(__VA_ARGS__)
+
+#define PROBE(name, ...) \
+    do { \
+        PROBE_SDT(name, __VA_ARGS__); \
+        if (capture_enabled()) \
+            capture_event(__func__, #name, (const uint64_t[]){ PROBE_ARGS(__VA_ARGS__) }, PROBE_NARG(__VA_ARGS__)); \
+    } while (0)
+
+#define PROBE_RETURN(name, expr) \
+    ({ __typeof__(expr) probe_result = (expr); PROBE(name##__return, probe_result); probe_result; })
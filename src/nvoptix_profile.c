@@ -0,0 +1,579 @@
+#include "windef.h"
+#include "winbase.h"
+#include "winnls.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#include "nvoptix.h"
+#include "nvoptix_profile.h"
+
+#define OPTIX_COMPILE_OPTIMIZATION_LEVEL_0 0x2340
+#define OPTIX_COMPILE_OPTIMIZATION_LEVEL_3 0x2343
+
+#define OPTIX_COMPILE_DEBUG_LEVEL_NONE 0x2350
+#define OPTIX_COMPILE_DEBUG_LEVEL_MINIMAL 0x2351
+#define OPTIX_COMPILE_DEBUG_LEVEL_FULL 0x2352
+#define OPTIX_COMPILE_DEBUG_LEVEL_MODERATE 0x2353
+
+#define OPTIX_EXCEPTION_FLAG_STACK_OVERFLOW (1u << 0)
+#define OPTIX_EXCEPTION_FLAG_TRACE_DEPTH (1u << 1)
+#define OPTIX_EXCEPTION_FLAG_USER (1u << 2)
+#define OPTIX_EXCEPTION_FLAG_DEBUG (1u << 3)
+
+#define OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_GAS (1u << 0)
+#define OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_LEVEL_INSTANCING (1u << 1)
+
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_CUSTOM (1u << 0)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_QUADRATIC_BSPLINE (1u << 1)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_CUBIC_BSPLINE (1u << 2)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_LINEAR (1u << 3)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_CATMULLROM (1u << 4)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_FLAT_QUADRATIC_BSPLINE (1u << 5)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_SPHERE (1u << 6)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_CUBIC_BEZIER (1u << 7)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_DISPLACED_MICROMESH_TRIANGLE (1u << 30)
+#define OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE (1u << 31)
+
+#define PROFILE_UNSET -1
+
+struct profile_flag
+{
+    const char *name;
+    unsigned int value;
+};
+
+static const struct profile_flag exception_flags[] =
+{
+    { "none", 0 },
+    { "stack_overflow", OPTIX_EXCEPTION_FLAG_STACK_OVERFLOW },
+    { "trace_depth", OPTIX_EXCEPTION_FLAG_TRACE_DEPTH },
+    { "user", OPTIX_EXCEPTION_FLAG_USER },
+    { "debug", OPTIX_EXCEPTION_FLAG_DEBUG },
+};
+
+static const struct profile_flag traversable_graph_flags[] =
+{
+    { "any", 0 },
+    { "single_gas", OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_GAS },
+    { "single_level_instancing", OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_LEVEL_INSTANCING },
+};
+
+static const struct profile_flag primitive_type_flags[] =
+{
+    { "default", 0 },
+    { "custom", OPTIX_PRIMITIVE_TYPE_FLAGS_CUSTOM },
+    { "round_quadratic_bspline", OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_QUADRATIC_BSPLINE },
+    { "round_cubic_bspline", OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_CUBIC_BSPLINE },
+    { "round_linear", OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_LINEAR },
+    { "round_catmullrom", OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_CATMULLROM },
+    { "flat_quadratic_bspline", OPTIX_PRIMITIVE_TYPE_FLAGS_FLAT_QUADRATIC_BSPLINE },
+    { "sphere", OPTIX_PRIMITIVE_TYPE_FLAGS_SPHERE },
+    { "round_cubic_bezier", OPTIX_PRIMITIVE_TYPE_FLAGS_ROUND_CUBIC_BEZIER },
+    { "displaced_micromesh_triangle", OPTIX_PRIMITIVE_TYPE_FLAGS_DISPLACED_MICROMESH_TRIANGLE },
+    { "triangle", OPTIX_PRIMITIVE_TYPE_FLAGS_TRIANGLE },
+};
+
+struct profile_entry
+{
+    char *key;
+    char *value;
+};
+
+static pthread_once_t profile_once = PTHREAD_ONCE_INIT;
+static struct profile_entry *profile_entries = NULL;
+static size_t profile_entries_count = 0;
+static char profile_exe[MAX_PATH];
+
+static struct
+{
+    int maxRegisterCount;
+    int optLevel;
+    int debugLevel;
+    int stripBoundValues;
+    _Bool enabled;
+} module_overrides;
+
+static struct
+{
+    int usesMotionBlur;
+    long long traversableGraphFlags;
+    long long exceptionFlags;
+    long long usesPrimitiveTypeFlags;
+    int maxTraceDepth;
+    _Bool enabled;
+} pipeline_overrides;
+
+static char *trim(char *str)
+{
+    while (isspace((unsigned char)*str)) str++;
+
+    char *end = str + strlen(str);
+
+    while (end > str && isspace((unsigned char)end[-1])) end--;
+    *end = 0;
+
+    return str;
+}
+
+static void profile_set(const char *key, const char *value)
+{
+    for (size_t i = 0; i < profile_entries_count; i++)
+    {
+        if (strcasecmp(profile_entries[i].key, key)) continue;
+
+        char *new_value = strdup(value);
+
+        if (!new_value) return;
+
+        free(profile_entries[i].value);
+        profile_entries[i].value = new_value;
+        return;
+    }
+
+    struct profile_entry *new_entries = reallocarray(profile_entries, profile_entries_count + 1, sizeof(struct profile_entry));
+
+    if (!new_entries)
+    {
+        ERR("Failed to reallocate profile entries\n");
+        return;
+    }
+
+    profile_entries = new_entries;
+    profile_entries[profile_entries_count].key = strdup(key);
+    profile_entries[profile_entries_count].value = strdup(value);
+
+    if (profile_entries[profile_entries_count].key && profile_entries[profile_entries_count].value)
+        profile_entries_count++;
+}
+
+// loads the keys of every section matching `section`, called for [*] first so the executable wins
+
+static void profile_load_section(FILE *file, const char *path, const char *section)
+{
+    char line[1024];
+    unsigned int lineno = 0;
+    _Bool active = FALSE;
+
+    rewind(file);
+
+    while (fgets(line, sizeof(line), file))
+    {
+        char *str = trim(line);
+
+        lineno++;
+
+        if (!*str || *str == '#' || *str == ';') continue;
+
+        if (*str == '[')
+        {
+            char *end = strchr(str, ']');
+
+            if (!end)
+            {
+                WARN("%s:%u: malformed section header\n", path, lineno);
+                active = FALSE;
+                continue;
+            }
+
+            *end = 0;
+            active = !strcasecmp(trim(str + 1), section);
+            continue;
+        }
+
+        if (!active) continue;
+
+        char *eq = strchr(str, '=');
+
+        if (!eq)
+        {
+            WARN("%s:%u: expected key = value\n", path, lineno);
+            continue;
+        }
+
+        *eq = 0;
+        profile_set(trim(str), trim(eq + 1));
+    }
+}
+
+static void profile_load_file(void)
+{
+    char path[MAX_PATH];
+    const char *env;
+
+    if ((env = getenv("WINE_NVOPTIX_PROFILE")))
+        snprintf(path, sizeof(path), "%s", env);
+    else if ((env = getenv("XDG_CONFIG_HOME")) && *env)
+        snprintf(path, sizeof(path), "%s/wine-nvoptix/profiles.conf", env);
+    else if ((env = getenv("HOME")))
+        snprintf(path, sizeof(path), "%s/.config/wine-nvoptix/profiles.conf", env);
+    else
+        return;
+
+    FILE *file = fopen(path, "r");
+
+    if (!file)
+    {
+        TRACE("No profile file at %s\n", debugstr_a(path));
+        return;
+    }
+
+    profile_load_section(file, path, "*");
+    if (*profile_exe) profile_load_section(file, path, profile_exe);
+
+    fclose(file);
+
+    TRACE("Loaded %zu profile settings for %s from %s\n", profile_entries_count, debugstr_a(profile_exe), debugstr_a(path));
+}
+
+static int parse_opt_level(const char *value)
+{
+    if (!strcasecmp(value, "default")) return 0;
+
+    char *end;
+    long level = strtol(value, &end, 0);
+
+    if (*end) return PROFILE_UNSET;
+    if (level >= 0 && level <= 3) return OPTIX_COMPILE_OPTIMIZATION_LEVEL_0 + level;
+    if (level >= OPTIX_COMPILE_OPTIMIZATION_LEVEL_0 && level <= OPTIX_COMPILE_OPTIMIZATION_LEVEL_3) return level;
+
+    return PROFILE_UNSET;
+}
+
+static int parse_debug_level(const char *value)
+{
+    static const struct { const char *name; int level; } levels[] =
+    {
+        { "default", 0 },
+        { "none", OPTIX_COMPILE_DEBUG_LEVEL_NONE },
+        { "lineinfo", OPTIX_COMPILE_DEBUG_LEVEL_MINIMAL },
+        { "minimal", OPTIX_COMPILE_DEBUG_LEVEL_MINIMAL },
+        { "moderate", OPTIX_COMPILE_DEBUG_LEVEL_MODERATE },
+        { "full", OPTIX_COMPILE_DEBUG_LEVEL_FULL },
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(levels); i++)
+    {
+        if (!strcasecmp(value, levels[i].name)) return levels[i].level;
+    }
+
+    char *end;
+    long level = strtol(value, &end, 0);
+
+    if (!*end && level >= OPTIX_COMPILE_DEBUG_LEVEL_NONE && level <= OPTIX_COMPILE_DEBUG_LEVEL_MODERATE) return level;
+
+    return PROFILE_UNSET;
+}
+
+// parses `name|name|...` (`,` and `+` also separate) or a plain number, -1 if invalid
+
+static long long parse_flags(const char *value, const struct profile_flag *flags, size_t count)
+{
+    char buf[256], *tok, *save = NULL;
+    long long ret = 0;
+
+    snprintf(buf, sizeof(buf), "%s", value);
+
+    for (tok = strtok_r(buf, "|,+", &save); tok; tok = strtok_r(NULL, "|,+", &save))
+    {
+        char *name = trim(tok), *end;
+        size_t i;
+
+        for (i = 0; i < count; i++)
+        {
+            if (!strcasecmp(name, flags[i].name)) break;
+        }
+
+        if (i < count)
+        {
+            ret |= flags[i].value;
+            continue;
+        }
+
+        unsigned long number = strtoul(name, &end, 0);
+
+        if (!*name || *end) return PROFILE_UNSET;
+
+        ret |= (unsigned int)number;
+    }
+
+    return ret;
+}
+
+static long long profile_get_flags(const char *key, const struct profile_flag *flags, size_t count)
+{
+    const char *value = profile_get(key);
+    long long ret;
+
+    if (!value) return PROFILE_UNSET;
+
+    if ((ret = parse_flags(value, flags, count)) == PROFILE_UNSET)
+        ERR("Invalid %s = %s\n", key, debugstr_a(value));
+
+    return ret;
+}
+
+static void profile_init_module_overrides(void)
+{
+    const char *value;
+
+    module_overrides.maxRegisterCount = profile_get_int("module_max_register_count", PROFILE_UNSET);
+    module_overrides.optLevel = PROFILE_UNSET;
+    module_overrides.debugLevel = PROFILE_UNSET;
+    module_overrides.stripBoundValues = profile_get_int("module_strip_bound_values", 0);
+
+    if ((value = profile_get("module_opt_level")) && (module_overrides.optLevel = parse_opt_level(value)) == PROFILE_UNSET)
+        ERR("Invalid module_opt_level = %s\n", debugstr_a(value));
+
+    if ((value = profile_get("module_debug_level")) && (module_overrides.debugLevel = parse_debug_level(value)) == PROFILE_UNSET)
+        ERR("Invalid module_debug_level = %s\n", debugstr_a(value));
+
+    module_overrides.enabled = module_overrides.maxRegisterCount != PROFILE_UNSET ||
+                               module_overrides.optLevel != PROFILE_UNSET ||
+                               module_overrides.debugLevel != PROFILE_UNSET ||
+                               module_overrides.stripBoundValues;
+
+    if (module_overrides.enabled)
+        WARN("Module compile overrides: maxRegisterCount = %d, optLevel = %#x, debugLevel = %#x, stripBoundValues = %d\n",
+             module_overrides.maxRegisterCount, module_overrides.optLevel, module_overrides.debugLevel, module_overrides.stripBoundValues);
+}
+
+static void profile_init_pipeline_overrides(void)
+{
+    pipeline_overrides.usesMotionBlur = profile_get_int("pipeline_uses_motion_blur", PROFILE_UNSET);
+    pipeline_overrides.traversableGraphFlags = profile_get_flags("pipeline_traversable_graph_flags", traversable_graph_flags, ARRAY_SIZE(traversable_graph_flags));
+    pipeline_overrides.exceptionFlags = profile_get_flags("pipeline_exception_flags", exception_flags, ARRAY_SIZE(exception_flags));
+    pipeline_overrides.usesPrimitiveTypeFlags = profile_get_flags("pipeline_primitive_type_flags", primitive_type_flags, ARRAY_SIZE(primitive_type_flags));
+    pipeline_overrides.maxTraceDepth = profile_get_int("pipeline_max_trace_depth", PROFILE_UNSET);
+
+    if (pipeline_overrides.usesMotionBlur != PROFILE_UNSET) pipeline_overrides.usesMotionBlur = !!pipeline_overrides.usesMotionBlur;
+
+    pipeline_overrides.enabled = pipeline_overrides.usesMotionBlur != PROFILE_UNSET ||
+                                 pipeline_overrides.traversableGraphFlags != PROFILE_UNSET ||
+                                 pipeline_overrides.exceptionFlags != PROFILE_UNSET ||
+                                 pipeline_overrides.usesPrimitiveTypeFlags != PROFILE_UNSET ||
+                                 pipeline_overrides.maxTraceDepth != PROFILE_UNSET;
+
+    if (pipeline_overrides.enabled)
+        WARN("Pipeline overrides: usesMotionBlur = %d, traversableGraphFlags = %#llx, exceptionFlags = %#llx, usesPrimitiveTypeFlags = %#llx, maxTraceDepth = %d\n",
+             pipeline_overrides.usesMotionBlur, pipeline_overrides.traversableGraphFlags, pipeline_overrides.exceptionFlags,
+             pipeline_overrides.usesPrimitiveTypeFlags, pipeline_overrides.maxTraceDepth);
+}
+
+#ifdef WINE_UNIX_LIB
+
+// the Unix side of a unixlib build has no module file name to ask for, the PE side passes the
+// name of the executable, in the Unix code page, when it is attached and before the profile is read
+
+void profile_set_executable(const char *name)
+{
+    snprintf(profile_exe, sizeof(profile_exe), "%s", name);
+
+    for (char *c = profile_exe; *c; c++) *c = tolower((unsigned char)*c);
+}
+
+static void profile_init(void)
+{
+    profile_load_file();
+}
+
+#else
+
+static void profile_init(void)
+{
+    WCHAR path[MAX_PATH];
+    DWORD len = GetModuleFileNameW(NULL, path, ARRAY_SIZE(path));
+
+    if (len && len < ARRAY_SIZE(path))
+    {
+        WCHAR *name = path + len;
+
+        while (name > path && name[-1] != '\\' && name[-1] != '/') name--;
+
+        if (WideCharToMultiByte(CP_UNIXCP, 0, name, -1, profile_exe, sizeof(profile_exe), NULL, NULL))
+        {
+            for (char *c = profile_exe; *c; c++) *c = tolower((unsigned char)*c);
+        }
+        else
+        {
+            profile_exe[0] = 0;
+        }
+    }
+
+    profile_load_file();
+}
+
+#endif
+
+const char *profile_executable(void)
+{
+    pthread_once(&profile_once, profile_init);
+    return profile_exe;
+}
+
+const char *profile_get(const char *key)
+{
+    char name[128];
+    const char *env;
+    size_t i;
+
+    pthread_once(&profile_once, profile_init);
+
+    i = snprintf(name, sizeof(name), "WINE_NVOPTIX_");
+
+    for (const char *c = key; *c && i < sizeof(name) - 1; c++) name[i++] = toupper((unsigned char)*c);
+    name[i] = 0;
+
+    if ((env = getenv(name))) return env;
+
+    for (i = 0; i < profile_entries_count; i++)
+    {
+        if (!strcasecmp(profile_entries[i].key, key)) return profile_entries[i].value;
+    }
+
+    return NULL;
+}
+
+int profile_get_int(const char *key, int def)
+{
+    const char *value = profile_get(key);
+    char *end;
+
+    if (!value || !*value) return def;
+
+    long ret = strtol(value, &end, 0);
+
+    if (*end)
+    {
+        ERR("Invalid %s = %s\n", key, debugstr_a(value));
+        return def;
+    }
+
+    return ret;
+}
+
+_Bool profile_module_overrides(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, profile_init_module_overrides);
+
+    return module_overrides.enabled;
+}
+
+static void apply_debug_level(int abi, int *debugLevel)
+{
+    int level = module_overrides.debugLevel;
+
+    if (level == PROFILE_UNSET) return;
+
+    // MODERATE only exists since ABI 55, MINIMAL shares its value with the older LINEINFO
+
+    if (level == OPTIX_COMPILE_DEBUG_LEVEL_MODERATE && abi < 55) level = OPTIX_COMPILE_DEBUG_LEVEL_MINIMAL;
+
+    if (*debugLevel != level)
+    {
+        WARN("debugLevel %#x -> %#x\n", *debugLevel, level);
+        *debugLevel = level;
+    }
+}
+
+void profile_apply_module_compile_options(int abi, int *maxRegisterCount, int *optLevel, int *debugLevel, unsigned int *numBoundValues)
+{
+    if (module_overrides.maxRegisterCount != PROFILE_UNSET && *maxRegisterCount != module_overrides.maxRegisterCount)
+    {
+        WARN("maxRegisterCount %d -> %d\n", *maxRegisterCount, module_overrides.maxRegisterCount);
+        *maxRegisterCount = module_overrides.maxRegisterCount;
+    }
+
+    if (module_overrides.optLevel != PROFILE_UNSET && *optLevel != module_overrides.optLevel)
+    {
+        WARN("optLevel %#x -> %#x\n", *optLevel, module_overrides.optLevel);
+        *optLevel = module_overrides.optLevel;
+    }
+
+    apply_debug_level(abi, debugLevel);
+
+    if (module_overrides.stripBoundValues && numBoundValues && *numBoundValues)
+    {
+        WARN("stripping %u bound values\n", *numBoundValues);
+        *numBoundValues = 0;
+    }
+}
+
+_Bool profile_pipeline_overrides(void)
+{
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+
+    pthread_once(&once, profile_init_pipeline_overrides);
+
+    return pipeline_overrides.enabled;
+}
+
+// the same values are applied to every module, builtin IS module and pipeline, OptiX requires them to match
+
+void profile_apply_pipeline_compile_options(int abi, int *usesMotionBlur, unsigned int *traversableGraphFlags, unsigned int *exceptionFlags, unsigned int *usesPrimitiveTypeFlags)
+{
+    if (pipeline_overrides.usesMotionBlur != PROFILE_UNSET && *usesMotionBlur != pipeline_overrides.usesMotionBlur)
+    {
+        WARN("usesMotionBlur %d -> %d\n", *usesMotionBlur, pipeline_overrides.usesMotionBlur);
+        *usesMotionBlur = pipeline_overrides.usesMotionBlur;
+    }
+
+    if (pipeline_overrides.traversableGraphFlags != PROFILE_UNSET && *traversableGraphFlags != pipeline_overrides.traversableGraphFlags)
+    {
+        WARN("traversableGraphFlags %#x -> %#llx\n", *traversableGraphFlags, pipeline_overrides.traversableGraphFlags);
+        *traversableGraphFlags = pipeline_overrides.traversableGraphFlags;
+    }
+
+    if (pipeline_overrides.exceptionFlags != PROFILE_UNSET && *exceptionFlags != pipeline_overrides.exceptionFlags)
+    {
+        WARN("exceptionFlags %#x -> %#llx\n", *exceptionFlags, pipeline_overrides.exceptionFlags);
+        *exceptionFlags = pipeline_overrides.exceptionFlags;
+    }
+
+    // usesPrimitiveTypeFlags only exists since ABI 36
+
+    if (pipeline_overrides.usesPrimitiveTypeFlags != PROFILE_UNSET && usesPrimitiveTypeFlags && *usesPrimitiveTypeFlags != pipeline_overrides.usesPrimitiveTypeFlags)
+    {
+        WARN("usesPrimitiveTypeFlags %#x -> %#llx\n", *usesPrimitiveTypeFlags, pipeline_overrides.usesPrimitiveTypeFlags);
+        *usesPrimitiveTypeFlags = pipeline_overrides.usesPrimitiveTypeFlags;
+    }
+}
+
+void profile_apply_pipeline_link_options(int abi, unsigned int *maxTraceDepth, int *debugLevel, int *overrideUsesMotionBlur)
+{
+    if (pipeline_overrides.maxTraceDepth != PROFILE_UNSET && *maxTraceDepth != (unsigned int)pipeline_overrides.maxTraceDepth)
+    {
+        WARN("maxTraceDepth %u -> %d\n", *maxTraceDepth, pipeline_overrides.maxTraceDepth);
+        *maxTraceDepth = pipeline_overrides.maxTraceDepth;
+    }
+
+    // link options carried their own debugLevel before ABI 84, keep it in line with the modules
+
+    if (debugLevel && profile_module_overrides()) apply_debug_level(abi, debugLevel);
+
+    // ABI 22 can override usesMotionBlur at link time, let the compile options decide
+
+    if (overrideUsesMotionBlur && *overrideUsesMotionBlur && pipeline_overrides.usesMotionBlur != PROFILE_UNSET)
+    {
+        WARN("overrideUsesMotionBlur %d -> 0\n", *overrideUsesMotionBlur);
+        *overrideUsesMotionBlur = 0;
+    }
+}
+
+void profile_apply_builtin_is_options(int abi, int *usesMotionBlur)
+{
+    if (pipeline_overrides.usesMotionBlur != PROFILE_UNSET && *usesMotionBlur != pipeline_overrides.usesMotionBlur)
+    {
+        WARN("builtin IS usesMotionBlur %d -> %d\n", *usesMotionBlur, pipeline_overrides.usesMotionBlur);
+        *usesMotionBlur = pipeline_overrides.usesMotionBlur;
+    }
+}
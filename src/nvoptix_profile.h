@@ -0,0 +1,30 @@
+#pragma once
+
+// per-executable relay profile
+//
+// Settings are looked up in this order:
+//   1. environment variable WINE_NVOPTIX_<KEY> (key upper-cased)
+//   2. the [<executable>.exe] section of the profile file
+//   3. the [*] section of the profile file
+//
+// The profile file is $WINE_NVOPTIX_PROFILE, or $XDG_CONFIG_HOME/wine-nvoptix/profiles.conf
+// (~/.config/wine-nvoptix/profiles.conf), with `key = value` lines and `#`/`;` comments.
+
+const char *profile_get(const char *key);
+int profile_get_int(const char *key, int def);
+const char *profile_executable(void);
+#ifdef WINE_UNIX_LIB
+void profile_set_executable(const char *name);
+#endif
+
+// module compile option overrides
+
+_Bool profile_module_overrides(void);
+void profile_apply_module_compile_options(int abi, int *maxRegisterCount, int *optLevel, int *debugLevel, unsigned int *numBoundValues);
+
+// pipeline compile and link option overrides
+
+_Bool profile_pipeline_overrides(void);
+void profile_apply_pipeline_compile_options(int abi, int *usesMotionBlur, unsigned int *traversableGraphFlags, unsigned int *exceptionFlags, unsigned int *usesPrimitiveTypeFlags);
+void profile_apply_pipeline_link_options(int abi, unsigned int *maxTraceDepth, int *debugLevel, int *overrideUsesMotionBlur);
+void profile_apply_builtin_is_options(int abi, int *usesMotionBlur);
@@ -0,0 +1,126 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "nvoptix.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *stats_path = NULL;
+static char *stats_temp_path = NULL;
+static uint64_t stats_interval;
+static uint64_t stats_written;
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void stats_init(void)
+{
+    const char *path = profile_get("stats_file");
+    size_t len;
+
+    if (!path || !*path) return;
+
+    len = strlen(path);
+
+    if (!(stats_path = strdup(path)) || !(stats_temp_path = malloc(len + 5)))
+    {
+        ERR("Failed to allocate stats file path\n");
+        free(stats_path);
+        stats_path = NULL;
+        return;
+    }
+
+    memcpy(stats_temp_path, path, len);
+    memcpy(stats_temp_path + len, ".tmp", 5);
+
+    stats_interval = (uint64_t)max(profile_get_int("stats_interval_ms", 1000), 0) * 1000000;
+
+    WARN("Writing live statistics to %s every %llu ms\n", stats_path, (unsigned long long)(stats_interval / 1000000));
+}
+
+_Bool stats_enabled(void)
+{
+    pthread_once(&stats_once, stats_init);
+
+    return stats_path != NULL;
+}
+
+static void write_stats(void)
+{
+    FILE *file;
+
+    if (!(file = fopen(stats_temp_path, "w")))
+    {
+        ERR("Failed to open %s\n", stats_temp_path);
+        return;
+    }
+
+    fprintf(file, "executable %s\npid %d\n", profile_executable(), (int)getpid());
+
+    accel_memory_stats(file);
+    accel_compaction_stats(file);
+    accel_graph_stats(file);
+    denoiser_stats(file);
+    gpu_timing_stats(file);
+    compile_stats(file);
+
+    if (fclose(file))
+    {
+        ERR("Failed to write %s\n", stats_temp_path);
+        return;
+    }
+
+    if (rename(stats_temp_path, stats_path))
+        ERR("Failed to rename %s to %s\n", stats_temp_path, stats_path);
+}
+
+// called after every change to the statistics, skipped while another thread is writing
+
+void stats_update(void)
+{
+    uint64_t now;
+
+    if (!stats_enabled() || pthread_mutex_trylock(&stats_lock)) return;
+
+    if ((now = monotonic_ns()) - stats_written >= stats_interval)
+    {
+        write_stats();
+        stats_written = now;
+    }
+
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void stats_close(void)
+{
+    if (!stats_path) return;
+
+    if (!pthread_mutex_lock(&stats_lock))
+    {
+        write_stats();
+        pthread_mutex_unlock(&stats_lock);
+    }
+
+    free(stats_path);
+    free(stats_temp_path);
+    stats_path = stats_temp_path = NULL;
+}
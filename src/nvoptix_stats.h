@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdio.h>
+
+// live statistics file
+//
+// With the `stats_file` profile key set the relay rewrites that file with the current
+// statistics of every enabled subsystem, at most every `stats_interval_ms` (default:
+// 1000) while the application makes OptiX calls and once more when it is unloaded.
+// The file is written next to the target and renamed over it, readers never see a
+// partial update, eg. `watch -n1 cat /tmp/nvoptix.stats`.
+
+_Bool stats_enabled(void);
+void stats_update(void);
+void stats_close(void);
+
+// providers, each writes its own section
+
+void accel_memory_stats(FILE *file);
+void accel_compaction_stats(FILE *file);
+void accel_graph_stats(FILE *file);
+void denoiser_stats(FILE *file);
+void gpu_timing_stats(FILE *file);
+void compile_stats(FILE *file);
@@ -0,0 +1,407 @@
+#include "windef.h"
+#include "winbase.h"
+#include "wine/debug.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(nvoptix);
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "nvoptix.h"
+#include "nvoptix_cuda.h"
+#include "nvoptix_profile.h"
+#include "nvoptix_stats.h"
+#include "nvoptix_timing.h"
+
+// bin i counts times from 2^i to 2^(i+1) microseconds, the first one also everything shorter
+
+#define TIMING_BINS 24
+#define TIMING_BUCKETS 256
+#define TIMING_PENDING 4096
+#define TIMING_IDLE_EVENTS 256
+#define TIMING_HARVEST_MS 10
+
+struct timing_bucket
+{
+    char name[96];
+    unsigned long count;
+    double total_ms;
+    float min_ms;
+    float max_ms;
+    unsigned long bins[TIMING_BINS];
+};
+
+struct timing_event
+{
+    CUcontext context;
+    CUevent event;
+};
+
+struct timing_pending
+{
+    CUcontext context;
+    CUevent start;
+    CUevent end;
+    unsigned int bucket;
+    unsigned long long *total_us;
+};
+
+static pthread_once_t timing_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t timing_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Bool timing;
+
+// the harvester is a plain pthread without a Wine TEB, it must not log
+
+static pthread_once_t harvester_once = PTHREAD_ONCE_INIT;
+static pthread_cond_t harvester_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t harvester_thread;
+static _Bool harvester_running;
+static _Bool harvester_stop;
+static _Bool harvested;
+
+static struct timing_bucket *buckets = NULL;
+static size_t buckets_count = 0;
+
+static struct timing_event *idle_events = NULL;
+static size_t idle_events_count = 0;
+
+static struct timing_pending *pending = NULL;
+static size_t pending_count = 0;
+
+static unsigned long dropped;
+
+static BOOL lock(void)
+{
+    if (!pthread_mutex_lock(&timing_lock)) return TRUE;
+
+    ERR("Failed to acquire GPU timing lock\n");
+    return FALSE;
+}
+
+static void unlock(void)
+{
+    if (pthread_mutex_unlock(&timing_lock))
+        ERR("Failed to release GPU timing lock\n");
+}
+
+static BOOL take_event(CUcontext context, CUevent *event)
+{
+    for (size_t i = idle_events_count; i-- > 0;)
+    {
+        if (idle_events[i].context != context) continue;
+
+        *event = idle_events[i].event;
+        idle_events[i] = idle_events[--idle_events_count];
+        return TRUE;
+    }
+
+    return cuda.pcuEventCreate(event, CU_EVENT_DEFAULT) == CUDA_SUCCESS;
+}
+
+static void give_event(CUcontext context, CUevent event)
+{
+    struct timing_event *new_events;
+
+    if (idle_events_count < TIMING_IDLE_EVENTS &&
+        (new_events = reallocarray(idle_events, idle_events_count + 1, sizeof(struct timing_event))))
+    {
+        idle_events = new_events;
+        idle_events[idle_events_count].context = context;
+        idle_events[idle_events_count++].event = event;
+    }
+    else
+    {
+        cuda.pcuEventDestroy(event);
+    }
+}
+
+static struct timing_bucket *find_bucket(const char *name)
+{
+    struct timing_bucket *new_buckets;
+
+    for (size_t i = 0; i < buckets_count; i++)
+    {
+        if (!strcmp(buckets[i].name, name)) return &buckets[i];
+    }
+
+    // everything past the limit goes to the last bucket
+
+    if (buckets_count == TIMING_BUCKETS) return &buckets[buckets_count - 1];
+
+    if (!(new_buckets = reallocarray(buckets, buckets_count + 1, sizeof(struct timing_bucket))))
+    {
+        ERR("Failed to reallocate GPU timing buckets\n");
+        return NULL;
+    }
+
+    buckets = new_buckets;
+    memset(&buckets[buckets_count], 0, sizeof(struct timing_bucket));
+    snprintf(buckets[buckets_count].name, sizeof(buckets[buckets_count].name), "%s",
+             buckets_count == TIMING_BUCKETS - 1 ? "other" : name);
+
+    return &buckets[buckets_count++];
+}
+
+static void add_time(struct timing_bucket *bucket, float ms)
+{
+    unsigned int bin = 0;
+
+    for (uint64_t us = ms * 1000.0f; us > 1 && bin < TIMING_BINS - 1; us >>= 1) bin++;
+
+    if (!bucket->count || ms < bucket->min_ms) bucket->min_ms = ms;
+    if (!bucket->count || ms > bucket->max_ms) bucket->max_ms = ms;
+
+    bucket->count++;
+    bucket->total_ms += ms;
+    bucket->bins[bin]++;
+}
+
+// collects every finished pair without waiting for the ones still running, returns TRUE when any was
+
+static BOOL harvest(void)
+{
+    BOOL updated = FALSE;
+    float ms;
+
+    for (size_t i = 0; i < pending_count;)
+    {
+        struct timing_pending *entry = &pending[i];
+        CUresult status = cuda.pcuEventQuery(entry->end);
+
+        if (status == CUDA_ERROR_NOT_READY)
+        {
+            i++;
+            continue;
+        }
+
+        if (status == CUDA_SUCCESS && cuda.pcuEventElapsedTime(&ms, entry->start, entry->end) == CUDA_SUCCESS)
+        {
+            if (entry->total_us)
+            {
+                __atomic_fetch_add(entry->total_us, (unsigned long long)(ms * 1000.0f), __ATOMIC_RELAXED);
+            }
+            else
+            {
+                add_time(&buckets[entry->bucket], ms);
+                updated = TRUE;
+            }
+        }
+        else
+        {
+            dropped++;
+        }
+
+        give_event(entry->context, entry->start);
+        give_event(entry->context, entry->end);
+        *entry = pending[--pending_count];
+    }
+
+    return updated;
+}
+
+static void *harvester(void *arg)
+{
+    struct timespec deadline;
+
+    pthread_mutex_lock(&timing_lock);
+
+    while (!harvester_stop)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TIMING_HARVEST_MS * 1000000;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000;
+        deadline.tv_nsec %= 1000000000;
+
+        pthread_cond_timedwait(&harvester_cond, &timing_lock, &deadline);
+
+        if (harvest()) harvested = TRUE;
+    }
+
+    pthread_mutex_unlock(&timing_lock);
+
+    return NULL;
+}
+
+static void harvester_start(void)
+{
+    if (!(harvester_running = !pthread_create(&harvester_thread, NULL, harvester, NULL)))
+        ERR("Failed to start GPU timing harvester, collecting timings on later calls\n");
+}
+
+static void timing_init(void)
+{
+    if ((timing = profile_get_int("gpu_timing", 0)))
+        WARN("Timing launches, accel builds, compactions and micromap builds on the GPU\n");
+}
+
+_Bool gpu_timing_enabled(void)
+{
+    pthread_once(&timing_once, timing_init);
+
+    return timing;
+}
+
+BOOL gpu_timing_begin(struct gpu_timing *timing, CUstream stream)
+{
+    BOOL ret, updated;
+
+    memset(timing, 0, sizeof(*timing));
+
+    if (!cuda_available() || cuda.pcuCtxGetCurrent(&timing->context) != CUDA_SUCCESS || !timing->context) return FALSE;
+
+    pthread_once(&harvester_once, harvester_start);
+
+    if (!lock()) return FALSE;
+
+    updated = harvester_running ? harvested : harvest();
+    harvested = FALSE;
+
+    if ((ret = take_event(timing->context, &timing->start)) && cuda.pcuEventRecord(timing->start, stream) != CUDA_SUCCESS)
+    {
+        cuda.pcuEventDestroy(timing->start);
+        ret = FALSE;
+    }
+
+    unlock();
+
+    if (updated) stats_update();
+
+    timing->active = ret;
+    timing->stream = stream;
+
+    return ret;
+}
+
+// queues the end event of a successful call, its time goes to the bucket or is added to *total_us
+
+static void timing_queue(struct gpu_timing *timing, OptixResult result, const char *bucket, unsigned long long *total_us)
+{
+    struct timing_pending *new_pending;
+    struct timing_bucket *entry = NULL;
+    CUevent end;
+
+    if (!timing->active || !lock()) return;
+
+    if (result != OPTIX_SUCCESS)
+    {
+        give_event(timing->context, timing->start);
+    }
+    else if (pending_count == TIMING_PENDING || (bucket && !(entry = find_bucket(bucket))) || !take_event(timing->context, &end))
+    {
+        give_event(timing->context, timing->start);
+        dropped++;
+    }
+    else if (cuda.pcuEventRecord(end, timing->stream) != CUDA_SUCCESS ||
+             !(new_pending = reallocarray(pending, pending_count + 1, sizeof(struct timing_pending))))
+    {
+        cuda.pcuEventDestroy(end);
+        give_event(timing->context, timing->start);
+        dropped++;
+    }
+    else
+    {
+        pending = new_pending;
+        pending[pending_count].context = timing->context;
+        pending[pending_count].start = timing->start;
+        pending[pending_count].end = end;
+        pending[pending_count].bucket = entry ? entry - buckets : 0;
+        pending[pending_count++].total_us = total_us;
+    }
+
+    unlock();
+}
+
+void gpu_timing_end(struct gpu_timing *timing, OptixResult result, const char *bucket)
+{
+    timing_queue(timing, result, bucket, NULL);
+}
+
+void gpu_timing_accumulate(struct gpu_timing *timing, OptixResult result, unsigned long long *total_us)
+{
+    timing_queue(timing, result, NULL, total_us);
+}
+
+void gpu_timing_start(struct gpu_timing *timing, CUstream stream)
+{
+    if (gpu_timing_enabled())
+        gpu_timing_begin(timing, stream);
+    else
+        timing->active = FALSE;
+}
+
+void gpu_timing_finish(struct gpu_timing *timing, OptixResult result, const char *format, ...)
+{
+    char bucket[96];
+    va_list args;
+
+    if (!timing->active) return;
+
+    va_start(args, format);
+    vsnprintf(bucket, sizeof(bucket), format, args);
+    va_end(args);
+
+    gpu_timing_end(timing, result, bucket);
+}
+
+static void print_bucket(FILE *file, const struct timing_bucket *bucket)
+{
+    fprintf(file, "%s: count %lu, mean %.3f ms, min %.3f ms, max %.3f ms\n", bucket->name, bucket->count,
+            bucket->count ? bucket->total_ms / bucket->count : 0.0, bucket->min_ms, bucket->max_ms);
+
+    for (unsigned int bin = 0; bin < TIMING_BINS; bin++)
+    {
+        if (bucket->bins[bin]) fprintf(file, "  >= %lu us: %lu\n", bin ? 1ul << bin : 0ul, bucket->bins[bin]);
+    }
+}
+
+void gpu_timing_stats(FILE *file)
+{
+    if (!buckets_count || !lock()) return;
+
+    fprintf(file, "\n[gpu timing]\npending %zu, dropped %lu\n", pending_count, dropped);
+
+    for (size_t i = 0; i < buckets_count; i++) print_bucket(file, &buckets[i]);
+
+    unlock();
+}
+
+void gpu_timing_close(void)
+{
+    if (harvester_running)
+    {
+        pthread_mutex_lock(&timing_lock);
+        harvester_stop = TRUE;
+        pthread_cond_signal(&harvester_cond);
+        pthread_mutex_unlock(&timing_lock);
+
+        pthread_join(harvester_thread, NULL);
+        harvester_running = FALSE;
+    }
+
+    if (!buckets_count && !pending_count) return;
+
+    harvest();
+
+    for (size_t i = 0; i < buckets_count; i++)
+    {
+        WARN("GPU time of %s: %lu calls, mean %.3f ms, min %.3f ms, max %.3f ms\n", buckets[i].name, buckets[i].count,
+             buckets[i].count ? buckets[i].total_ms / buckets[i].count : 0.0, buckets[i].min_ms, buckets[i].max_ms);
+    }
+
+    if (pending_count || dropped) WARN("%zu GPU timings still pending, %lu dropped\n", pending_count, dropped);
+
+    // the CUDA contexts may already be gone at process exit, leave the events to the driver
+
+    free(buckets);
+    free(idle_events);
+    free(pending);
+    buckets = NULL;
+    idle_events = NULL;
+    pending = NULL;
+    buckets_count = idle_events_count = pending_count = 0;
+}
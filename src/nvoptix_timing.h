@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "nvoptix_cuda.h"
+
+// asynchronous GPU timing (nvoptix_timing.c)
+//
+// Work enqueued by a relayed call is bracketed with a pair of CUDA events on the caller's
+// stream, taken from a pool of recycled events. Finished pairs are collected with
+// cuEventQuery by a background thread, the calling thread never waits for the GPU. Elapsed
+// times are kept per named bucket as a log2 histogram, in the stats file and logged on unload,
+// or added up in a counter of the caller (gpu_timing_accumulate).
+//
+// With `gpu_timing=1` launches are timed per pipeline and launch size, accel builds per
+// build input type and operation, compactions and micromap builds per kind.
+
+struct gpu_timing
+{
+    _Bool active;
+    CUcontext context;
+    CUstream stream;
+    CUevent start;
+};
+
+BOOL gpu_timing_begin(struct gpu_timing *timing, CUstream stream);
+void gpu_timing_end(struct gpu_timing *timing, OptixResult result, const char *bucket);
+void gpu_timing_accumulate(struct gpu_timing *timing, OptixResult result, unsigned long long *total_us);
+_Bool gpu_timing_enabled(void);
+void gpu_timing_start(struct gpu_timing *timing, CUstream stream);
+void gpu_timing_finish(struct gpu_timing *timing, OptixResult result, const char *format, ...) __attribute__((format(printf, 3, 4)));
+void gpu_timing_close(void);
@@ -0,0 +1,75 @@
+#pragma once
+
+// the Unix calls between the PE nvoptix.dll of a unixlib build, nvoptix_pe.c, and the relay
+// as its Unix side, nvoptix.so. OptiX is 64-bit only, both sides share the address space
+// and pointers are passed as they are. The calls of the entries of every ABI follow these,
+// see nvoptix_unix_calls.h.
+
+#include "winternl.h"
+#include "wine/unixlib.h"
+
+#include "nvoptix.h"
+
+enum nvoptix_unix_call
+{
+    unix_process_attach,
+    unix_process_detach,
+    unix_query_function_table,
+    unix_log_drain,
+    unix_entry_first,
+};
+
+// what a call returns instead of STATUS_SUCCESS when log messages wait for the PE side
+
+#define NVOPTIX_LOGS_PENDING STATUS_PENDING
+
+struct process_attach_params
+{
+    const char *executable;
+};
+
+struct process_detach_params
+{
+    BOOL terminating;
+};
+
+struct query_function_table_params
+{
+    int abiId;
+    unsigned int numOptions;
+    int *optionKeys;
+    const void **optionValues;
+    void *functionTable;
+    size_t sizeOfTable;
+    OptixResult ret;
+};
+
+// the Unix side can't call the application's log callback, the messages queue up there
+
+struct log_message
+{
+    struct log_message *next;
+    OptixLogCallback func;
+    void *data;
+    unsigned int level;
+    const char *tag;
+    const char *message;
+};
+
+// frees the messages delivered before, `done`, and takes the queue, oldest first
+
+struct log_drain_params
+{
+    struct log_message *done;
+    struct log_message *messages;
+};
+
+#ifdef WINE_UNIX_LIB
+
+NTSTATUS unixlib_process_attach(void *args);
+NTSTATUS unixlib_process_detach(void *args);
+NTSTATUS unixlib_query_function_table(void *args);
+NTSTATUS unixlib_log_drain(void *args);
+NTSTATUS log_status(void);
+
+#endif
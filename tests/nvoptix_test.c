@@ -0,0 +1,762 @@
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "windef.h"
+#include "winbase.h"
+
+#include "nvoptix.h"
+#include "nvoptix_abi.h"
+#include "nvoptix_accel.h"
+#include "nvoptix_denoiser.h"
+#include "nvoptix_93.h"
+
+// Runs nvoptix.dll against the stand-in libnvoptix.so.1 and libcuda.so.1 of this directory,
+// eg. `WINEDLLPATH=build/src:build/tests LD_LIBRARY_PATH=build/tests wine nvoptix-test.exe compaction`.
+// `meson test` and `meson test --benchmark` set that up when wine is found. Settings are read
+// once per process, benchmarks comparing them run every variant in a process of its own.
+
+enum
+{
+    #define ENTRY_INDEX(entry, index) index_ ## entry = index,
+    NVOPTIX_ABI_93_ENTRIES(ENTRY_INDEX)
+    #undef ENTRY_INDEX
+};
+
+// the relay hands out __cdecl thunks
+
+typedef OptixResult (__cdecl *query_function_table_fn)(int abiId, unsigned int numOptions, int *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
+typedef OptixResult (__cdecl *context_create_fn)(CUcontext fromContext, const void *options, OptixDeviceContext *context);
+typedef OptixResult (__cdecl *context_destroy_fn)(OptixDeviceContext context);
+typedef OptixResult (__cdecl *denoiser_create_fn)(OptixDeviceContext context, int modelKind, const OptixDenoiserOptions_93 *options, OptixDenoiser *returnHandle);
+typedef OptixResult (__cdecl *denoiser_destroy_fn)(OptixDenoiser handle);
+typedef OptixResult (__cdecl *denoiser_memory_fn)(const OptixDenoiser handle, unsigned int maximumInputWidth, unsigned int maximumInputHeight, void *returnSizes);
+typedef OptixResult (__cdecl *denoiser_setup_fn)(OptixDenoiser denoiser, CUstream stream, unsigned int inputWidth, unsigned int inputHeight, CUdeviceptr state,
+                                                 size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes);
+typedef OptixResult (__cdecl *denoiser_invoke_fn)(OptixDenoiser denoiser, CUstream stream, const void *params, CUdeviceptr denoiserState, size_t denoiserStateSizeInBytes,
+                                                  const void *guideLayer, const void *layers, unsigned int numLayers, unsigned int inputOffsetX, unsigned int inputOffsetY,
+                                                  CUdeviceptr scratch, size_t scratchSizeInBytes);
+typedef OptixResult (__cdecl *accel_build_fn)(OptixDeviceContext context, CUstream stream, const OptixAccelBuildOptions_93 *accelOptions, const void *buildInputs, unsigned int numBuildInputs,
+                                              CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes,
+                                              OptixTraversableHandle *outputHandle, const void *emittedProperties, unsigned int numEmittedProperties);
+typedef OptixResult (__cdecl *context_get_property_fn)(OptixDeviceContext context, int property, void *value, size_t sizeInBytes);
+typedef OptixResult (__cdecl *sbt_record_pack_header_fn)(OptixProgramGroup programGroup, void *sbtRecordHeaderHostPointer);
+typedef OptixResult (__cdecl *launch_fn)(OptixPipeline pipeline, CUstream stream, CUdeviceptr pipelineParams, size_t pipelineParamsSize, const void *sbt,
+                                         unsigned int width, unsigned int height, unsigned int depth);
+
+static HMODULE nvoptix;
+static void *table[NVOPTIX_ABI_93_SIZE];
+static void *libcuda;
+static int failures;
+
+#define ENTRY(type, entry) ((type)table[index_ ## entry])
+
+static void check(int condition, const char *format, ...)
+{
+    va_list args;
+
+    if (condition) return;
+
+    va_start(args, format);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, format, args);
+    va_end(args);
+
+    failures++;
+}
+
+static unsigned long long monotonic_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// runs this program again with the given arguments and returns its exit code
+
+static int spawn(const char *format, ...)
+{
+    STARTUPINFOA startup = { sizeof(startup) };
+    PROCESS_INFORMATION process;
+    char path[MAX_PATH], command[1024];
+    DWORD code = 1;
+    va_list args;
+    int len;
+
+    if (!GetModuleFileNameA(NULL, path, sizeof(path))) return 1;
+
+    len = snprintf(command, sizeof(command), "\"%s\" ", path);
+
+    va_start(args, format);
+    vsnprintf(command + len, sizeof(command) - len, format, args);
+    va_end(args);
+
+    fflush(stdout);
+
+    if (!CreateProcessA(path, command, NULL, NULL, TRUE, 0, NULL, NULL, &startup, &process))
+    {
+        fprintf(stderr, "Failed to run %s: %lu\n", command, (unsigned long)GetLastError());
+        return 1;
+    }
+
+    WaitForSingleObject(process.hProcess, INFINITE);
+    GetExitCodeProcess(process.hProcess, &code);
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+
+    return code;
+}
+
+// runs a native Linux program, eg. nvoptix-replay, with its output written to `output`
+
+static int run_native(const char *output, char *const argv[])
+{
+    posix_spawn_file_actions_t actions;
+    extern char **environ;
+    int status, ret;
+    pid_t pid;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, output, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+
+    ret = posix_spawn(&pid, argv[0], &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (ret)
+    {
+        fprintf(stderr, "Failed to run %s: %s\n", argv[0], strerror(ret));
+        return 1;
+    }
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) return 1;
+
+    return WEXITSTATUS(status);
+}
+
+static unsigned long long cuda_counter(const char *name)
+{
+    unsigned long long *counter = dlsym(libcuda, name);
+
+    return counter ? *counter : 0;
+}
+
+// the profile is read when the DLL is attached, settings come from the environment only
+
+static BOOL load_nvoptix(const char *settings[])
+{
+    setenv("WINE_NVOPTIX_PROFILE", "/dev/null", 1);
+
+    for (unsigned int i = 0; settings[i]; i += 2) setenv(settings[i], settings[i + 1], 1);
+
+    if (!(nvoptix = LoadLibraryA("nvoptix.dll")))
+    {
+        fprintf(stderr, "Failed to load nvoptix.dll: %lu\n", (unsigned long)GetLastError());
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static BOOL query_relay(void)
+{
+    query_function_table_fn query;
+    OptixResult result;
+
+    if (!(query = (query_function_table_fn)GetProcAddress(nvoptix, "optixQueryFunctionTable")))
+    {
+        fprintf(stderr, "No optixQueryFunctionTable in nvoptix.dll\n");
+        return FALSE;
+    }
+
+    if ((result = query(93, 0, NULL, NULL, table, sizeof(table))) != OPTIX_SUCCESS)
+    {
+        fprintf(stderr, "optixQueryFunctionTable failed: %d\n", result);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static BOOL load_relay(const char *settings[])
+{
+    // keep the counters of the stand-in libcuda.so.1 alive past the relay's dlclose
+
+    if (!(libcuda = dlopen("libcuda.so.1", RTLD_NOW)))
+    {
+        fprintf(stderr, "Failed to load the stand-in libcuda.so.1: %s\n", dlerror());
+        return FALSE;
+    }
+
+    return load_nvoptix(settings) && query_relay();
+}
+
+static char *read_file(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char *data;
+    long size;
+
+    if (!file) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+
+    if ((data = calloc(1, size + 1)) && fread(data, 1, size, file) != (size_t)size)
+    {
+        free(data);
+        data = NULL;
+    }
+
+    fclose(file);
+    return data;
+}
+
+// a file for the relay to write to, removed again by check_file
+
+static BOOL temp_file(char *path, size_t size)
+{
+    int fd;
+
+    snprintf(path, size, "/tmp/nvoptix-test-XXXXXX");
+
+    if ((fd = mkstemp(path)) < 0)
+    {
+        fprintf(stderr, "Failed to create %s\n", path);
+        return FALSE;
+    }
+
+    close(fd);
+    return TRUE;
+}
+
+static void check_file(const char *path, const char *expected)
+{
+    char *data = read_file(path);
+
+    check(data && strstr(data, expected), "%s, expected:\n%s\ngot:\n%s", path, expected, data ? data : "(missing)\n");
+
+    free(data);
+    unlink(path);
+}
+
+// builds with allow_compaction get the compacted handle of a copy in the relay's pool, which
+// is capped at 4 MiB here; a released copy is reused only once its event has completed
+
+static OptixResult build_accel(OptixDeviceContext context, unsigned int flags, int operation, uintptr_t buffer, OptixTraversableHandle *handle)
+{
+    OptixAccelBuildOptions_93 options = { flags, operation };
+    struct accel_build_input input = { OPTIX_BUILD_INPUT_TYPE_TRIANGLES };
+
+    return ENTRY(accel_build_fn, optixAccelBuild)(context, NULL, &options, &input, 1, (CUdeviceptr)0x1000, 0x1000,
+                                                  (CUdeviceptr)(buffer << 24), 1 << 20, handle, NULL, 0);
+}
+
+static int test_compaction(int argc, char *argv[])
+{
+    char stats_path[64];
+    const char *settings[] = { "WINE_NVOPTIX_ACCEL_COMPACTION", "1", "WINE_NVOPTIX_ACCEL_COMPACTION_POOL_MB", "4",
+                               "WINE_NVOPTIX_STATS_FILE", stats_path, "WINE_NVOPTIX_STATS_INTERVAL_MS", "0", NULL };
+    OptixTraversableHandle handle, handles[9];
+    OptixDeviceContext context;
+    char expected[160];
+
+    if (!temp_file(stats_path, sizeof(stats_path)) || !load_relay(settings)) return 1;
+
+    check(ENTRY(context_create_fn, optixDeviceContextCreate)(NULL, NULL, &context) == OPTIX_SUCCESS, "optixDeviceContextCreate\n");
+
+    // eight 1 MiB structures compacting to 512 KiB fill the pool
+
+    for (uintptr_t i = 1; i <= 8; i++)
+    {
+        check(build_accel(context, OPTIX_BUILD_FLAG_ALLOW_COMPACTION, OPTIX_BUILD_OPERATION_BUILD, i, &handles[i]) == OPTIX_SUCCESS, "optixAccelBuild %u\n", (unsigned int)i);
+        check(handles[i] && handles[i] != i << 24, "build %u returned handle %#llx\n", (unsigned int)i, (unsigned long long)handles[i]);
+    }
+
+    build_accel(context, OPTIX_BUILD_FLAG_ALLOW_COMPACTION, OPTIX_BUILD_OPERATION_BUILD, 9, &handle);
+    check(handle == 9 << 24, "build over the pool limit returned handle %#llx\n", (unsigned long long)handle);
+
+    // a build without compaction into the first buffer releases its copy, which is still in use
+    // for the next build and reused by the one after
+
+    build_accel(context, 0, OPTIX_BUILD_OPERATION_BUILD, 1, &handle);
+    check(handle == 1 << 24, "build without compaction returned handle %#llx\n", (unsigned long long)handle);
+
+    build_accel(context, OPTIX_BUILD_FLAG_ALLOW_COMPACTION, OPTIX_BUILD_OPERATION_BUILD, 10, &handle);
+    check(handle == 10 << 24, "build before the release completed returned handle %#llx\n", (unsigned long long)handle);
+
+    build_accel(context, OPTIX_BUILD_FLAG_ALLOW_COMPACTION, OPTIX_BUILD_OPERATION_BUILD, 11, &handle);
+    check(handle == handles[1], "build after the release completed returned handle %#llx, not %#llx\n", (unsigned long long)handle, (unsigned long long)handles[1]);
+
+    // updates go to the application's own structure
+
+    build_accel(context, OPTIX_BUILD_FLAG_ALLOW_COMPACTION | OPTIX_BUILD_FLAG_ALLOW_UPDATE, OPTIX_BUILD_OPERATION_UPDATE, 2, &handle);
+    check(handle == 2 << 24, "update returned handle %#llx\n", (unsigned long long)handle);
+
+    // one size slab and eight pool blocks, every compacting build waits for its size only
+
+    check(cuda_counter("stub_cuda_allocs") == 9, "%llu device allocations\n", cuda_counter("stub_cuda_allocs"));
+    check(cuda_counter("stub_cuda_syncs") == 11, "%llu synchronizations\n", cuda_counter("stub_cuda_syncs"));
+
+    ENTRY(context_destroy_fn, optixDeviceContextDestroy)(context);
+
+    FreeLibrary(nvoptix);
+
+    // the copies of a destroyed context are released, the pool keeps its memory
+
+    snprintf(expected, sizeof(expected), "compacted 9, skipped 2, failed 0\nlive 0, 0 bytes compacted to 0 bytes, pool %u bytes, high-water %u bytes\n",
+             4 << 20, 4 << 20);
+
+    check_file(stats_path, expected);
+
+    return failures != 0;
+}
+
+// a variable of a stand-in library the relay has loaded
+
+static void *stub_symbol(const char *library, const char *name)
+{
+    void *handle = dlopen(library, RTLD_NOW | RTLD_NOLOAD), *symbol;
+
+    if (!handle) return NULL;
+
+    symbol = dlsym(handle, name);
+
+    // the relay keeps its own reference
+
+    dlclose(handle);
+    return symbol;
+}
+
+static unsigned long long nvoptix_counter(const char *name)
+{
+    unsigned long long *counter = stub_symbol("libnvoptix.so.1", name);
+
+    return counter ? *counter : 0;
+}
+
+// every relayed call opens a range in the domain and category of its subsystem, which is closed
+// when the thunk returns, also when the call fails
+
+static void check_nvtx(unsigned long long calls, const char *range)
+{
+    unsigned long long *pushes = stub_symbol("libstub_nvtx.so", "stub_nvtx_pushes");
+    unsigned long long *pops = stub_symbol("libstub_nvtx.so", "stub_nvtx_pops");
+    unsigned long long *mismatched = stub_symbol("libstub_nvtx.so", "stub_nvtx_mismatched");
+    const char *last = stub_symbol("libstub_nvtx.so", "stub_nvtx_last");
+
+    if (!pushes || !pops || !mismatched || !last)
+    {
+        check(0, "libstub_nvtx.so is not loaded\n");
+        return;
+    }
+
+    check(*pushes == calls && *pops == calls, "%llu ranges pushed and %llu popped after %llu calls\n", *pushes, *pops, calls);
+    check(!*mismatched, "%llu pops didn't close the innermost range of their domain\n", *mismatched);
+    check(!strcmp(last, range), "last range %s, not %s\n", last, range);
+}
+
+static int test_nvtx(int argc, char *argv[])
+{
+    const char *settings[] = { "WINE_NVOPTIX_NVTX", "1", "WINE_NVOPTIX_NVTX_LIBRARY", "libstub_nvtx.so", NULL };
+    OptixDenoiserOptions_93 options = { 0 };
+    unsigned long long *domains;
+    OptixDeviceContext context;
+    OptixDenoiser denoiser;
+    OptixResult result;
+
+    if (!load_relay(settings)) return 1;
+
+    // the domains are created with the first range
+
+    check(ENTRY(context_create_fn, optixDeviceContextCreate)(NULL, NULL, &context) == OPTIX_SUCCESS, "optixDeviceContextCreate\n");
+    check_nvtx(1, "OptiX context/context/optixDeviceContextCreate");
+
+    domains = stub_symbol("libstub_nvtx.so", "stub_nvtx_domains");
+    check(domains && *domains == 6, "%llu NVTX domains\n", domains ? *domains : 0);
+
+    check(ENTRY(denoiser_create_fn, optixDenoiserCreate)(context, 0x2322, &options, &denoiser) == OPTIX_SUCCESS, "optixDenoiserCreate\n");
+    check_nvtx(2, "OptiX denoiser/denoiser/optixDenoiserCreate");
+
+    // the stand-in rejects a setup without state
+
+    result = ENTRY(denoiser_setup_fn, optixDenoiserSetup)(denoiser, NULL, 16, 16, 0, 0, 0, 0);
+    check(result == OPTIX_ERROR_INVALID_VALUE, "optixDenoiserSetup without state returned %d\n", result);
+    check_nvtx(3, "OptiX denoiser/denoiser/optixDenoiserSetup");
+
+    ENTRY(denoiser_destroy_fn, optixDenoiserDestroy)(denoiser);
+    ENTRY(context_destroy_fn, optixDeviceContextDestroy)(context);
+    check_nvtx(5, "OptiX context/context/optixDeviceContextDestroy");
+
+    FreeLibrary(nvoptix);
+
+    return failures != 0;
+}
+
+// a capture recorded through the stand-in library replays with nvoptix-replay --no-gpu: the
+// creates and destroys are replayed, the accel build is counted but skipped
+
+static int test_replay(int argc, char *argv[])
+{
+    char capture_path[64], output_path[64];
+    const char *settings[] = { "WINE_NVOPTIX_CAPTURE_FILE", capture_path, NULL };
+    OptixDenoiserOptions_93 options = { 0 };
+    OptixTraversableHandle handle;
+    OptixDeviceContext context;
+    OptixDenoiser denoiser;
+    int ret;
+
+    if (argc != 1 || !temp_file(capture_path, sizeof(capture_path)) || !temp_file(output_path, sizeof(output_path)) || !load_relay(settings))
+        return 1;
+
+    check(ENTRY(context_create_fn, optixDeviceContextCreate)(NULL, NULL, &context) == OPTIX_SUCCESS, "optixDeviceContextCreate\n");
+    check(ENTRY(denoiser_create_fn, optixDenoiserCreate)(context, 0x2322, &options, &denoiser) == OPTIX_SUCCESS, "optixDenoiserCreate\n");
+    check(build_accel(context, 0, OPTIX_BUILD_OPERATION_BUILD, 1, &handle) == OPTIX_SUCCESS, "optixAccelBuild\n");
+    check(ENTRY(denoiser_destroy_fn, optixDenoiserDestroy)(denoiser) == OPTIX_SUCCESS, "optixDenoiserDestroy\n");
+    check(ENTRY(context_destroy_fn, optixDeviceContextDestroy)(context) == OPTIX_SUCCESS, "optixDeviceContextDestroy\n");
+
+    // unloading writes the rest of the capture
+
+    FreeLibrary(nvoptix);
+
+    ret = run_native(output_path, (char *[]){ argv[0], (char *)"--no-gpu", capture_path, NULL });
+    check(!ret, "nvoptix-replay exited with %d\n", ret);
+
+    check_file(output_path, "4 calls replayed (0 failed)");
+    unlink(capture_path);
+
+    return failures != 0;
+}
+
+// a failed query is retried, a successful one answers every later query without asking the
+// native library, and queries with options always reach it
+
+static int test_query(int argc, char *argv[])
+{
+    const char *settings[] = { "NVOPTIX_STUB_QUERY_FAILURES", "1", NULL };
+    int keys[1] = { 0 };
+    const void *values[1] = { NULL };
+    query_function_table_fn query;
+    OptixResult result;
+
+    if (!load_nvoptix(settings)) return 1;
+
+    if (!(query = (query_function_table_fn)GetProcAddress(nvoptix, "optixQueryFunctionTable")))
+    {
+        fprintf(stderr, "No optixQueryFunctionTable in nvoptix.dll\n");
+        return 1;
+    }
+
+    result = query(93, 0, NULL, NULL, table, sizeof(table));
+    check(result == OPTIX_ERROR_INTERNAL_ERROR, "first query returned %d\n", result);
+
+    for (unsigned int i = 0; i < 10; i++)
+    {
+        result = query(93, 0, NULL, NULL, table, sizeof(table));
+        check(result == OPTIX_SUCCESS, "query %u returned %d\n", i + 2, result);
+    }
+
+    check(nvoptix_counter("stub_nvoptix_queries") == 2, "%llu native queries\n", nvoptix_counter("stub_nvoptix_queries"));
+
+    result = query(93, 1, keys, values, table, sizeof(table));
+    check(result == OPTIX_SUCCESS, "query with options returned %d\n", result);
+    check(nvoptix_counter("stub_nvoptix_queries") == 3, "%llu native queries\n", nvoptix_counter("stub_nvoptix_queries"));
+    check(nvoptix_counter("stub_nvoptix_last_options") == 1, "%llu options passed on\n", nvoptix_counter("stub_nvoptix_last_options"));
+
+    FreeLibrary(nvoptix);
+
+    return failures != 0;
+}
+
+// threads querying the function table at once, as plugins of one application do
+
+#define QUERY_THREADS 8
+#define QUERY_ITERATIONS 100000
+
+static DWORD WINAPI query_thread(void *arg)
+{
+    query_function_table_fn query = arg;
+    void *thread_table[NVOPTIX_ABI_93_SIZE];
+    DWORD failed = 0;
+
+    for (unsigned int i = 0; i < QUERY_ITERATIONS; i++)
+    {
+        if (query(93, 0, NULL, NULL, thread_table, sizeof(thread_table)) != OPTIX_SUCCESS ||
+            memcmp(thread_table, table, sizeof(table)))
+            failed++;
+    }
+
+    return failed;
+}
+
+static int bench_query(int argc, char *argv[])
+{
+    const char *settings[] = { NULL };
+    HANDLE threads[QUERY_THREADS];
+    query_function_table_fn query;
+    unsigned long long start, elapsed;
+    DWORD failed, total_failed = 0;
+
+    if (!load_relay(settings)) return 1;
+
+    query = (query_function_table_fn)GetProcAddress(nvoptix, "optixQueryFunctionTable");
+
+    start = monotonic_ns();
+
+    for (unsigned int i = 0; i < QUERY_THREADS; i++)
+    {
+        if (!(threads[i] = CreateThread(NULL, 0, query_thread, query, 0, NULL)))
+        {
+            fprintf(stderr, "Failed to start a query thread: %lu\n", (unsigned long)GetLastError());
+            return 1;
+        }
+    }
+
+    WaitForMultipleObjects(QUERY_THREADS, threads, TRUE, INFINITE);
+
+    elapsed = monotonic_ns() - start;
+
+    for (unsigned int i = 0; i < QUERY_THREADS; i++)
+    {
+        GetExitCodeThread(threads[i], &failed);
+        CloseHandle(threads[i]);
+        total_failed += failed;
+    }
+
+    check(!total_failed, "%lu queries failed or returned another table\n", (unsigned long)total_failed);
+    check(nvoptix_counter("stub_nvoptix_queries") == 1, "%llu native queries\n", nvoptix_counter("stub_nvoptix_queries"));
+
+    printf("%u threads x %u queries: %8.1f ns per query, %llu native queries\n", QUERY_THREADS, QUERY_ITERATIONS,
+           (double)elapsed / QUERY_ITERATIONS, nvoptix_counter("stub_nvoptix_queries"));
+
+    FreeLibrary(nvoptix);
+
+    return failures != 0;
+}
+
+// the cost of a thunk: calls through the relay's table against the same calls made natively to
+// the stand-in, for a cold entry and two hot ones. `thunks-hot` runs it against a hot_thunks build.
+// In a unixlib build every call is a Unix call, `thunks-winelib` runs it against the direct calls
+// of a winelib build of the same tree.
+
+#define THUNK_CALLS 10000000
+
+static int bench_thunks(int argc, char *argv[])
+{
+    const char *settings[] = { NULL };
+    OptixResult (*native_query)(int abiId, unsigned int numOptions, int *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
+    OptixFunctionTable_93 native;
+    unsigned long long start, relay_ns[3], native_ns[3];
+    char header[32];
+    unsigned char sbt[64] = { 0 };
+    unsigned int value;
+    void *handle;
+
+    if (!load_relay(settings)) return 1;
+
+    if (!(handle = dlopen("libnvoptix.so.1", RTLD_NOW | RTLD_NOLOAD)) ||
+        !(native_query = dlsym(handle, "optixQueryFunctionTable")) ||
+        native_query(93, 0, NULL, NULL, &native, sizeof(native)) != OPTIX_SUCCESS)
+    {
+        fprintf(stderr, "Failed to query the stand-in libnvoptix.so.1\n");
+        return 1;
+    }
+
+    start = monotonic_ns();
+    for (unsigned int i = 0; i < THUNK_CALLS; i++) ENTRY(context_get_property_fn, optixDeviceContextGetProperty)(NULL, 0, &value, sizeof(value));
+    relay_ns[0] = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (unsigned int i = 0; i < THUNK_CALLS; i++) ENTRY(sbt_record_pack_header_fn, optixSbtRecordPackHeader)(NULL, header);
+    relay_ns[1] = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (unsigned int i = 0; i < THUNK_CALLS; i++) ENTRY(launch_fn, optixLaunch)(NULL, NULL, 0, 0, sbt, 1, 1, 1);
+    relay_ns[2] = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (unsigned int i = 0; i < THUNK_CALLS; i++) native.optixDeviceContextGetProperty(NULL, 0, &value, sizeof(value));
+    native_ns[0] = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (unsigned int i = 0; i < THUNK_CALLS; i++) native.optixSbtRecordPackHeader(NULL, header);
+    native_ns[1] = monotonic_ns() - start;
+
+    start = monotonic_ns();
+    for (unsigned int i = 0; i < THUNK_CALLS; i++) native.optixLaunch(NULL, NULL, 0, 0, sbt, 1, 1, 1);
+    native_ns[2] = monotonic_ns() - start;
+
+    dlclose(handle);
+
+    printf("%-30s %8.1f ns per call, %8.1f ns native\n", "optixDeviceContextGetProperty", (double)relay_ns[0] / THUNK_CALLS, (double)native_ns[0] / THUNK_CALLS);
+    printf("%-30s %8.1f ns per call, %8.1f ns native\n", "optixSbtRecordPackHeader", (double)relay_ns[1] / THUNK_CALLS, (double)native_ns[1] / THUNK_CALLS);
+    printf("%-30s %8.1f ns per call, %8.1f ns native\n", "optixLaunch", (double)relay_ns[2] / THUNK_CALLS, (double)native_ns[2] / THUNK_CALLS);
+
+    FreeLibrary(nvoptix);
+
+    return failures != 0;
+}
+
+// a frame loop that sets the denoiser up before every invoke, as many applications do
+
+#define DENOISER_FRAMES 100
+
+static int bench_denoiser_frames(int argc, char *argv[])
+{
+    const char *settings[] = { "WINE_NVOPTIX_DENOISER_SETUP_SKIP", argc == 3 ? argv[2] : "0", NULL };
+    unsigned int width = argc == 3 ? atoi(argv[0]) : 0, height = argc == 3 ? atoi(argv[1]) : 0;
+    OptixDenoiserLayer_93 layer = { { NULL, width, height, width * 8, 8 } };
+    OptixDenoiserGuideLayer_93 guide = { { 0 } };
+    OptixDenoiserOptions_93 options = { 0 };
+    unsigned long long setup_ns = 0, start;
+    unsigned char params[32] = { 0 };
+    struct denoiser_sizes sizes;
+    OptixDeviceContext context;
+    CUdeviceptr state, scratch;
+    OptixDenoiser denoiser;
+    CUresult (*alloc)(CUdeviceptr *ptr, size_t size);
+
+    if (!width || !height || !load_relay(settings)) return 1;
+
+    if (!(*(void **)&alloc = dlsym(libcuda, "cuMemAlloc_v2"))) return 1;
+
+    if (ENTRY(context_create_fn, optixDeviceContextCreate)(NULL, NULL, &context) != OPTIX_SUCCESS ||
+        ENTRY(denoiser_create_fn, optixDenoiserCreate)(context, 0x2322, &options, &denoiser) != OPTIX_SUCCESS ||
+        ENTRY(denoiser_memory_fn, optixDenoiserComputeMemoryResources)(denoiser, width, height, &sizes) != OPTIX_SUCCESS ||
+        alloc(&state, sizes.stateSizeInBytes) || alloc(&scratch, sizes.withoutOverlapScratchSizeInBytes))
+    {
+        fprintf(stderr, "Failed to create a %ux%u denoiser\n", width, height);
+        return 1;
+    }
+
+    start = monotonic_ns();
+
+    for (unsigned int i = 0; i < DENOISER_FRAMES; i++)
+    {
+        unsigned long long setup_start = monotonic_ns();
+
+        check(ENTRY(denoiser_setup_fn, optixDenoiserSetup)(denoiser, NULL, width, height, state, sizes.stateSizeInBytes,
+                                                           scratch, sizes.withoutOverlapScratchSizeInBytes) == OPTIX_SUCCESS, "optixDenoiserSetup\n");
+
+        setup_ns += monotonic_ns() - setup_start;
+
+        check(ENTRY(denoiser_invoke_fn, optixDenoiserInvoke)(denoiser, NULL, params, state, sizes.stateSizeInBytes, &guide, &layer, 1, 0, 0,
+                                                             scratch, sizes.withoutOverlapScratchSizeInBytes) == OPTIX_SUCCESS, "optixDenoiserInvoke\n");
+    }
+
+    printf("%4ux%-4u setup skip %s: %8.3f ms per frame, %8.3f ms of it in setup\n", width, height, argv[2],
+           (monotonic_ns() - start) / 1e6 / DENOISER_FRAMES, setup_ns / 1e6 / DENOISER_FRAMES);
+
+    ENTRY(denoiser_destroy_fn, optixDenoiserDestroy)(denoiser);
+    ENTRY(context_destroy_fn, optixDeviceContextDestroy)(context);
+
+    return failures != 0;
+}
+
+static int bench_denoiser(int argc, char *argv[])
+{
+    static const unsigned int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+    int ret = 0;
+
+    for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        ret |= spawn("denoiser-frames %u %u 0", sizes[i][0], sizes[i][1]);
+        ret |= spawn("denoiser-frames %u %u 1", sizes[i][0], sizes[i][1]);
+    }
+
+    return ret;
+}
+
+// loading nvoptix.dll and the first optixQueryFunctionTable in each load_mode, with the
+// stand-in library taking STARTUP_LOAD_MS to load like the driver does and the application
+// working for a while in between
+
+#define STARTUP_LOAD_MS 200
+
+static int bench_startup_run(int argc, char *argv[])
+{
+    const char *settings[] = { "WINE_NVOPTIX_LOAD_MODE", argc == 3 ? argv[0] : "attach", "NVOPTIX_STUB_LOAD_MS", argc == 3 ? argv[1] : "0", NULL };
+    unsigned int work_ms = argc == 3 ? atoi(argv[2]) : 0;
+    unsigned long long start, load_ns, query_ns;
+
+    start = monotonic_ns();
+
+    if (!load_nvoptix(settings)) return 1;
+
+    load_ns = monotonic_ns() - start;
+
+    usleep(work_ms * 1000);
+
+    start = monotonic_ns();
+
+    if (!query_relay()) return 1;
+
+    query_ns = monotonic_ns() - start;
+
+    printf("%-10s with %3u ms of work: LoadLibrary %8.3f ms, first query %8.3f ms, %8.3f ms waited in total\n",
+           settings[1], work_ms, load_ns / 1e6, query_ns / 1e6, (load_ns + query_ns) / 1e6);
+
+    FreeLibrary(nvoptix);
+
+    return 0;
+}
+
+static int bench_startup(int argc, char *argv[])
+{
+    static const char *modes[] = { "attach", "lazy", "background" };
+    static const unsigned int work_ms[] = { 0, STARTUP_LOAD_MS / 2, STARTUP_LOAD_MS * 2 };
+    int ret = 0;
+
+    for (unsigned int i = 0; i < sizeof(work_ms) / sizeof(work_ms[0]); i++)
+    {
+        for (unsigned int j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+            ret |= spawn("startup-run %s %u %u", modes[j], STARTUP_LOAD_MS, work_ms[i]);
+    }
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct
+    {
+        const char *name;
+        int (*run)(int argc, char *argv[]);
+    }
+    commands[] =
+    {
+        { "compaction", test_compaction },
+        { "denoiser", bench_denoiser },
+        { "denoiser-frames", bench_denoiser_frames },
+        { "nvtx", test_nvtx },
+        { "query", test_query },
+        { "query-threads", bench_query },
+        { "replay", test_replay },
+        { "startup", bench_startup },
+        { "startup-run", bench_startup_run },
+        { "thunks", bench_thunks },
+    };
+
+    for (unsigned int i = 0; argc >= 2 && i < sizeof(commands) / sizeof(commands[0]); i++)
+    {
+        if (!strcmp(argv[1], commands[i].name)) return commands[i].run(argc - 2, argv + 2);
+    }
+
+    fprintf(stderr, "usage: nvoptix-test.exe <");
+
+    for (unsigned int i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+        fprintf(stderr, "%s%s", i ? "|" : "", commands[i].name);
+
+    fprintf(stderr, "> [arguments]\n");
+    return 2;
+}
@@ -0,0 +1,111 @@
+#include <stdlib.h>
+#include <string.h>
+
+// stand-in libcuda.so.1: device memory is host memory, work completes when it is queued
+// and every event reports CUDA_ERROR_NOT_READY once before it completes, so the relay's
+// asynchronous paths are taken. The counters are read by nvoptix-test through dlsym.
+
+typedef int CUresult;
+typedef struct CUctx_st *CUcontext;
+typedef struct CUstream_st *CUstream;
+typedef void *CUdeviceptr;
+
+#define CUDA_SUCCESS 0
+#define CUDA_ERROR_INVALID_VALUE 1
+#define CUDA_ERROR_OUT_OF_MEMORY 2
+#define CUDA_ERROR_NOT_READY 600
+
+struct CUevent_st
+{
+    int not_ready;
+};
+
+static int stub_context;
+
+unsigned long long stub_cuda_syncs;
+unsigned long long stub_cuda_allocs;
+unsigned long long stub_cuda_alloc_bytes;
+
+CUresult cuCtxGetCurrent(CUcontext *ctx)
+{
+    *ctx = (CUcontext)&stub_context;
+    return CUDA_SUCCESS;
+}
+
+CUresult cuStreamSynchronize(CUstream stream)
+{
+    __atomic_fetch_add(&stub_cuda_syncs, 1, __ATOMIC_RELAXED);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuMemAlloc_v2(CUdeviceptr *ptr, size_t size)
+{
+    if (!(*ptr = calloc(1, size))) return CUDA_ERROR_OUT_OF_MEMORY;
+
+    __atomic_fetch_add(&stub_cuda_allocs, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stub_cuda_alloc_bytes, size, __ATOMIC_RELAXED);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuMemFree_v2(CUdeviceptr ptr)
+{
+    free(ptr);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuMemAllocHost_v2(void **ptr, size_t size)
+{
+    return (*ptr = calloc(1, size)) ? CUDA_SUCCESS : CUDA_ERROR_OUT_OF_MEMORY;
+}
+
+// synchronous copies wait for the device
+
+CUresult cuMemcpyDtoH_v2(void *dst, CUdeviceptr src, size_t size)
+{
+    __atomic_fetch_add(&stub_cuda_syncs, 1, __ATOMIC_RELAXED);
+    memcpy(dst, src, size);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuMemcpyDtoHAsync_v2(void *dst, CUdeviceptr src, size_t size, CUstream stream)
+{
+    memcpy(dst, src, size);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventCreate(struct CUevent_st **event, unsigned int flags)
+{
+    return (*event = calloc(1, sizeof(**event))) ? CUDA_SUCCESS : CUDA_ERROR_OUT_OF_MEMORY;
+}
+
+CUresult cuEventDestroy_v2(struct CUevent_st *event)
+{
+    free(event);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventRecord(struct CUevent_st *event, CUstream stream)
+{
+    __atomic_store_n(&event->not_ready, 1, __ATOMIC_RELAXED);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventQuery(struct CUevent_st *event)
+{
+    return __atomic_exchange_n(&event->not_ready, 0, __ATOMIC_RELAXED) ? CUDA_ERROR_NOT_READY : CUDA_SUCCESS;
+}
+
+CUresult cuEventSynchronize(struct CUevent_st *event)
+{
+    __atomic_fetch_add(&stub_cuda_syncs, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&event->not_ready, 0, __ATOMIC_RELAXED);
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventElapsedTime(float *ms, struct CUevent_st *start, struct CUevent_st *end)
+{
+    if (!start || !end) return CUDA_ERROR_INVALID_VALUE;
+
+    *ms = 0.25f;
+    return CUDA_SUCCESS;
+}
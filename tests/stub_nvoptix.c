@@ -0,0 +1,163 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// the per-ABI headers also declare the relay entry points, which are unused here
+
+#ifndef __cdecl
+#define __cdecl
+#endif
+
+#include "nvoptix.h"
+#include "nvoptix_93.h"
+
+// stand-in libnvoptix.so.1 implementing ABI 93 without a GPU, for the tests and benchmarks
+// of nvoptix-test. Device pointers are the host pointers of the stand-in libcuda.so.1.
+
+#define OPTIX_PROPERTY_TYPE_COMPACTED_SIZE 0x2181
+
+// NVOPTIX_STUB_LOAD_MS makes loading the library take as long as the driver's does
+
+__attribute__((constructor)) static void stub_load_delay(void)
+{
+    const char *value = getenv("NVOPTIX_STUB_LOAD_MS");
+    struct timespec delay;
+    long ms;
+
+    if (!value || (ms = atol(value)) <= 0) return;
+
+    delay.tv_sec = ms / 1000;
+    delay.tv_nsec = (ms % 1000) * 1000000;
+
+    while (nanosleep(&delay, &delay));
+}
+
+struct emit_desc
+{
+    CUdeviceptr result;
+    int type;
+};
+
+// common beginning of OptixDenoiserSizes
+
+struct denoiser_sizes
+{
+    size_t stateSizeInBytes;
+    size_t withOverlapScratchSizeInBytes;
+    size_t withoutOverlapScratchSizeInBytes;
+    unsigned int overlapWindowSizeInPixels;
+};
+
+static OptixResult stub_success(void)
+{
+    return OPTIX_SUCCESS;
+}
+
+static OptixResult stub_context_create(CUcontext fromContext, const OptixDeviceContextOptions_93 *options, OptixDeviceContext *context)
+{
+    return (*context = calloc(1, 64)) ? OPTIX_SUCCESS : OPTIX_ERROR_HOST_OUT_OF_MEMORY;
+}
+
+static OptixResult stub_destroy(void *object)
+{
+    free(object);
+    return OPTIX_SUCCESS;
+}
+
+// the compacted size is half of the output buffer
+
+static OptixResult stub_accel_build(OptixDeviceContext context, CUstream stream, const OptixAccelBuildOptions_93 *accelOptions, const void *buildInputs, unsigned int numBuildInputs,
+                                    CUdeviceptr tempBuffer, size_t tempBufferSizeInBytes, CUdeviceptr outputBuffer, size_t outputBufferSizeInBytes,
+                                    OptixTraversableHandle *outputHandle, const void *emittedProperties, unsigned int numEmittedProperties)
+{
+    const struct emit_desc *emitted = emittedProperties;
+
+    if (!accelOptions || !outputHandle) return OPTIX_ERROR_INVALID_VALUE;
+
+    for (unsigned int i = 0; i < numEmittedProperties; i++)
+    {
+        if (emitted[i].type == OPTIX_PROPERTY_TYPE_COMPACTED_SIZE) *(uint64_t *)emitted[i].result = outputBufferSizeInBytes / 2;
+    }
+
+    *outputHandle = (OptixTraversableHandle)(uintptr_t)outputBuffer;
+    return OPTIX_SUCCESS;
+}
+
+static OptixResult stub_accel_compact(OptixDeviceContext context, CUstream stream, OptixTraversableHandle inputHandle, CUdeviceptr outputBuffer,
+                                      size_t outputBufferSizeInBytes, OptixTraversableHandle *outputHandle)
+{
+    *outputHandle = (OptixTraversableHandle)(uintptr_t)outputBuffer;
+    return OPTIX_SUCCESS;
+}
+
+static OptixResult stub_denoiser_create(OptixDeviceContext context, int modelKind, const OptixDenoiserOptions_93 *options, OptixDenoiser *returnHandle)
+{
+    return (*returnHandle = calloc(1, 64)) ? OPTIX_SUCCESS : OPTIX_ERROR_HOST_OUT_OF_MEMORY;
+}
+
+// 4 bytes of state and 16 of scratch per pixel, enough for setup to cost what a resolution does
+
+static OptixResult stub_denoiser_memory(const OptixDenoiser handle, unsigned int maximumInputWidth, unsigned int maximumInputHeight, void *returnSizes)
+{
+    struct denoiser_sizes *sizes = returnSizes;
+    size_t pixels = (size_t)maximumInputWidth * maximumInputHeight;
+
+    sizes->stateSizeInBytes = pixels * 4;
+    sizes->withOverlapScratchSizeInBytes = pixels * 16;
+    sizes->withoutOverlapScratchSizeInBytes = pixels * 16;
+    sizes->overlapWindowSizeInPixels = 0;
+
+    return OPTIX_SUCCESS;
+}
+
+// setup initializes the whole state, which is what makes repeating it expensive
+
+static OptixResult stub_denoiser_setup(OptixDenoiser denoiser, CUstream stream, unsigned int inputWidth, unsigned int inputHeight, CUdeviceptr state,
+                                       size_t stateSizeInBytes, CUdeviceptr scratch, size_t scratchSizeInBytes)
+{
+    if (!state || stateSizeInBytes < (size_t)inputWidth * inputHeight * 4) return OPTIX_ERROR_INVALID_VALUE;
+
+    memset(state, 0, stateSizeInBytes);
+    return OPTIX_SUCCESS;
+}
+
+static void fill_table_93(OptixFunctionTable_93 *table)
+{
+    for (size_t i = 0; i < sizeof(*table) / sizeof(void *); i++)
+        ((void **)table)[i] = (void *)stub_success;
+
+    table->optixDeviceContextCreate = stub_context_create;
+    *(void **)&table->optixDeviceContextDestroy = (void *)stub_destroy;
+    table->optixAccelBuild = stub_accel_build;
+    table->optixAccelCompact = stub_accel_compact;
+    table->optixDenoiserCreate = stub_denoiser_create;
+    *(void **)&table->optixDenoiserDestroy = (void *)stub_destroy;
+    table->optixDenoiserComputeMemoryResources = stub_denoiser_memory;
+    table->optixDenoiserSetup = stub_denoiser_setup;
+}
+
+// counts the queries reaching the library and the options of the last one, the first
+// NVOPTIX_STUB_QUERY_FAILURES queries fail
+
+unsigned long long stub_nvoptix_queries;
+unsigned long long stub_nvoptix_last_options;
+
+OptixResult optixQueryFunctionTable(int abiId, unsigned int numOptions, void *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable)
+{
+    const char *failures = getenv("NVOPTIX_STUB_QUERY_FAILURES");
+    OptixFunctionTable_93 table;
+    unsigned long long query;
+
+    query = __atomic_add_fetch(&stub_nvoptix_queries, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&stub_nvoptix_last_options, numOptions, __ATOMIC_SEQ_CST);
+
+    if (failures && query <= strtoull(failures, NULL, 10)) return OPTIX_ERROR_INTERNAL_ERROR;
+    if (abiId != 93) return OPTIX_ERROR_UNSUPPORTED_ABI_VERSION;
+    if (sizeOfTable > sizeof(table)) return OPTIX_ERROR_FUNCTION_TABLE_SIZE_MISMATCH;
+
+    fill_table_93(&table);
+    memcpy(functionTable, &table, sizeOfTable);
+
+    return OPTIX_SUCCESS;
+}
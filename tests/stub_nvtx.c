@@ -0,0 +1,94 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// stand-in NVTX library recording the ranges the relay pushes and pops, for the nvtx test of
+// nvoptix-test, which points nvtx_library at it. The test runs on one thread, so there is one
+// range stack. The counters and the last range are read by nvoptix-test through dlsym.
+
+#define STUB_CATEGORIES 16
+#define STUB_DEPTH 16
+
+typedef struct nvtxEventAttributes_v2
+{
+    uint16_t version;
+    uint16_t size;
+    uint32_t category;
+    int32_t colorType;
+    uint32_t color;
+    int32_t payloadType;
+    int32_t reserved0;
+    uint64_t payload;
+    int32_t messageType;
+    const char *message;
+} nvtxEventAttributes_t;
+
+struct nvtxDomainRegistration_st
+{
+    char name[64];
+    char categories[STUB_CATEGORIES][32];
+};
+
+static struct nvtxDomainRegistration_st *stack[STUB_DEPTH];
+static int depth;
+
+unsigned long long stub_nvtx_domains;
+unsigned long long stub_nvtx_pushes;
+unsigned long long stub_nvtx_pops;
+unsigned long long stub_nvtx_mismatched;
+
+// "<domain>/<category>/<message>" of the last range pushed
+
+char stub_nvtx_last[256];
+
+struct nvtxDomainRegistration_st *nvtxDomainCreateA(const char *name)
+{
+    struct nvtxDomainRegistration_st *domain = calloc(1, sizeof(*domain));
+
+    if (!domain) return NULL;
+
+    snprintf(domain->name, sizeof(domain->name), "%s", name);
+    stub_nvtx_domains++;
+
+    return domain;
+}
+
+void nvtxDomainDestroy(struct nvtxDomainRegistration_st *domain)
+{
+    free(domain);
+    stub_nvtx_domains--;
+}
+
+void nvtxDomainNameCategoryA(struct nvtxDomainRegistration_st *domain, uint32_t category, const char *name)
+{
+    if (domain && category < STUB_CATEGORIES) snprintf(domain->categories[category], sizeof(domain->categories[category]), "%s", name);
+}
+
+int nvtxDomainRangePushEx(struct nvtxDomainRegistration_st *domain, const nvtxEventAttributes_t *attributes)
+{
+    const char *category = attributes->category < STUB_CATEGORIES ? domain->categories[attributes->category] : "";
+
+    snprintf(stub_nvtx_last, sizeof(stub_nvtx_last), "%s/%s/%s", domain->name, category, attributes->message);
+    stub_nvtx_pushes++;
+
+    if (depth == STUB_DEPTH) return -1;
+
+    stack[depth] = domain;
+    return depth++;
+}
+
+// a pop has to close the innermost range, of the same domain
+
+int nvtxDomainRangePop(struct nvtxDomainRegistration_st *domain)
+{
+    stub_nvtx_pops++;
+
+    if (!depth || stack[depth - 1] != domain)
+    {
+        stub_nvtx_mismatched++;
+        return -1;
+    }
+
+    return --depth;
+}
@@ -0,0 +1,454 @@
+/*
+ * nvoptix-cache-warm: replay the module compiles recorded by the relay
+ * (WINE_NVOPTIX_MODULE_MANIFEST) against the native libnvoptix.so.1 so the
+ * OptiX disk cache is populated before the Windows application starts.
+ *
+ * This is a native Linux tool, it does not run inside wine.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// the per-ABI headers also declare the relay entry points, which are unused here
+
+#ifndef __cdecl
+#define __cdecl
+#endif
+
+#include "nvoptix.h"
+#include "nvoptix_manifest.h"
+#include "nvoptix_93.h"
+#include "nvoptix_87.h"
+#include "nvoptix_84.h"
+#include "nvoptix_68.h"
+#include "nvoptix_60.h"
+#include "nvoptix_55.h"
+#include "nvoptix_47.h"
+#include "nvoptix_41.h"
+#include "nvoptix_36.h"
+#include "nvoptix_22.h"
+#include "nvoptix_reader.h"
+
+typedef int CUresult;
+typedef int CUdevice;
+
+static CUresult (*pcuInit)(unsigned int flags);
+static CUresult (*pcuDeviceGet)(CUdevice *device, int ordinal);
+static CUresult (*pcuDevicePrimaryCtxRetain)(CUcontext *pctx, CUdevice dev);
+static CUresult (*pcuCtxSetCurrent)(CUcontext ctx);
+
+static OptixResult (*poptixQueryFunctionTableNative)(int abiId, unsigned int numOptions, void *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
+
+// the entries of the function table we need, resolved for one ABI
+
+struct warm_abi
+{
+    int abi;
+    OptixDeviceContext context;
+    OptixResult (*optixDeviceContextCreate)(CUcontext fromContext, const void *options, OptixDeviceContext *context);
+    OptixResult (*optixDeviceContextDestroy)(OptixDeviceContext context);
+    OptixResult (*optixDeviceContextSetCacheEnabled)(OptixDeviceContext context, int enabled);
+    OptixResult (*optixDeviceContextSetCacheLocation)(OptixDeviceContext context, const char *location);
+    OptixResult (*optixModuleCreate)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *input, size_t inputSize, char *logString, size_t *logStringSize, OptixModule *module);
+    OptixResult (*optixModuleDestroy)(OptixModule module);
+    OptixResult (*optixBuiltinISModuleGet)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const void *builtinISOptions, OptixModule *builtinModule);
+};
+
+// one recorded compile, options are rebuilt in the newest layout which older ABIs read a prefix of
+
+struct warm_job
+{
+    uint32_t kind;
+    struct warm_abi *abi;
+    OptixModuleCompileOptions_93 module;
+    OptixPipelineCompileOptions_93 pipeline;
+    const void *data;
+    size_t size;
+};
+
+static struct warm_abi abis[16];
+static unsigned int abis_count;
+static struct warm_job *jobs;
+static size_t jobs_count;
+static size_t next_job;
+static size_t jobs_done, jobs_failed;
+static CUcontext cuda_context;
+static int verbose;
+
+static struct warm_abi *get_abi(int abi)
+{
+    for (unsigned int i = 0; i < abis_count; i++)
+    {
+        if (abis[i].abi == abi) return &abis[i];
+    }
+
+    if (abis_count == sizeof(abis) / sizeof(abis[0])) return NULL;
+
+    struct warm_abi *ret = &abis[abis_count];
+    static union
+    {
+        OptixFunctionTable_93 t93;
+        OptixFunctionTable_87 t87;
+        OptixFunctionTable_84 t84;
+        OptixFunctionTable_68 t68;
+        OptixFunctionTable_60 t60;
+        OptixFunctionTable_55 t55;
+        OptixFunctionTable_47 t47;
+        OptixFunctionTable_41 t41;
+        OptixFunctionTable_36 t36;
+        OptixFunctionTable_22 t22;
+    } table;
+    OptixResult result;
+
+    memset(&table, 0, sizeof(table));
+
+    #define QUERY_TABLE(v, create, builtin) \
+        case v: \
+            result = poptixQueryFunctionTableNative(v, 0, NULL, NULL, &table.t##v, sizeof(table.t##v)); \
+            *(void **)&ret->optixDeviceContextCreate = (void *)table.t##v.optixDeviceContextCreate; \
+            *(void **)&ret->optixDeviceContextDestroy = (void *)table.t##v.optixDeviceContextDestroy; \
+            *(void **)&ret->optixDeviceContextSetCacheEnabled = (void *)table.t##v.optixDeviceContextSetCacheEnabled; \
+            *(void **)&ret->optixDeviceContextSetCacheLocation = (void *)table.t##v.optixDeviceContextSetCacheLocation; \
+            *(void **)&ret->optixModuleCreate = (void *)table.t##v.create; \
+            *(void **)&ret->optixModuleDestroy = (void *)table.t##v.optixModuleDestroy; \
+            *(void **)&ret->optixBuiltinISModuleGet = builtin; \
+            break;
+
+    switch (abi)
+    {
+        QUERY_TABLE(93, optixModuleCreate, (void *)table.t93.optixBuiltinISModuleGet)
+        QUERY_TABLE(87, optixModuleCreate, (void *)table.t87.optixBuiltinISModuleGet)
+        QUERY_TABLE(84, optixModuleCreate, (void *)table.t84.optixBuiltinISModuleGet)
+        QUERY_TABLE(68, optixModuleCreateFromPTX, (void *)table.t68.optixBuiltinISModuleGet)
+        QUERY_TABLE(60, optixModuleCreateFromPTX, (void *)table.t60.optixBuiltinISModuleGet)
+        QUERY_TABLE(55, optixModuleCreateFromPTX, (void *)table.t55.optixBuiltinISModuleGet)
+        QUERY_TABLE(47, optixModuleCreateFromPTX, (void *)table.t47.optixBuiltinISModuleGet)
+        QUERY_TABLE(41, optixModuleCreateFromPTX, (void *)table.t41.optixBuiltinISModuleGet)
+        QUERY_TABLE(36, optixModuleCreateFromPTX, (void *)table.t36.optixBuiltinISModuleGet)
+        QUERY_TABLE(22, optixModuleCreateFromPTX, NULL)
+        default:
+            fprintf(stderr, "ABI %d is not supported\n", abi);
+            return NULL;
+    }
+
+    #undef QUERY_TABLE
+
+    if (result != OPTIX_SUCCESS)
+    {
+        fprintf(stderr, "optixQueryFunctionTable(%d) failed: %d\n", abi, result);
+        return NULL;
+    }
+
+    ret->abi = abi;
+    abis_count++;
+    return ret;
+}
+
+static int load_manifest(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+
+    if (fd == -1 || fstat(fd, &st))
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return 0;
+    }
+
+    if (st.st_size < 8)
+    {
+        fprintf(stderr, "%s: not a module manifest\n", path);
+        close(fd);
+        return 0;
+    }
+
+    // the inputs are passed straight from the mapping, it stays mapped until exit
+
+    const unsigned char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    if (memcmp(data, NVOPTIX_MANIFEST_MAGIC, 8))
+    {
+        fprintf(stderr, "%s: not a module manifest\n", path);
+        return 0;
+    }
+
+    struct reader file = { data + 8, data + st.st_size, 0 };
+
+    while (file.ptr < file.end)
+    {
+        const struct manifest_record_header *header = get(&file, sizeof(*header));
+        const unsigned char *payload = header ? get(&file, header->size) : NULL;
+
+        if (!payload)
+        {
+            fprintf(stderr, "%s: truncated record, ignoring the rest\n", path);
+            break;
+        }
+
+        struct warm_job *new_jobs = reallocarray(jobs, jobs_count + 1, sizeof(*jobs));
+
+        if (!new_jobs)
+        {
+            fprintf(stderr, "out of memory\n");
+            return 0;
+        }
+
+        jobs = new_jobs;
+
+        struct warm_job *job = &jobs[jobs_count];
+        struct reader r = { payload, payload + header->size, 0 };
+
+        memset(job, 0, sizeof(*job));
+        job->kind = header->kind;
+
+        get_options(&r, &job->module, &job->pipeline);
+        job->data = get_blob(&r, &job->size);
+
+        if (r.failed)
+        {
+            fprintf(stderr, "%s: malformed record, skipping\n", path);
+            continue;
+        }
+
+        if (job->kind != MANIFEST_RECORD_MODULE && job->kind != MANIFEST_RECORD_BUILTIN_IS)
+        {
+            fprintf(stderr, "%s: unknown record kind %u, skipping\n", path, job->kind);
+            continue;
+        }
+
+        if (!(job->abi = get_abi(header->abi))) continue;
+
+        jobs_count++;
+    }
+
+    return 1;
+}
+
+static void log_callback_native(unsigned int level, const char *tag, const char *message, void *cbdata)
+{
+    fprintf(stderr, "[%u][%s]: %s\n", level, tag, message);
+}
+
+static int create_contexts(const char *cache_location)
+{
+    for (unsigned int i = 0; i < abis_count; i++)
+    {
+        struct warm_abi *abi = &abis[i];
+        OptixDeviceContextOptions_93 options = {0};
+        OptixResult result;
+
+        if (verbose)
+        {
+            options.logCallbackFunction = log_callback_native;
+            options.logCallbackLevel = 4;
+        }
+
+        if ((result = abi->optixDeviceContextCreate(cuda_context, &options, &abi->context)) != OPTIX_SUCCESS)
+        {
+            fprintf(stderr, "optixDeviceContextCreate(ABI %d) failed: %d\n", abi->abi, result);
+            return 0;
+        }
+
+        if (cache_location && (result = abi->optixDeviceContextSetCacheLocation(abi->context, cache_location)) != OPTIX_SUCCESS)
+        {
+            fprintf(stderr, "optixDeviceContextSetCacheLocation(%s) failed: %d\n", cache_location, result);
+            return 0;
+        }
+
+        if ((result = abi->optixDeviceContextSetCacheEnabled(abi->context, 1)) != OPTIX_SUCCESS)
+        {
+            fprintf(stderr, "optixDeviceContextSetCacheEnabled failed: %d\n", result);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void *warm_thread(void *arg)
+{
+    char log[2048];
+
+    if (pcuCtxSetCurrent(cuda_context))
+    {
+        fprintf(stderr, "cuCtxSetCurrent failed\n");
+        return NULL;
+    }
+
+    for (;;)
+    {
+        size_t index = __atomic_fetch_add(&next_job, 1, __ATOMIC_RELAXED);
+
+        if (index >= jobs_count) break;
+
+        struct warm_job *job = &jobs[index];
+        struct warm_abi *abi = job->abi;
+        size_t log_size = sizeof(log);
+        OptixModule module = NULL;
+        OptixResult result;
+
+        if (job->kind == MANIFEST_RECORD_MODULE)
+        {
+            result = abi->optixModuleCreate(abi->context, &job->module, &job->pipeline, job->data, job->size, log, &log_size, &module);
+        }
+        else if (abi->optixBuiltinISModuleGet)
+        {
+            OptixBuiltinISOptions_93 builtin = {0};
+
+            memcpy(&builtin, job->data, job->size < sizeof(builtin) ? job->size : sizeof(builtin));
+            result = abi->optixBuiltinISModuleGet(abi->context, &job->module, &job->pipeline, &builtin, &module);
+            log_size = 0;
+        }
+        else
+        {
+            result = OPTIX_ERROR_INVALID_FUNCTION_USE;
+            log_size = 0;
+        }
+
+        if (result == OPTIX_SUCCESS)
+        {
+            if (job->kind == MANIFEST_RECORD_MODULE) abi->optixModuleDestroy(module);
+            __atomic_fetch_add(&jobs_done, 1, __ATOMIC_RELAXED);
+        }
+        else
+        {
+            fprintf(stderr, "record %zu (ABI %d) failed: %d\n", index, abi->abi, result);
+            if (log_size > 1) fprintf(stderr, "%.*s\n", (int)(log_size < sizeof(log) ? log_size : sizeof(log)), log);
+            __atomic_fetch_add(&jobs_failed, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    return NULL;
+}
+
+static int load_libraries(void)
+{
+    void *libcuda, *libnvoptix;
+
+    if (!(libcuda = dlopen("libcuda.so.1", RTLD_NOW)))
+    {
+        fprintf(stderr, "Cannot load libcuda.so.1: %s\n", dlerror());
+        return 0;
+    }
+
+    #define LOAD_FUNCPTR(lib, f, name) if (!(*(void **)(&f) = dlsym(lib, name))) { fprintf(stderr, "Can't find symbol %s.\n", name); return 0; }
+
+    LOAD_FUNCPTR(libcuda, pcuInit, "cuInit");
+    LOAD_FUNCPTR(libcuda, pcuDeviceGet, "cuDeviceGet");
+    LOAD_FUNCPTR(libcuda, pcuDevicePrimaryCtxRetain, "cuDevicePrimaryCtxRetain");
+    LOAD_FUNCPTR(libcuda, pcuCtxSetCurrent, "cuCtxSetCurrent");
+
+    if (!(libnvoptix = dlopen("libnvoptix.so.1", RTLD_NOW)))
+    {
+        fprintf(stderr, "Cannot load libnvoptix.so.1: %s\n", dlerror());
+        return 0;
+    }
+
+    LOAD_FUNCPTR(libnvoptix, poptixQueryFunctionTableNative, "optixQueryFunctionTable");
+
+    #undef LOAD_FUNCPTR
+
+    return 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [-j threads] [-d device] [-c cache-location] [-v] manifest...\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *cache_location = NULL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int device_ordinal = 0;
+    CUdevice device;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:d:c:vh")) != -1)
+    {
+        switch (opt)
+        {
+            case 'j': threads = atol(optarg); break;
+            case 'd': device_ordinal = atoi(optarg); break;
+            case 'c': cache_location = optarg; break;
+            case 'v': verbose = 1; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (optind >= argc)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (threads < 1) threads = 1;
+
+    if (!load_libraries()) return 1;
+
+    if (pcuInit(0) || pcuDeviceGet(&device, device_ordinal) || pcuDevicePrimaryCtxRetain(&cuda_context, device) || pcuCtxSetCurrent(cuda_context))
+    {
+        fprintf(stderr, "Failed to initialize CUDA device %d\n", device_ordinal);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++)
+    {
+        if (!load_manifest(argv[i])) return 1;
+    }
+
+    if (!create_contexts(cache_location)) return 1;
+
+    if ((size_t)threads > jobs_count) threads = jobs_count ? jobs_count : 1;
+
+    struct timespec start, end;
+    pthread_t *workers = calloc(threads, sizeof(pthread_t));
+
+    if (!workers) return 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (long i = 0; i < threads; i++)
+    {
+        if (pthread_create(&workers[i], NULL, warm_thread, NULL))
+        {
+            fprintf(stderr, "Failed to create worker thread\n");
+            threads = i;
+            break;
+        }
+    }
+
+    for (long i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (unsigned int i = 0; i < abis_count; i++)
+        abis[i].optixDeviceContextDestroy(abis[i].context);
+
+    printf("%zu of %zu modules compiled (%zu failed) in %.3f s using %ld threads\n",
+           jobs_done, jobs_count, jobs_failed,
+           (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, threads);
+
+    free(workers);
+
+    return jobs_failed ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+// reader for the manifest encoding (nvoptix_manifest.h), shared by the native tools,
+// included after nvoptix_93.h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nvoptix_manifest.h"
+
+struct reader
+{
+    const unsigned char *ptr;
+    const unsigned char *end;
+    int failed;
+};
+
+static inline const void *get(struct reader *r, size_t size)
+{
+    if (r->failed || (size_t)(r->end - r->ptr) < size)
+    {
+        r->failed = 1;
+        return NULL;
+    }
+
+    const void *ptr = r->ptr;
+    r->ptr += size;
+    return ptr;
+}
+
+static inline uint32_t get_u32(struct reader *r)
+{
+    const void *ptr = get(r, sizeof(uint32_t));
+    uint32_t value = 0;
+    if (ptr) memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline uint64_t get_u64(struct reader *r)
+{
+    const void *ptr = get(r, sizeof(uint64_t));
+    uint64_t value = 0;
+    if (ptr) memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+static inline const void *get_blob(struct reader *r, size_t *size)
+{
+    *size = get_u64(r);
+    return get(r, *size);
+}
+
+static inline char *get_string(struct reader *r)
+{
+    uint32_t len = get_u32(r);
+
+    if (len == NVOPTIX_MANIFEST_NULL) return NULL;
+
+    const char *ptr = get(r, len);
+    char *str;
+
+    if (!ptr || !(str = malloc(len + 1)))
+    {
+        r->failed = 1;
+        return NULL;
+    }
+
+    memcpy(str, ptr, len);
+    str[len] = 0;
+    return str;
+}
+
+static inline void get_options(struct reader *r, OptixModuleCompileOptions_93 *module, OptixPipelineCompileOptions_93 *pipeline)
+{
+    module->maxRegisterCount = get_u32(r);
+    module->optLevel = get_u32(r);
+    module->debugLevel = get_u32(r);
+    module->numBoundValues = get_u32(r);
+    module->numPayloadTypes = get_u32(r);
+
+    if (r->failed) return;
+
+    if (module->numBoundValues)
+    {
+        OptixModuleCompileBoundValueEntry_93 *entries = calloc(module->numBoundValues, sizeof(*entries));
+
+        if (!entries)
+        {
+            r->failed = 1;
+            return;
+        }
+
+        for (unsigned int i = 0; i < module->numBoundValues; i++)
+        {
+            entries[i].pipelineParamOffsetInBytes = get_u64(r);
+            entries[i].boundValuePtr = get_blob(r, &entries[i].sizeInBytes);
+            entries[i].annotation = get_string(r);
+        }
+
+        module->boundValues = entries;
+    }
+
+    if (module->numPayloadTypes)
+    {
+        OptixPayloadType_93 *types = calloc(module->numPayloadTypes, sizeof(*types));
+
+        if (!types)
+        {
+            r->failed = 1;
+            return;
+        }
+
+        for (unsigned int i = 0; i < module->numPayloadTypes; i++)
+        {
+            types[i].numPayloadValues = get_u32(r);
+            types[i].payloadSemantics = get(r, types[i].numPayloadValues * sizeof(unsigned int));
+        }
+
+        module->payloadTypes = types;
+    }
+
+    pipeline->usesMotionBlur = get_u32(r);
+    pipeline->traversableGraphFlags = get_u32(r);
+    pipeline->numPayloadValues = get_u32(r);
+    pipeline->numAttributeValues = get_u32(r);
+    pipeline->exceptionFlags = get_u32(r);
+    pipeline->usesPrimitiveTypeFlags = get_u32(r);
+    pipeline->allowOpacityMicromaps = get_u32(r);
+    pipeline->pipelineLaunchParamsVariableName = get_string(r);
+}
@@ -0,0 +1,1281 @@
+/*
+ * nvoptix-replay: replay an API capture of the relay (capture_file) against the
+ * native libnvoptix.so.1 and compare the time of each call with the time it took
+ * through wine.
+ *
+ * Context, module, program group, pipeline and denoiser creation are replayed in
+ * capture order with their handles remapped. Calls working on device memory are
+ * not, its contents are not captured. With --no-gpu a stand-in function table
+ * replaces the driver, measuring only the reader and the dispatch.
+ *
+ * This is a native Linux tool, it does not run inside wine.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// the per-ABI headers also declare the relay entry points, which are unused here
+
+#ifndef __cdecl
+#define __cdecl
+#endif
+
+#include "nvoptix.h"
+#include "nvoptix_capture.h"
+#include "nvoptix_manifest.h"
+#include "nvoptix_93.h"
+#include "nvoptix_87.h"
+#include "nvoptix_84.h"
+#include "nvoptix_68.h"
+#include "nvoptix_60.h"
+#include "nvoptix_55.h"
+#include "nvoptix_47.h"
+#include "nvoptix_41.h"
+#include "nvoptix_36.h"
+#include "nvoptix_22.h"
+#include "nvoptix_reader.h"
+
+typedef int CUresult;
+typedef int CUdevice;
+
+static CUresult (*pcuInit)(unsigned int flags);
+static CUresult (*pcuDeviceGet)(CUdevice *device, int ordinal);
+static CUresult (*pcuDevicePrimaryCtxRetain)(CUcontext *pctx, CUdevice dev);
+static CUresult (*pcuCtxSetCurrent)(CUcontext ctx);
+
+static OptixResult (*poptixQueryFunctionTableNative)(int abiId, unsigned int numOptions, void *optionKeys, const void **optionValues, void *functionTable, size_t sizeOfTable);
+
+static size_t (*pZSTD_decompress)(void *dst, size_t dstCapacity, const void *src, size_t compressedSize);
+static unsigned (*pZSTD_isError)(size_t code);
+
+// the entries of the function table we replay, resolved for one ABI
+
+struct replay_abi
+{
+    int abi;
+    OptixResult (*optixDeviceContextCreate)(CUcontext fromContext, const void *options, OptixDeviceContext *context);
+    OptixResult (*optixDeviceContextDestroy)(OptixDeviceContext context);
+    OptixResult (*optixModuleCreate)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *input, size_t inputSize, char *logString, size_t *logStringSize, OptixModule *module);
+    OptixResult (*optixModuleDestroy)(OptixModule module);
+    OptixResult (*optixBuiltinISModuleGet)(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const void *builtinISOptions, OptixModule *builtinModule);
+    OptixResult (*optixProgramGroupCreate)(OptixDeviceContext context, const void *programDescriptions, unsigned int numProgramGroups, const void *options, char *logString, size_t *logStringSize, OptixProgramGroup *programGroups);
+    OptixResult (*optixProgramGroupDestroy)(OptixProgramGroup programGroup);
+    OptixResult (*optixPipelineCreate)(OptixDeviceContext context, const void *pipelineCompileOptions, const void *pipelineLinkOptions, const OptixProgramGroup *programGroups, unsigned int numProgramGroups, char *logString, size_t *logStringSize, OptixPipeline *pipeline);
+    OptixResult (*optixPipelineDestroy)(OptixPipeline pipeline);
+    OptixResult (*optixPipelineSetStackSize)(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState, unsigned int continuationStackSize, unsigned int maxTraversableGraphDepth);
+    OptixResult (*optixDenoiserCreate)(OptixDeviceContext context, int modelKind, const void *options, OptixDenoiser *returnHandle);
+    OptixResult (*optixDenoiserCreateWithoutKind)(OptixDeviceContext context, const void *options, OptixDenoiser *returnHandle);
+    OptixResult (*optixDenoiserCreateWithUserModel)(OptixDeviceContext context, const void *data, size_t dataSizeInBytes, OptixDenoiser *returnHandle);
+    OptixResult (*optixDenoiserSetModel)(OptixDenoiser handle, int kind, void *data, size_t sizeInBytes);
+    OptixResult (*optixDenoiserDestroy)(OptixDenoiser handle);
+};
+
+struct replay_data
+{
+    uint32_t kind;
+    uint32_t arg;
+    const unsigned char *data;
+    size_t size;
+};
+
+// one captured call, from its entry to its return event
+
+struct replay_call
+{
+    uint32_t function;
+    uint32_t thread;
+    uint64_t entry_ns;
+    uint64_t return_ns;
+    const unsigned char *args;
+    uint32_t count;
+    uint64_t result;
+    struct replay_data *data;
+    size_t data_count;
+};
+
+struct replay_thread
+{
+    int pending;
+    struct replay_call call;
+    size_t data_capacity;
+};
+
+struct replay_function
+{
+    char *name;
+    char *base;
+    int abi;
+    size_t stats;
+};
+
+struct replay_stats
+{
+    char *name;
+    unsigned long calls, replayed, failed, skipped;
+    double captured_ms, replay_ms;
+};
+
+struct blob
+{
+    uint64_t hash;
+    const unsigned char *data;
+    size_t size;
+};
+
+struct handle
+{
+    uint64_t captured;
+    uint64_t replayed;
+};
+
+enum replay_status
+{
+    REPLAY_SKIPPED,
+    REPLAY_DONE,
+    REPLAY_FAILED,
+};
+
+static struct replay_abi abis[16];
+static unsigned int abis_count;
+
+static struct replay_function *functions;
+static size_t functions_count;
+static struct replay_stats *stats;
+static size_t stats_count;
+
+static struct replay_thread *threads;
+static size_t threads_count;
+
+static struct replay_call *calls;
+static size_t calls_count;
+
+static struct blob *blobs;
+static size_t blobs_capacity, blobs_count;
+
+static struct handle *handles;
+static size_t handles_capacity, handles_count;
+
+static unsigned long records, chunks, callback_events, unmatched;
+static uint64_t raw_bytes;
+
+static CUcontext cuda_context;
+static int no_gpu;
+static int verbose;
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e3 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void *grow(void *ptr, size_t *capacity, size_t count, size_t size)
+{
+    if (count < *capacity) return ptr;
+
+    size_t new_capacity = *capacity ? *capacity * 2 : 64;
+    void *new_ptr = reallocarray(ptr, new_capacity, size);
+
+    if (!new_ptr)
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    *capacity = new_capacity;
+    return new_ptr;
+}
+
+// stand-in function table for --no-gpu, every call succeeds with a fresh handle
+
+static uintptr_t stub_handles;
+
+static void *stub_handle(void)
+{
+    return (void *)++stub_handles;
+}
+
+static OptixResult stub_context_create(CUcontext fromContext, const void *options, OptixDeviceContext *context) { *context = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_destroy(void *handle) { return OPTIX_SUCCESS; }
+static OptixResult stub_module_create(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const char *input, size_t inputSize, char *logString, size_t *logStringSize, OptixModule *module) { *module = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_builtin_get(OptixDeviceContext context, const void *moduleCompileOptions, const void *pipelineCompileOptions, const void *builtinISOptions, OptixModule *builtinModule) { *builtinModule = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_program_group_create(OptixDeviceContext context, const void *programDescriptions, unsigned int numProgramGroups, const void *options, char *logString, size_t *logStringSize, OptixProgramGroup *programGroups)
+{
+    for (unsigned int i = 0; i < numProgramGroups; i++) programGroups[i] = stub_handle();
+    return OPTIX_SUCCESS;
+}
+static OptixResult stub_pipeline_create(OptixDeviceContext context, const void *pipelineCompileOptions, const void *pipelineLinkOptions, const OptixProgramGroup *programGroups, unsigned int numProgramGroups, char *logString, size_t *logStringSize, OptixPipeline *pipeline) { *pipeline = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_set_stack_size(OptixPipeline pipeline, unsigned int directCallableStackSizeFromTraversal, unsigned int directCallableStackSizeFromState, unsigned int continuationStackSize, unsigned int maxTraversableGraphDepth) { return OPTIX_SUCCESS; }
+static OptixResult stub_denoiser_create(OptixDeviceContext context, int modelKind, const void *options, OptixDenoiser *returnHandle) { *returnHandle = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_denoiser_create_without_kind(OptixDeviceContext context, const void *options, OptixDenoiser *returnHandle) { *returnHandle = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_denoiser_create_user(OptixDeviceContext context, const void *data, size_t dataSizeInBytes, OptixDenoiser *returnHandle) { *returnHandle = stub_handle(); return OPTIX_SUCCESS; }
+static OptixResult stub_denoiser_set_model(OptixDenoiser handle, int kind, void *data, size_t sizeInBytes) { return OPTIX_SUCCESS; }
+
+static void stub_abi(struct replay_abi *abi)
+{
+    abi->optixDeviceContextCreate = stub_context_create;
+    *(void **)&abi->optixDeviceContextDestroy = (void *)stub_destroy;
+    abi->optixModuleCreate = stub_module_create;
+    *(void **)&abi->optixModuleDestroy = (void *)stub_destroy;
+    abi->optixBuiltinISModuleGet = stub_builtin_get;
+    abi->optixProgramGroupCreate = stub_program_group_create;
+    *(void **)&abi->optixProgramGroupDestroy = (void *)stub_destroy;
+    abi->optixPipelineCreate = stub_pipeline_create;
+    *(void **)&abi->optixPipelineDestroy = (void *)stub_destroy;
+    abi->optixPipelineSetStackSize = stub_set_stack_size;
+    abi->optixDenoiserCreate = stub_denoiser_create;
+    abi->optixDenoiserCreateWithoutKind = stub_denoiser_create_without_kind;
+    abi->optixDenoiserCreateWithUserModel = stub_denoiser_create_user;
+    abi->optixDenoiserSetModel = stub_denoiser_set_model;
+    *(void **)&abi->optixDenoiserDestroy = (void *)stub_destroy;
+}
+
+static struct replay_abi *get_abi(int abi)
+{
+    for (unsigned int i = 0; i < abis_count; i++)
+    {
+        if (abis[i].abi == abi) return &abis[i];
+    }
+
+    if (abis_count == sizeof(abis) / sizeof(abis[0])) return NULL;
+
+    struct replay_abi *ret = &abis[abis_count];
+    static union
+    {
+        OptixFunctionTable_93 t93;
+        OptixFunctionTable_87 t87;
+        OptixFunctionTable_84 t84;
+        OptixFunctionTable_68 t68;
+        OptixFunctionTable_60 t60;
+        OptixFunctionTable_55 t55;
+        OptixFunctionTable_47 t47;
+        OptixFunctionTable_41 t41;
+        OptixFunctionTable_36 t36;
+        OptixFunctionTable_22 t22;
+    } table;
+    OptixResult result = OPTIX_SUCCESS;
+
+    memset(ret, 0, sizeof(*ret));
+    memset(&table, 0, sizeof(table));
+
+    #define ENTRY(field, value) *(void **)&ret->field = (void *)(value)
+    #define QUERY_TABLE(v, create, builtin, denoiser, denoiser_without_kind, user_model, set_model) \
+        case v: \
+            if (no_gpu) { stub_abi(ret); break; } \
+            result = poptixQueryFunctionTableNative(v, 0, NULL, NULL, &table.t##v, sizeof(table.t##v)); \
+            ENTRY(optixDeviceContextCreate, table.t##v.optixDeviceContextCreate); \
+            ENTRY(optixDeviceContextDestroy, table.t##v.optixDeviceContextDestroy); \
+            ENTRY(optixModuleCreate, table.t##v.create); \
+            ENTRY(optixModuleDestroy, table.t##v.optixModuleDestroy); \
+            ENTRY(optixBuiltinISModuleGet, builtin); \
+            ENTRY(optixProgramGroupCreate, table.t##v.optixProgramGroupCreate); \
+            ENTRY(optixProgramGroupDestroy, table.t##v.optixProgramGroupDestroy); \
+            ENTRY(optixPipelineCreate, table.t##v.optixPipelineCreate); \
+            ENTRY(optixPipelineDestroy, table.t##v.optixPipelineDestroy); \
+            ENTRY(optixPipelineSetStackSize, table.t##v.optixPipelineSetStackSize); \
+            ENTRY(optixDenoiserCreate, denoiser); \
+            ENTRY(optixDenoiserCreateWithoutKind, denoiser_without_kind); \
+            ENTRY(optixDenoiserCreateWithUserModel, user_model); \
+            ENTRY(optixDenoiserSetModel, set_model); \
+            ENTRY(optixDenoiserDestroy, table.t##v.optixDenoiserDestroy); \
+            break;
+
+    switch (abi)
+    {
+        QUERY_TABLE(93, optixModuleCreate, table.t93.optixBuiltinISModuleGet, table.t93.optixDenoiserCreate, NULL, table.t93.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(87, optixModuleCreate, table.t87.optixBuiltinISModuleGet, table.t87.optixDenoiserCreate, NULL, table.t87.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(84, optixModuleCreate, table.t84.optixBuiltinISModuleGet, table.t84.optixDenoiserCreate, NULL, table.t84.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(68, optixModuleCreateFromPTX, table.t68.optixBuiltinISModuleGet, table.t68.optixDenoiserCreate, NULL, table.t68.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(60, optixModuleCreateFromPTX, table.t60.optixBuiltinISModuleGet, table.t60.optixDenoiserCreate, NULL, table.t60.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(55, optixModuleCreateFromPTX, table.t55.optixBuiltinISModuleGet, table.t55.optixDenoiserCreate, NULL, table.t55.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(47, optixModuleCreateFromPTX, table.t47.optixBuiltinISModuleGet, table.t47.optixDenoiserCreate, NULL, table.t47.optixDenoiserCreateWithUserModel, NULL)
+        QUERY_TABLE(41, optixModuleCreateFromPTX, table.t41.optixBuiltinISModuleGet, NULL, table.t41.optixDenoiserCreate, NULL, table.t41.optixDenoiserSetModel)
+        QUERY_TABLE(36, optixModuleCreateFromPTX, table.t36.optixBuiltinISModuleGet, NULL, table.t36.optixDenoiserCreate, NULL, table.t36.optixDenoiserSetModel)
+        QUERY_TABLE(22, optixModuleCreateFromPTX, NULL, NULL, table.t22.optixDenoiserCreate, NULL, table.t22.optixDenoiserSetModel)
+        default:
+            fprintf(stderr, "ABI %d is not supported\n", abi);
+            return NULL;
+    }
+
+    #undef QUERY_TABLE
+    #undef ENTRY
+
+    if (result != OPTIX_SUCCESS)
+    {
+        fprintf(stderr, "optixQueryFunctionTable(%d) failed: %d\n", abi, result);
+        return NULL;
+    }
+
+    ret->abi = abi;
+    abis_count++;
+    return ret;
+}
+
+// captured handles are mapped to the ones the replay got, 0 stays 0
+
+static void map_handle(uint64_t captured, const void *replayed)
+{
+    size_t i;
+
+    if (!captured) return;
+
+    if (handles_count * 2 >= handles_capacity)
+    {
+        size_t capacity = handles_capacity ? handles_capacity * 2 : 1024;
+        struct handle *new_handles = calloc(capacity, sizeof(*new_handles));
+
+        if (!new_handles)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        for (size_t j = 0; j < handles_capacity; j++)
+        {
+            if (!handles[j].captured) continue;
+            for (i = handles[j].captured % capacity; new_handles[i].captured; i = (i + 1) % capacity);
+            new_handles[i] = handles[j];
+        }
+
+        free(handles);
+        handles = new_handles;
+        handles_capacity = capacity;
+    }
+
+    for (i = captured % handles_capacity; handles[i].captured && handles[i].captured != captured; i = (i + 1) % handles_capacity);
+
+    if (!handles[i].captured) handles_count++;
+
+    handles[i].captured = captured;
+    handles[i].replayed = (uintptr_t)replayed;
+}
+
+static int lookup_handle(uint64_t captured, void **replayed)
+{
+    *replayed = NULL;
+
+    if (!captured) return 1;
+    if (!handles_capacity) return 0;
+
+    for (size_t i = captured % handles_capacity; handles[i].captured; i = (i + 1) % handles_capacity)
+    {
+        if (handles[i].captured != captured) continue;
+
+        *replayed = (void *)(uintptr_t)handles[i].replayed;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void add_blob(uint64_t hash, const unsigned char *data, size_t size)
+{
+    size_t i;
+
+    if (blobs_count * 2 >= blobs_capacity)
+    {
+        size_t capacity = blobs_capacity ? blobs_capacity * 2 : 1024;
+        struct blob *new_blobs = calloc(capacity, sizeof(*new_blobs));
+
+        if (!new_blobs)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        for (size_t j = 0; j < blobs_capacity; j++)
+        {
+            if (!blobs[j].hash) continue;
+            for (i = blobs[j].hash % capacity; new_blobs[i].hash; i = (i + 1) % capacity);
+            new_blobs[i] = blobs[j];
+        }
+
+        free(blobs);
+        blobs = new_blobs;
+        blobs_capacity = capacity;
+    }
+
+    for (i = hash % blobs_capacity; blobs[i].hash && blobs[i].hash != hash; i = (i + 1) % blobs_capacity);
+
+    if (!blobs[i].hash) blobs_count++;
+
+    blobs[i].hash = hash;
+    blobs[i].data = data;
+    blobs[i].size = size;
+}
+
+static const struct blob *find_blob(uint64_t hash)
+{
+    if (!blobs_capacity) return NULL;
+
+    for (size_t i = hash % blobs_capacity; blobs[i].hash; i = (i + 1) % blobs_capacity)
+    {
+        if (blobs[i].hash == hash) return &blobs[i];
+    }
+
+    return NULL;
+}
+
+static size_t get_stats(const char *base)
+{
+    static size_t capacity;
+
+    for (size_t i = 0; i < stats_count; i++)
+    {
+        if (!strcmp(stats[i].name, base)) return i;
+    }
+
+    stats = grow(stats, &capacity, stats_count, sizeof(*stats));
+    memset(&stats[stats_count], 0, sizeof(*stats));
+    stats[stats_count].name = strdup(base);
+
+    return stats_count++;
+}
+
+// names look like "optixLaunch_93", the probes' like "optixLaunch__entry"
+
+static void add_string(uint32_t id, const unsigned char *data, size_t size)
+{
+    static size_t capacity;
+    struct replay_function *function;
+    char *underscore, *end;
+
+    while (functions_count <= id)
+    {
+        functions = grow(functions, &capacity, functions_count, sizeof(*functions));
+        memset(&functions[functions_count++], 0, sizeof(*functions));
+    }
+
+    function = &functions[id];
+
+    free(function->name);
+    free(function->base);
+
+    if (!(function->name = strndup((const char *)data, size)) || !(function->base = strdup(function->name)))
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    function->abi = 0;
+
+    if ((underscore = strrchr(function->base, '_')) && underscore[1] != '_' && underscore > function->base && underscore[-1] != '_')
+    {
+        long abi = strtol(underscore + 1, &end, 10);
+
+        if (!*end && abi > 0)
+        {
+            function->abi = abi;
+            *underscore = 0;
+        }
+    }
+
+    function->stats = get_stats(function->base);
+}
+
+static const char *string(uint32_t id)
+{
+    return id < functions_count && functions[id].name ? functions[id].name : "";
+}
+
+static int ends_with(const char *str, const char *suffix)
+{
+    size_t len = strlen(str), suffix_len = strlen(suffix);
+
+    return len >= suffix_len && !strcmp(str + len - suffix_len, suffix);
+}
+
+static struct replay_thread *get_thread(uint32_t id)
+{
+    static size_t capacity;
+
+    while (threads_count <= id)
+    {
+        threads = grow(threads, &capacity, threads_count, sizeof(*threads));
+        memset(&threads[threads_count++], 0, sizeof(*threads));
+    }
+
+    return &threads[id];
+}
+
+static void read_event(uint32_t thread_id, const unsigned char *payload, size_t size)
+{
+    static size_t capacity;
+    struct replay_thread *thread = get_thread(thread_id);
+    struct reader r = { payload, payload + size, 0 };
+    uint64_t time = get_u64(&r);
+    uint32_t function = get_u32(&r), probe = get_u32(&r), count = get_u32(&r);
+    const unsigned char *args = get(&r, (size_t)count * sizeof(uint64_t));
+    const char *probe_name = string(probe);
+
+    if (r.failed) return;
+
+    if (ends_with(probe_name, "__entry"))
+    {
+        if (thread->pending) unmatched++;
+
+        thread->pending = 1;
+        thread->call.function = function;
+        thread->call.thread = thread_id;
+        thread->call.entry_ns = time;
+        thread->call.args = args;
+        thread->call.count = count;
+        thread->call.data_count = 0;
+    }
+    else if (ends_with(probe_name, "__return"))
+    {
+        if (!thread->pending || thread->call.function != function)
+        {
+            unmatched++;
+            return;
+        }
+
+        thread->pending = 0;
+        thread->call.return_ns = time;
+        if (count) memcpy(&thread->call.result, args, sizeof(uint64_t));
+
+        calls = grow(calls, &capacity, calls_count, sizeof(*calls));
+        calls[calls_count] = thread->call;
+
+        // the thread's data array moves to the call, the next one starts a new array
+
+        thread->call.data = NULL;
+        thread->data_capacity = 0;
+        calls_count++;
+    }
+    else
+    {
+        callback_events++;
+    }
+}
+
+static void read_data(uint32_t thread_id, const unsigned char *payload, size_t size)
+{
+    struct replay_thread *thread = get_thread(thread_id);
+    struct reader r = { payload, payload + size, 0 };
+    uint32_t kind = get_u32(&r), arg = get_u32(&r);
+    uint64_t hash = get_u64(&r);
+    const struct blob *blob = find_blob(hash);
+
+    if (r.failed || !thread->pending) return;
+
+    if (!blob)
+    {
+        fprintf(stderr, "missing blob %016llx\n", (unsigned long long)hash);
+        return;
+    }
+
+    thread->call.data = grow(thread->call.data, &thread->data_capacity, thread->call.data_count, sizeof(struct replay_data));
+    thread->call.data[thread->call.data_count].kind = kind;
+    thread->call.data[thread->call.data_count].arg = arg;
+    thread->call.data[thread->call.data_count].data = blob->data;
+    thread->call.data[thread->call.data_count++].size = blob->size;
+}
+
+static int read_chunk(const unsigned char *data, size_t size)
+{
+    struct reader r = { data, data + size, 0 };
+
+    while (r.ptr < r.end)
+    {
+        const struct capture_record_header *header = get(&r, sizeof(*header));
+        const unsigned char *payload = header ? get(&r, header->size) : NULL;
+
+        if (!payload) return 0;
+
+        records++;
+
+        switch (header->kind)
+        {
+            case CAPTURE_RECORD_STRING:
+                if (header->size >= sizeof(uint32_t))
+                {
+                    uint32_t id;
+
+                    memcpy(&id, payload, sizeof(id));
+                    add_string(id, payload + sizeof(id), header->size - sizeof(id));
+                }
+                break;
+
+            case CAPTURE_RECORD_BLOB:
+                if (header->size >= sizeof(uint64_t))
+                {
+                    uint64_t hash;
+
+                    memcpy(&hash, payload, sizeof(hash));
+                    add_blob(hash, payload + sizeof(hash), header->size - sizeof(hash));
+                }
+                break;
+
+            case CAPTURE_RECORD_EVENT:
+                read_event(header->thread, payload, header->size);
+                break;
+
+            case CAPTURE_RECORD_DATA:
+                read_data(header->thread, payload, header->size);
+                break;
+        }
+    }
+
+    return 1;
+}
+
+static int load_zstd(void)
+{
+    void *libzstd;
+
+    if (pZSTD_decompress) return 1;
+
+    if (!(libzstd = dlopen("libzstd.so.1", RTLD_NOW)))
+    {
+        fprintf(stderr, "Cannot load libzstd.so.1: %s\n", dlerror());
+        return 0;
+    }
+
+    if (!(*(void **)&pZSTD_decompress = dlsym(libzstd, "ZSTD_decompress")) ||
+        !(*(void **)&pZSTD_isError = dlsym(libzstd, "ZSTD_isError")))
+    {
+        fprintf(stderr, "Can't find the zstd decompression symbols.\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+static int load_capture(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+
+    if (fd == -1 || fstat(fd, &st))
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        if (fd != -1) close(fd);
+        return 0;
+    }
+
+    if (st.st_size < 8)
+    {
+        fprintf(stderr, "%s: not an API capture\n", path);
+        close(fd);
+        return 0;
+    }
+
+    // uncompressed blobs are used straight from the mapping, it stays mapped until exit
+
+    const unsigned char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    if (memcmp(data, NVOPTIX_CAPTURE_MAGIC, 8))
+    {
+        fprintf(stderr, "%s: not an API capture\n", path);
+        return 0;
+    }
+
+    struct reader file = { data + 8, data + st.st_size, 0 };
+
+    while (file.ptr < file.end)
+    {
+        const struct capture_chunk_header *header = get(&file, sizeof(*header));
+        const unsigned char *payload = header ? get(&file, header->size) : NULL;
+        unsigned char *raw;
+
+        if (!payload)
+        {
+            fprintf(stderr, "%s: truncated chunk, ignoring the rest\n", path);
+            break;
+        }
+
+        chunks++;
+        raw_bytes += header->raw_size;
+
+        if (header->flags & NVOPTIX_CAPTURE_ZSTD)
+        {
+            if (!load_zstd()) return 0;
+
+            // decompressed chunks are kept for the blobs they hold
+
+            if (!(raw = malloc(header->raw_size)))
+            {
+                fprintf(stderr, "out of memory\n");
+                return 0;
+            }
+
+            size_t ret = pZSTD_decompress(raw, header->raw_size, payload, header->size);
+
+            if (pZSTD_isError(ret) || ret != header->raw_size)
+            {
+                fprintf(stderr, "%s: corrupt chunk %lu, ignoring the rest\n", path, chunks);
+                free(raw);
+                break;
+            }
+
+            payload = raw;
+        }
+
+        if (!read_chunk(payload, header->raw_size))
+        {
+            fprintf(stderr, "%s: malformed chunk %lu, ignoring the rest\n", path, chunks);
+            break;
+        }
+    }
+
+    return 1;
+}
+
+static uint64_t arg(const struct replay_call *call, unsigned int index)
+{
+    uint64_t value = 0;
+
+    if (index < call->count) memcpy(&value, call->args + index * sizeof(uint64_t), sizeof(value));
+
+    return value;
+}
+
+static const struct replay_data *find_data(const struct replay_call *call, uint32_t kind)
+{
+    for (size_t i = 0; i < call->data_count; i++)
+    {
+        if (call->data[i].kind == kind) return &call->data[i];
+    }
+
+    return NULL;
+}
+
+static uint64_t output(const struct replay_call *call)
+{
+    const struct replay_data *data = find_data(call, CAPTURE_DATA_OUTPUT);
+    uint64_t value = 0;
+
+    if (data) memcpy(&value, data->data, data->size < sizeof(value) ? data->size : sizeof(value));
+
+    return value;
+}
+
+static void log_callback_native(unsigned int level, const char *tag, const char *message, void *cbdata)
+{
+    fprintf(stderr, "[%u][%s]: %s\n", level, tag, message);
+}
+
+// module compiles, builtin IS modules and pipeline links carry a manifest record
+
+struct replay_options
+{
+    uint32_t kind;
+    OptixModuleCompileOptions_93 module;
+    OptixPipelineCompileOptions_93 pipeline;
+    const unsigned char *data;
+    size_t size;
+};
+
+static int read_options(const struct replay_call *call, uint32_t kind, struct replay_options *options)
+{
+    const struct replay_data *data = find_data(call, CAPTURE_DATA_MANIFEST);
+    const struct manifest_record_header *header;
+    struct reader r;
+
+    memset(options, 0, sizeof(*options));
+
+    if (!data || data->size < sizeof(*header)) return 0;
+
+    header = (const struct manifest_record_header *)data->data;
+    r.ptr = data->data + sizeof(*header);
+    r.end = data->data + data->size;
+    r.failed = 0;
+
+    get_options(&r, &options->module, &options->pipeline);
+    options->data = get_blob(&r, &options->size);
+
+    return !r.failed && header->kind == kind;
+}
+
+static void free_options(struct replay_options *options)
+{
+    for (unsigned int i = 0; i < options->module.numBoundValues; i++)
+        free((char *)options->module.boundValues[i].annotation);
+
+    free((void *)options->module.boundValues);
+    free((void *)options->module.payloadTypes);
+    free((char *)options->pipeline.pipelineLaunchParamsVariableName);
+}
+
+static enum replay_status replay_program_groups(struct replay_abi *abi, const struct replay_call *call, double *ms)
+{
+    const struct replay_data *data = find_data(call, CAPTURE_DATA_PROGRAM_GROUPS), *out = find_data(call, CAPTURE_DATA_OUTPUT);
+    struct capture_program_group_desc *descs;
+    OptixProgramGroup *groups;
+    uint64_t options[2] = {0};
+    struct timespec start, end;
+    enum replay_status status = REPLAY_FAILED;
+    char log[2048];
+    size_t log_size = sizeof(log);
+    unsigned int count;
+    void *context;
+    struct reader r;
+
+    if (!data || !lookup_handle(arg(call, 0), &context)) return REPLAY_FAILED;
+
+    r.ptr = data->data;
+    r.end = data->data + data->size;
+    r.failed = 0;
+    count = get_u32(&r);
+
+    if (r.failed || !(descs = calloc(count ? count : 1, sizeof(*descs))) || !(groups = calloc(count ? count : 1, sizeof(*groups))))
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    for (unsigned int i = 0; i < count && !r.failed; i++)
+    {
+        unsigned int entries;
+
+        descs[i].kind = get_u32(&r);
+        descs[i].flags = get_u32(&r);
+        entries = get_u32(&r);
+
+        for (unsigned int j = 0; j < entries && j < 3 && !r.failed; j++)
+        {
+            if (!lookup_handle(get_u64(&r), &descs[i].entries[j].module)) r.failed = 1;
+            descs[i].entries[j].entryFunctionName = get_string(&r);
+        }
+    }
+
+    if (!r.failed)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        OptixResult result = abi->optixProgramGroupCreate(context, descs, count, options, log, &log_size, groups);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        *ms = elapsed_ms(&start, &end);
+
+        if (result == OPTIX_SUCCESS)
+        {
+            for (unsigned int i = 0; out && i < count && (i + 1) * sizeof(uint64_t) <= out->size; i++)
+            {
+                uint64_t captured;
+
+                memcpy(&captured, out->data + i * sizeof(uint64_t), sizeof(captured));
+                map_handle(captured, groups[i]);
+            }
+
+            status = REPLAY_DONE;
+        }
+        else if (verbose && log_size > 1)
+        {
+            fprintf(stderr, "%.*s\n", (int)(log_size < sizeof(log) ? log_size : sizeof(log)), log);
+        }
+    }
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        for (unsigned int j = 0; j < 3; j++) free((char *)descs[i].entries[j].entryFunctionName);
+    }
+
+    free(descs);
+    free(groups);
+
+    return status;
+}
+
+static enum replay_status replay_pipeline(struct replay_abi *abi, const struct replay_call *call, double *ms)
+{
+    const struct replay_data *groups_data = find_data(call, CAPTURE_DATA_INPUT);
+    struct replay_options options;
+    struct timespec start, end;
+    enum replay_status status = REPLAY_FAILED;
+    uint64_t link[8] = {0};
+    OptixProgramGroup *groups;
+    OptixPipeline pipeline;
+    char log[2048];
+    size_t log_size = sizeof(log);
+    unsigned int count = arg(call, 4);
+    void *context;
+
+    if (!lookup_handle(arg(call, 0), &context)) return REPLAY_FAILED;
+
+    if (!(groups = calloc(count ? count : 1, sizeof(*groups))))
+    {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    if (read_options(call, MANIFEST_RECORD_PIPELINE, &options) && groups_data && groups_data->size >= count * sizeof(uint64_t))
+    {
+        unsigned int i;
+
+        memcpy(link, options.data, options.size < sizeof(link) ? options.size : sizeof(link));
+
+        for (i = 0; i < count; i++)
+        {
+            uint64_t captured;
+
+            memcpy(&captured, groups_data->data + i * sizeof(uint64_t), sizeof(captured));
+            if (!lookup_handle(captured, (void **)&groups[i])) break;
+        }
+
+        if (i == count)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            OptixResult result = abi->optixPipelineCreate(context, &options.pipeline, link, groups, count, log, &log_size, &pipeline);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+
+            *ms = elapsed_ms(&start, &end);
+
+            if (result == OPTIX_SUCCESS)
+            {
+                map_handle(output(call), pipeline);
+                status = REPLAY_DONE;
+            }
+            else if (verbose && log_size > 1)
+            {
+                fprintf(stderr, "%.*s\n", (int)(log_size < sizeof(log) ? log_size : sizeof(log)), log);
+            }
+        }
+    }
+
+    free_options(&options);
+    free(groups);
+
+    return status;
+}
+
+static enum replay_status replay_module(struct replay_abi *abi, const struct replay_call *call, int builtin, double *ms)
+{
+    struct replay_options options;
+    struct timespec start, end;
+    enum replay_status status = REPLAY_FAILED;
+    OptixResult result;
+    OptixModule module;
+    char log[2048];
+    size_t log_size = sizeof(log);
+    void *context;
+
+    if (!lookup_handle(arg(call, 0), &context)) return REPLAY_FAILED;
+
+    if (read_options(call, builtin ? MANIFEST_RECORD_BUILTIN_IS : MANIFEST_RECORD_MODULE, &options))
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if (builtin)
+        {
+            OptixBuiltinISOptions_93 builtin_options = {0};
+
+            memcpy(&builtin_options, options.data, options.size < sizeof(builtin_options) ? options.size : sizeof(builtin_options));
+            result = abi->optixBuiltinISModuleGet ? abi->optixBuiltinISModuleGet(context, &options.module, &options.pipeline, &builtin_options, &module) : OPTIX_ERROR_INVALID_FUNCTION_USE;
+            log_size = 0;
+        }
+        else
+        {
+            // tasks are compiled in one go, that is what the driver does without a task scheduler too
+
+            result = abi->optixModuleCreate(context, &options.module, &options.pipeline, (const char *)options.data, options.size, log, &log_size, &module);
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        *ms = elapsed_ms(&start, &end);
+
+        if (result == OPTIX_SUCCESS)
+        {
+            map_handle(output(call), module);
+            status = REPLAY_DONE;
+        }
+        else if (verbose && log_size > 1)
+        {
+            fprintf(stderr, "%.*s\n", (int)(log_size < sizeof(log) ? log_size : sizeof(log)), log);
+        }
+    }
+
+    free_options(&options);
+
+    return status;
+}
+
+static enum replay_status replay_denoiser(struct replay_abi *abi, const struct replay_call *call, const char *base, double *ms)
+{
+    const struct replay_data *input = find_data(call, CAPTURE_DATA_INPUT);
+    uint64_t denoiser_options[8] = {0};
+    struct timespec start, end;
+    OptixDenoiser denoiser;
+    OptixResult result;
+    void *context;
+
+    if (!lookup_handle(arg(call, 0), &context)) return REPLAY_FAILED;
+
+    if (input) memcpy(denoiser_options, input->data, input->size < sizeof(denoiser_options) ? input->size : sizeof(denoiser_options));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!strcmp(base, "optixDenoiserCreateWithUserModel"))
+        result = input && abi->optixDenoiserCreateWithUserModel ? abi->optixDenoiserCreateWithUserModel(context, input->data, input->size, &denoiser) : OPTIX_ERROR_INVALID_FUNCTION_USE;
+    else if (abi->optixDenoiserCreate)
+        result = abi->optixDenoiserCreate(context, arg(call, 1), denoiser_options, &denoiser);
+    else
+        result = abi->optixDenoiserCreateWithoutKind(context, denoiser_options, &denoiser);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *ms = elapsed_ms(&start, &end);
+
+    if (result != OPTIX_SUCCESS) return REPLAY_FAILED;
+
+    map_handle(output(call), denoiser);
+    return REPLAY_DONE;
+}
+
+// destroys and other calls on a single handle
+
+static enum replay_status replay_handle(OptixResult (*func)(void *handle), const struct replay_call *call, double *ms)
+{
+    struct timespec start, end;
+    void *handle;
+
+    if (!func || !lookup_handle(arg(call, 0), &handle)) return REPLAY_FAILED;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    OptixResult result = func(handle);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    *ms = elapsed_ms(&start, &end);
+
+    return result == OPTIX_SUCCESS ? REPLAY_DONE : REPLAY_FAILED;
+}
+
+static enum replay_status replay_call(const struct replay_call *call, double *ms)
+{
+    const struct replay_function *function = &functions[call->function];
+    const char *base = function->base;
+    struct replay_abi *abi;
+    struct timespec start, end;
+    OptixResult result;
+    void *handle;
+
+    // only calls that failed in the capture as well are expected to fail
+
+    if (call->result != OPTIX_SUCCESS) return REPLAY_SKIPPED;
+
+    if (!function->abi || !(abi = get_abi(function->abi))) return REPLAY_SKIPPED;
+
+    if (!strcmp(base, "optixDeviceContextCreate"))
+    {
+        OptixDeviceContextOptions_93 options = {0};
+        OptixDeviceContext context;
+
+        if (verbose)
+        {
+            options.logCallbackFunction = log_callback_native;
+            options.logCallbackLevel = 4;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result = abi->optixDeviceContextCreate(cuda_context, &options, &context);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        *ms = elapsed_ms(&start, &end);
+
+        if (result != OPTIX_SUCCESS) return REPLAY_FAILED;
+
+        map_handle(output(call), context);
+        return REPLAY_DONE;
+    }
+
+    if (!strncmp(base, "optixModuleCreate", 17)) return replay_module(abi, call, 0, ms);
+    if (!strcmp(base, "optixBuiltinISModuleGet")) return replay_module(abi, call, 1, ms);
+    if (!strcmp(base, "optixProgramGroupCreate")) return replay_program_groups(abi, call, ms);
+    if (!strcmp(base, "optixPipelineCreate")) return replay_pipeline(abi, call, ms);
+    if (!strncmp(base, "optixDenoiserCreate", 19)) return replay_denoiser(abi, call, base, ms);
+
+    if (!strcmp(base, "optixDeviceContextDestroy")) return replay_handle((void *)abi->optixDeviceContextDestroy, call, ms);
+    if (!strcmp(base, "optixModuleDestroy")) return replay_handle((void *)abi->optixModuleDestroy, call, ms);
+    if (!strcmp(base, "optixProgramGroupDestroy")) return replay_handle((void *)abi->optixProgramGroupDestroy, call, ms);
+    if (!strcmp(base, "optixPipelineDestroy")) return replay_handle((void *)abi->optixPipelineDestroy, call, ms);
+    if (!strcmp(base, "optixDenoiserDestroy")) return replay_handle((void *)abi->optixDenoiserDestroy, call, ms);
+
+    if (!strcmp(base, "optixPipelineSetStackSize"))
+    {
+        if (!lookup_handle(arg(call, 0), &handle)) return REPLAY_FAILED;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result = abi->optixPipelineSetStackSize(handle, arg(call, 1), arg(call, 2), arg(call, 3), arg(call, 4));
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        *ms = elapsed_ms(&start, &end);
+        return result == OPTIX_SUCCESS ? REPLAY_DONE : REPLAY_FAILED;
+    }
+
+    // the data of user models set this way is not captured, built-in models replay fine
+
+    if (!strcmp(base, "optixDenoiserSetModel") && abi->optixDenoiserSetModel)
+    {
+        if (!lookup_handle(arg(call, 0), &handle)) return REPLAY_FAILED;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result = abi->optixDenoiserSetModel(handle, arg(call, 1), NULL, 0);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        *ms = elapsed_ms(&start, &end);
+        return result == OPTIX_SUCCESS ? REPLAY_DONE : REPLAY_FAILED;
+    }
+
+    return REPLAY_SKIPPED;
+}
+
+static int compare_stats(const void *a, const void *b)
+{
+    const struct replay_stats *sa = a, *sb = b;
+
+    return sa->captured_ms < sb->captured_ms ? 1 : sa->captured_ms > sb->captured_ms ? -1 : 0;
+}
+
+static void report(void)
+{
+    qsort(stats, stats_count, sizeof(*stats), compare_stats);
+
+    printf("%-40s %8s %8s %8s %8s %12s %12s\n", "function", "calls", "replayed", "failed", "skipped", "wine ms", "native ms");
+
+    for (size_t i = 0; i < stats_count; i++)
+    {
+        const struct replay_stats *s = &stats[i];
+
+        if (!s->calls) continue;
+
+        printf("%-40s %8lu %8lu %8lu %8lu %12.3f %12.3f\n", s->name, s->calls, s->replayed, s->failed, s->skipped,
+               s->captured_ms / s->calls, s->replayed ? s->replay_ms / s->replayed : 0.0);
+    }
+}
+
+static int load_libraries(const char *library)
+{
+    void *libcuda, *libnvoptix;
+
+    if (!(libcuda = dlopen("libcuda.so.1", RTLD_NOW)))
+    {
+        fprintf(stderr, "Cannot load libcuda.so.1: %s\n", dlerror());
+        return 0;
+    }
+
+    #define LOAD_FUNCPTR(lib, f, name) if (!(*(void **)(&f) = dlsym(lib, name))) { fprintf(stderr, "Can't find symbol %s.\n", name); return 0; }
+
+    LOAD_FUNCPTR(libcuda, pcuInit, "cuInit");
+    LOAD_FUNCPTR(libcuda, pcuDeviceGet, "cuDeviceGet");
+    LOAD_FUNCPTR(libcuda, pcuDevicePrimaryCtxRetain, "cuDevicePrimaryCtxRetain");
+    LOAD_FUNCPTR(libcuda, pcuCtxSetCurrent, "cuCtxSetCurrent");
+
+    if (!(libnvoptix = dlopen(library, RTLD_NOW)))
+    {
+        fprintf(stderr, "Cannot load %s: %s\n", library, dlerror());
+        return 0;
+    }
+
+    LOAD_FUNCPTR(libnvoptix, poptixQueryFunctionTableNative, "optixQueryFunctionTable");
+
+    #undef LOAD_FUNCPTR
+
+    return 1;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Usage: %s [--no-gpu] [-l library] [-d device] [-v] capture\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option options[] =
+    {
+        { "no-gpu", no_argument, NULL, 'n' },
+        { "library", required_argument, NULL, 'l' },
+        { "device", required_argument, NULL, 'd' },
+        { "verbose", no_argument, NULL, 'v' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+    const char *library = "libnvoptix.so.1";
+    unsigned long replayed = 0, failed = 0;
+    struct timespec start, end;
+    int device_ordinal = 0;
+    double parse_ms, replay_ms;
+    CUdevice device;
+    int opt;
+
+    while ((opt = getopt_long(argc, argv, "nl:d:vh", options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': no_gpu = 1; break;
+            case 'l': library = optarg; break;
+            case 'd': device_ordinal = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!no_gpu)
+    {
+        if (!load_libraries(library)) return 1;
+
+        if (pcuInit(0) || pcuDeviceGet(&device, device_ordinal) || pcuDevicePrimaryCtxRetain(&cuda_context, device) || pcuCtxSetCurrent(cuda_context))
+        {
+            fprintf(stderr, "Failed to initialize CUDA device %d\n", device_ordinal);
+            return 1;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!load_capture(argv[optind])) return 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    parse_ms = elapsed_ms(&start, &end);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (size_t i = 0; i < calls_count; i++)
+    {
+        const struct replay_call *call = &calls[i];
+        struct replay_stats *s = &stats[functions[call->function].stats];
+        double ms = 0.0;
+
+        s->calls++;
+        s->captured_ms += (call->return_ns - call->entry_ns) / 1e6;
+
+        switch (replay_call(call, &ms))
+        {
+            case REPLAY_DONE: s->replayed++; s->replay_ms += ms; replayed++; break;
+            case REPLAY_FAILED: s->failed++; failed++; break;
+            case REPLAY_SKIPPED: s->skipped++; break;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    replay_ms = elapsed_ms(&start, &end);
+
+    report();
+
+    printf("%lu records in %lu chunks (%.1f MiB) read in %.3f ms, %zu calls, %zu blobs, %lu callbacks, %lu unmatched\n",
+           records, chunks, raw_bytes / 1048576.0, parse_ms, calls_count, blobs_count, callback_events, unmatched);
+    printf("%lu calls replayed (%lu failed) in %.3f ms%s\n", replayed, failed, replay_ms, no_gpu ? " against the stand-in library" : "");
+
+    return failed ? 1 : 0;
+}